@@ -34,9 +34,123 @@
 * For more information, please refer to <http://unlicense.org/>
 */
 #include "BigDecimal.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
 #include <sstream>
+#include <stdexcept>
 
 static const char *szFormatError = "Numeric Format Error";
+static const char *szDivByZeroError = "Division by zero";
+static const char *szRoundingError = "Rounding necessary";
+static const char *szNonTerminatingError = "Non-terminating decimal expansion";
+static const char *szDomainError = "Argument out of domain";
+static const char *szPrecisionError = "Unlimited precision is not supported";
+#ifdef VLONG_MAX_DIGITS
+static const char *szRangeError = "Result out of range";
+#endif
+static const char *szOverflowError = "Value does not fit the decimal type";
+
+const MathContext MathContext::DECIMAL32(7, ROUND_HALF_EVEN);
+const MathContext MathContext::DECIMAL64(16, ROUND_HALF_EVEN);
+const MathContext MathContext::DECIMAL128(34, ROUND_HALF_EVEN);
+const MathContext MathContext::UNLIMITED(0, ROUND_HALF_UP);
+
+// Number of decimal digits of |m| (1 for zero)
+static int decimalDigits(const vlong &m)
+{
+	size_t bits = m.GetNumBits();
+	if (bits <= 1)
+		return 1;
+
+	// 2**(bits-1) <= |m| < 2**bits, the estimate is off by at most one
+	int digits = (int) ((bits - 1) * 0.30102999566398120) + 1;
+	vlong a, p10;
+	a.Abs(m);
+	p10.Pow(10, digits - 1);
+	if (a < p10)
+		return digits - 1;
+	p10.Mul(p10, 10);
+	while (a >= p10)
+	{
+		p10.Mul(p10, 10);
+		digits++;
+	}
+	return digits;
+}
+
+// Adjusts a truncated quotient q = trunc(n/d) with a nonzero remainder.
+// sign is the sign of the exact quotient n/d, and half compares the
+// magnitude of the remainder with half of the divisor.
+static void roundNonZero(vlong &q, int half, int sign, RoundingMode mode)
+{
+	bool up = false;
+	switch (mode)
+	{
+	case ROUND_UP:
+		up = true;
+		break;
+	case ROUND_DOWN:
+		break;
+	case ROUND_CEILING:
+		up = sign > 0;
+		break;
+	case ROUND_FLOOR:
+		up = sign < 0;
+		break;
+	case ROUND_UNNECESSARY:
+		throw std::logic_error(szRoundingError);
+	default:
+		if (half > 0)
+			up = true;
+		else if (half == 0)
+			up = mode == ROUND_HALF_UP || (mode == ROUND_HALF_EVEN && (q.GetInt() & 1));
+	}
+	if (up)
+		q.Add(q, sign);
+}
+
+// Same for a remainder r
+static void roundQuotient(vlong &q, const vlong &r, const vlong &d, int sign, RoundingMode mode)
+{
+	if (r.isZero())
+		return;
+
+	int half = 0;
+	if (mode == ROUND_HALF_UP || mode == ROUND_HALF_DOWN || mode == ROUND_HALF_EVEN)
+	{
+		vlong r2;
+		r2.Abs(r);
+		r2.ShiftLeft(r2, 1);
+		half = vlong::CompareMag(r2, d);
+	}
+	roundNonZero(q, half, sign, mode);
+}
+
+// Same for a single digit divisor, r is the magnitude of the remainder
+static void roundQuotient(vlong &q, udig_t r, udig_t d, int sign, RoundingMode mode)
+{
+	if (r == 0)
+		return;
+
+	uwrd_t r2 = (uwrd_t)r << 1;
+	roundNonZero(q, r2 > d ? 1 : r2 < d ? -1 : 0, sign, mode);
+}
+
+// 10**n if it fits a positive single digit
+static bool pow10Digit(int n, sdig_t *p)
+{
+	udig_t v = 1;
+	for (int i = 0; i < n; i++)
+	{
+		if (v > (~(udig_t)0 >> 1) / 10)
+			return false;
+		v *= 10;
+	}
+	*p = (sdig_t)v;
+	return true;
+}
 
 BigDecimal::BigDecimal(int scale)
 	: scale_ (scale)
@@ -56,132 +170,163 @@ BigDecimal::BigDecimal(double d, int scale)
 	fromDouble(d, scale);
 }
 
+BigDecimal::BigDecimal(const vlong &unscaled, int scale)
+	: scale_(scale), m_(unscaled)
+{
+	if (scale_ < 0)
+		setScale(0);
+}
+
 void BigDecimal::fromString(const char *szNumber)
 {
-	int scale = 0, state = 0, expSign=1;
-	size_t len = strlen(szNumber), pos = 0;
-	int exp=0;
-	std::string s;
-	s.resize(len + 2);
-	for (size_t i = 0; i < len; i++)
+	fromChars(szNumber, szNumber + strlen(szNumber));
+}
+
+void BigDecimal::fromChars(const char *first, const char *last)
+{
+	// Largest multiplier that still lets one more decimal digit fit into a chunk
+	const udig_t chunkMax = ((udig_t)~((udig_t)0)) / 10;
+	udig_t chunk = 0, chunkMul = 1;
+	const char *p = first;
+	bool negative = false, havePoint = false, haveDigits = false;
+	int scale = 0, exp = 0;
+
+	if (p < last && (*p == '-' || *p == '+'))
 	{
-		char c = szNumber[i];
-		if (state==0 && c == '-')
-		{
-			state = 1;
-			s[pos] = c;
-			pos++;
-			continue;
-		}
-		if (state == 0 && c >= 48 && c <= 57)
+		negative = *p == '-';
+		p++;
+	}
+
+	m_.SetZero();
+	for (; p < last; p++)
+	{
+		char c = *p;
+		if (c >= '0' && c <= '9')
 		{
-			s[pos] = c;
-			pos++;
-			state = 2;
+			chunk = chunk * 10 + (udig_t)(c - '0');
+			chunkMul *= 10;
+			if (chunkMul > chunkMax)
+			{
+				m_.MulAdd(m_, chunkMul, chunk);
+				chunk = 0;
+				chunkMul = 1;
+			}
+			if (havePoint)
+				scale++;
+			haveDigits = true;
 			continue;
 		}
-		if (state <= 2 && c =='.')
+		if (c == '.' && !havePoint)
 		{
-			state = 10;
+			havePoint = true;
 			continue;
 		}
+		break;
+	}
+	if (!haveDigits)
+		throw std::logic_error(szFormatError);
+	if (chunkMul > 1)
+		m_.MulAdd(m_, chunkMul, chunk);
 
-		// First digit
-		if (state == 1 && (c < 48 || c > 57))
+	// Exponent
+	if (p < last && (*p == 'e' || *p == 'E'))
+	{
+		int expSign = 1;
+		p++;
+		if (p < last && (*p == '-' || *p == '+'))
 		{
-			throw std::logic_error(szFormatError);
+			expSign = *p == '-' ? -1 : 1;
+			p++;
 		}
-		if (state == 1 && c >= 48 && c <= 57)
+		if (p == last)
+			throw std::logic_error(szFormatError);
+		for (; p < last && *p >= '0' && *p <= '9'; p++)
 		{
-			s[pos] = c;
-			pos++;
-			state = 2;
-			continue;
+			if (exp >= 100000000)
+				throw std::logic_error(szFormatError);
+			exp = exp * 10 + *p - '0';
 		}
+		exp *= expSign;
+	}
+	if (p != last)
+		throw std::logic_error(szFormatError);
 
-		// Integral part
-		if (state == 2)
-		{
-			if (c >= 48 && c <= 57)
-			{
-				s[pos] = c;
-				pos++;
-				continue;
-			}
-			if (c == 'e' || c == 'E')
-			{
-				state = 3;
-				continue;
-			}
-			if (c == 'e' || c == 'E')
-			{
-				state = 3;
-				exp = 0;
-				continue;
-			}
-			throw std::logic_error(szFormatError);
-		}
+	scale -= exp;
+	if (scale < 0)
+	{
+		vlong p10;
+		p10.Pow(10, -scale);
+		m_.Mul(m_, p10);
+		scale = 0;
+	}
+	if (negative && !m_.isZero())
+		m_.SetSign(-1);
+	scale_ = scale;
+}
 
-		// Exponent sign
-		if (state == 3)
-		{
-			if (c == '-')
-			{
-				expSign = -1;
-				state = 4;
-				continue;
-			}
-			if (c == '+')
-			{
-				expSign = 1;
-				state = 4;
-				continue;
-			}
-			if (c >= 48 && c <= 57)
-			{
-				exp = exp * 10 + c - 48;
-				state = 4;
-				continue;
-			}
-			throw std::logic_error(szFormatError);
-		}
+size_t BigDecimal::fromCharsBulk(const char *first, const char *last, char delimiter, BigDecimal *out, size_t count)
+{
+	size_t n = 0;
+	const char *p = first;
 
-		// Exponent sign
-		if (state == 4)
-		{
-			if (c >= 48 && c <= 57)
-			{
-				if (exp >= 100000000)
-					throw std::logic_error(szFormatError);
-				exp = exp * 10 + c - 48;
-				state = 4;
-				continue;
-			}
-		}
+	while (p < last && n < count)
+	{
+		const char *end = static_cast<const char *>(memchr(p, delimiter, last - p));
+		if (end == NULL)
+			end = last;
+
+		// Tolerate CRLF line endings when values are one per line
+		const char *valueEnd = end;
+		if (delimiter == '\n' && valueEnd > p && valueEnd[-1] == '\r')
+			valueEnd--;
+
+		out[n].fromChars(p, valueEnd);
+		n++;
 
-		// Fracture part
-		if (state == 10 && c >= 48 && c <= 57)
+		if (end == last)
+			break;
+		p = end + 1;
+	}
+	return n;
+}
+
+void BigDecimal::fromFixedWidthBulk(const char *in, size_t count, size_t width, int scale, BigDecimal *out)
+{
+	vlong p10;
+	if (scale < 0)
+		p10.Pow(10, -scale);
+
+	for (size_t i = 0; i < count; i++, in += width)
+	{
+		out[i].m_.FromTwosComplementLE(in, width);
+		out[i].scale_ = scale;
+		if (scale < 0)
 		{
-			scale += 1;
-			s[pos] = c;
-			pos++;
-			continue;
+			out[i].m_.Mul(out[i].m_, p10);
+			out[i].scale_ = 0;
 		}
-		break;
 	}
-	scale_ = scale <= 0 ? 0 : scale;
-	m_.FromString(s.c_str(), 10);
-	if (exp!=0)
+}
+
+void BigDecimal::toFixedWidthBulk(const BigDecimal *in, size_t count, size_t width, int precision, int scale, char *out)
+{
+	vlong limit;
+	BigDecimal tmp(0);
+
+	if (precision > 0)
+		limit.Pow(10, precision);
+
+	for (size_t i = 0; i < count; i++, out += width)
 	{
-		if (expSign<0)
-			scale_ = exp;
-		else
+		const vlong *m = &in[i].m_;
+		if (in[i].scale_ != scale)
 		{
-			vlong p10(10);
-			p10.Pow(10, exp);
-			vlong m(m_);
-			m_.Mul(m_, p10);
+			tmp = in[i];
+			tmp.roundTo(scale, ROUND_HALF_UP);
+			m = &tmp.m_;
 		}
+		if ((precision > 0 && vlong::CompareMag(*m, limit) >= 0) || m->ToTwosComplementLE(out, width) != VLONG_SUCCESS)
+			throw std::logic_error(szOverflowError);
 	}
 }
 
@@ -224,7 +369,7 @@ std::string BigDecimal::toString() const
 		scaleLeft--;
 		len--;
 	}
-	while (scaleLeft > 0)
+	while (scaleLeft > 0 && haveNonZero)
 	{
 		oss << "0";
 		scaleLeft--;
@@ -252,43 +397,165 @@ std::string BigDecimal::toString() const
 }
 
 void BigDecimal::setScale(int scale)
+{
+	setScale(scale, ROUND_HALF_UP);
+}
+
+void BigDecimal::setScale(int scale, RoundingMode mode)
 {
 	if (scale < 0) scale = 0;
+	roundTo(scale, mode);
+}
+
+// Unlike setScale() allows a negative scale, so the result must be
+// brought back to scale 0 or above before it is returned
+void BigDecimal::roundTo(int scale, RoundingMode mode)
+{
+	sdig_t p, r;
 	if (scale > scale_)
 	{
-		vlong p10;
-		p10.Pow(10, scale - scale_);
-		vlong m(m_);
-		m_.Mul(m, p10);
+		if (pow10Digit(scale - scale_, &p))
+			m_.Mul(m_, p);
+		else
+		{
+			vlong p10;
+			p10.Pow(10, scale - scale_);
+			m_.Mul(m_, p10);
+		}
 	}
 	if (scale < scale_)
 	{
-		vlong p10;
-		p10.Pow(10, scale_ - scale);
-		vlong m(m_);
-		vlong r;
-		int sign = m_.GetSign()>0 ? 1 : -1;
-		m_.Div(m, p10, &r);
-		r.Mul(r, 2*sign);
-		if (r >= p10)
-			m_.Add(m_, sign);
+		int sign = m_.GetSign();
+		if (pow10Digit(scale_ - scale, &p))
+		{
+			m_.Div(m_, p, &r);
+			roundQuotient(m_, (udig_t)(r < 0 ? -r : r), (udig_t)p, sign, mode);
+		}
+		else
+		{
+			vlong p10, rv;
+			p10.Pow(10, scale_ - scale);
+			m_.Div(m_, p10, &rv);
+			roundQuotient(m_, rv, p10, sign, mode);
+		}
 	}
 	scale_ = scale;
 }
 
+void BigDecimal::roundPrecision(const MathContext &mc)
+{
+	int precision = mc.getPrecision();
+	if (precision > 0)
+	{
+		int drop = decimalDigits(m_) - precision;
+		if (drop > 0)
+			roundTo(scale_ - drop, mc.getRoundingMode());
+	}
+	if (scale_ < 0)
+		roundTo(0, ROUND_UNNECESSARY);
+}
+
+// Removes trailing zeros while the scale is greater than the given one
+void BigDecimal::stripZeros(int scale)
+{
+	vlong q;
+	sdig_t r;
+	while (scale_ > scale && !m_.isZero())
+	{
+		q.Div(m_, 10, &r);
+		if (r != 0)
+			break;
+		m_.swap(q);
+		scale_--;
+	}
+}
+
+int BigDecimal::precision() const
+{
+	return decimalDigits(m_);
+}
+
+BigDecimal BigDecimal::round(const MathContext &mc) const
+{
+	BigDecimal result(*this);
+	result.roundPrecision(mc);
+	return result;
+}
+
 int BigDecimal::compare(const BigDecimal &rhs) const
 {
+	int sign = m_.isZero() ? 0 : m_.GetSign();
+	int rhsSign = rhs.m_.isZero() ? 0 : rhs.m_.GetSign();
+	if (sign != rhsSign)
+		return sign < rhsSign ? -1 : 1;
+	if (sign == 0)
+		return 0;
 	if (scale_ == rhs.scale_)
 		return m_.Compare(rhs.m_);
-	if (scale_>rhs.scale_)
+	return sign * compareMag(rhs);
+}
+
+// Compares magnitudes of numbers having different scales: |a|*10**k vs |b|
+int BigDecimal::compareMag(const BigDecimal &rhs) const
+{
+	const BigDecimal *a = this, *b = &rhs;
+	int sign = 1;
+	if (a->scale_ > b->scale_)
 	{
-		BigDecimal tmp(rhs);
-		tmp.setScale(scale_);
-		return m_.Compare(tmp.m_);
+		a = &rhs;
+		b = this;
+		sign = -1;
 	}
-	BigDecimal tmp(*this);
-	tmp.setScale(rhs.scale_);
-	return tmp.m_.Compare(rhs.scale_);
+	int k = b->scale_ - a->scale_;
+
+	// 2**(bits-1) <= |m| < 2**bits bounds the decimal exponents,
+	// different ones decide without looking at the digits
+	const double log10of2 = 0.30102999566398120;
+	double bitsA = (double) a->m_.GetNumBits(), bitsB = (double) b->m_.GetNumBits();
+	if ((bitsA - 1) * log10of2 + k > bitsB * log10of2 + 1e-9)
+		return sign;
+	if (bitsA * log10of2 + k < (bitsB - 1) * log10of2 - 1e-9)
+		return -sign;
+
+	// 10**k fits a digit: stream the product
+	udig_t p10 = 1;
+	int j;
+	for (j = 0; j < k && p10 <= ((udig_t) ~(udig_t) 0) / 10; j++)
+		p10 *= 10;
+	if (j == k)
+		return sign * vlong::CompareMagMul(a->m_, p10, b->m_);
+
+	vlong t;
+	t.Pow(10, k);
+	t.Mul(t, a->m_);
+	return sign * vlong::CompareMag(t, b->m_);
+}
+
+// Value modulo a prime P, i.e. m * 10**-scale mod P. Numbers that compare
+// equal get the same hash whatever their scales, and no trailing zeros
+// have to be stripped. P is the largest Mersenne prime below 2**(BiD-1),
+// so a remainder times 2**BiD still fits a word.
+size_t BigDecimal::hash() const
+{
+	const int bits = (int) sizeof(udig_t) * 8;
+	const uwrd_t p = ((uwrd_t) ~(udig_t) 0) >> (bits >= 64 ? 3 : bits >= 32 ? 1 : bits >= 16 ? 3 : 1);
+
+	sdig_t r = m_.ModDig(m_, (sdig_t) p);
+	uwrd_t h = r < 0 ? p - (uwrd_t) -r : (uwrd_t) r;
+
+	// 10**-1 = (k*P + 1)/10 for the k making it divisible
+	uwrd_t inv10 = 1;
+	for (uwrd_t k = 0; k < 10; k++)
+		if ((k * p + 1) % 10 == 0)
+			inv10 = (k * p + 1) / 10;
+
+	for (int e = scale_; e > 0; e >>= 1)
+	{
+		if (e & 1)
+			h = h * inv10 % p;
+		inv10 = inv10 * inv10 % p;
+	}
+	return (size_t) h;
 }
 
 void BigDecimal::add(const BigDecimal &rhs)
@@ -345,15 +612,589 @@ void BigDecimal::mul(const BigDecimal &rhs)
 
 void BigDecimal::div(const BigDecimal &rhs)
 {
-	BigDecimal tr(rhs);
+	if (rhs.m_.isZero())
+		throw std::logic_error(szDivByZeroError);
+
+	if (rhs.m_.GetNumDigits() == 1)
+	{
+		divInt(rhs.m_.GetDigit(0), rhs.m_.GetSign(), -rhs.scale_);
+		return;
+	}
+
 	vlong r;
 	int scale = scale_;
+	int sign = m_.GetSign() * rhs.m_.GetSign();
 	setScale(scale + rhs.scale_);
-	m_.Div(m_, tr.m_, &r);
-	tr.m_.SetSign(1);
-	r.Mul(r, 2);
-	if (r >= tr.m_)
-		m_.Add(m_, 1);
-	scale_ -= rhs.scale_;
-	setScale(scale);
+	m_.Div(m_, rhs.m_, &r);
+	roundQuotient(m_, r, rhs.m_, sign, ROUND_HALF_UP);
+	scale_ = scale;
+}
+
+void BigDecimal::div(double rhs)
+{
+	// Integral values are exact in a double below 2**53
+	if (rhs < 9007199254740992.0 && rhs > -9007199254740992.0 && rhs == (double)(swrd_t)rhs)
+	{
+		swrd_t w = (swrd_t)rhs;
+		divInt(magnitude(w), w < 0 ? -1 : 1, 0);
+	}
+	else
+		div(BigDecimal(rhs, scale_));
+}
+
+// Division by sign*d*10**k keeping the scale. A power of ten only moves the
+// decimal point, other divisors that fit a digit use a single digit division.
+void BigDecimal::divInt(uwrd_t d, int sign, int k)
+{
+	if (d == 0)
+		throw std::logic_error(szDivByZeroError);
+
+	int scale = scale_;
+	while (d % 10 == 0)
+	{
+		d /= 10;
+		k++;
+	}
+	if (sign < 0 && !m_.isZero())
+		m_.SetSign(-m_.GetSign());
+
+	if (d == 1)
+	{
+		scale_ += k;
+		roundTo(scale, ROUND_HALF_UP);
+		return;
+	}
+
+	// Fold the power of ten into the divisor while it fits a digit
+	sdig_t p;
+	if (k > 0 && pow10Digit(k, &p) && d <= (uwrd_t)((~(udig_t)0 >> 1) / p))
+	{
+		d *= p;
+		k = 0;
+	}
+	if (k < 0)
+	{
+		roundTo(scale - k, ROUND_UNNECESSARY);
+		k = 0;
+	}
+
+	int qsign = m_.GetSign();
+	if (k == 0 && d <= (uwrd_t)(~(udig_t)0 >> 1))
+	{
+		sdig_t r;
+		m_.Div(m_, (sdig_t)d, &r);
+		roundQuotient(m_, (udig_t)(r < 0 ? -r : r), (udig_t)d, qsign, ROUND_HALF_UP);
+	}
+	else
+	{
+		vlong dv, r, p10;
+		dv.SetWord((swrd_t)(d >> 1));
+		dv.ShiftLeft(dv, 1);
+		dv.Add(dv, (sdig_t)(d & 1));
+		if (k > 0)
+		{
+			p10.Pow(10, k);
+			dv.Mul(dv, p10);
+		}
+		m_.Div(m_, dv, &r);
+		roundQuotient(m_, r, dv, qsign, ROUND_HALF_UP);
+	}
+	scale_ = scale;
+}
+
+// Division by sign*d for a 64-bit d. Only with 16-bit digits d may not fit
+// a word, then it is built byte by byte and divided as a BigDecimal.
+void BigDecimal::divLong(ullong_t d, int sign)
+{
+	if (d == (ullong_t)(uwrd_t)d)
+	{
+		divInt((uwrd_t)d, sign, 0);
+		return;
+	}
+
+	vlong dv;
+	for (int i = (int) sizeof(d) - 1; i >= 0; i--)
+	{
+		dv.Mul(dv, 256);
+		dv.Add(dv, (sdig_t)((d >> (8 * i)) & 0xff));
+	}
+	dv.SetSign(sign);
+	div(BigDecimal(dv, 0));
+}
+
+void BigDecimal::addExact(const BigDecimal &rhs, bool subtract)
+{
+	if (scale_ < rhs.scale_)
+		roundTo(rhs.scale_, ROUND_UNNECESSARY);
+	if (scale_ > rhs.scale_)
+	{
+		BigDecimal tmp(rhs);
+		tmp.roundTo(scale_, ROUND_UNNECESSARY);
+		addExact(tmp, subtract);
+		return;
+	}
+	if (subtract)
+		m_.Sub(m_, rhs.m_);
+	else
+		m_.Add(m_, rhs.m_);
+}
+
+BigDecimal BigDecimal::add(const BigDecimal &rhs, const MathContext &mc) const
+{
+	BigDecimal result(*this);
+	result.addExact(rhs, false);
+	result.roundPrecision(mc);
+	return result;
+}
+
+BigDecimal BigDecimal::sub(const BigDecimal &rhs, const MathContext &mc) const
+{
+	BigDecimal result(*this);
+	result.addExact(rhs, true);
+	result.roundPrecision(mc);
+	return result;
+}
+
+BigDecimal BigDecimal::mul(const BigDecimal &rhs, const MathContext &mc) const
+{
+	BigDecimal result(scale_ + rhs.scale_);
+	result.m_.Mul(m_, rhs.m_);
+	result.roundPrecision(mc);
+	return result;
+}
+
+BigDecimal BigDecimal::div(const BigDecimal &rhs, const MathContext &mc) const
+{
+	if (rhs.m_.isZero())
+		throw std::logic_error(szDivByZeroError);
+
+	int preferred = scale_ - rhs.scale_;
+	if (m_.isZero())
+		return BigDecimal(preferred < 0 ? 0 : preferred);
+	if (mc.getPrecision() == 0)
+		return divExact(rhs);
+
+	// Scale the operands so that the integer quotient has at least
+	// precision+1 digits, enough to decide the rounding together with
+	// a sticky digit standing for a nonzero remainder
+	int k = mc.getPrecision() + 1 - decimalDigits(m_) + decimalDigits(rhs.m_);
+	int sign = m_.GetSign() * rhs.m_.GetSign();
+	vlong n(m_), d(rhs.m_), p10, r;
+	if (k > 0)
+	{
+		p10.Pow(10, k);
+		n.Mul(n, p10);
+	}
+	if (k < 0)
+	{
+		p10.Pow(10, -k);
+		d.Mul(d, p10);
+	}
+
+	BigDecimal result(preferred + k);
+	result.m_.Div(n, d, &r);
+	if (r.isZero())
+	{
+		result.roundPrecision(mc);
+		result.stripZeros(preferred < 0 ? 0 : preferred);
+		return result;
+	}
+	result.m_.Mul(result.m_, 10);
+	result.m_.Add(result.m_, sign);
+	result.scale_++;
+	result.roundPrecision(mc);
+	return result;
+}
+
+// The quotient terminates only if the divisor reduced by the common
+// factors has no prime factors other than 2 and 5
+BigDecimal BigDecimal::divExact(const BigDecimal &rhs) const
+{
+	vlong g, n, d, q;
+	sdig_t r;
+	g.GCD(m_, rhs.m_);
+	n.Div(m_, g);
+	d.Div(rhs.m_, g);
+	if (d.GetSign() < 0)
+	{
+		n.SetSign(-n.GetSign());
+		d.SetSign(1);
+	}
+
+	int twos = (int) d.GetNumLSB();
+	int fives = 0;
+	d.ShiftRight(d, twos);
+	for (;;)
+	{
+		q.Div(d, 5, &r);
+		if (r != 0)
+			break;
+		d.swap(q);
+		fives++;
+	}
+	if (d != 1)
+		throw std::logic_error(szNonTerminatingError);
+
+	// n/(2**twos * 5**fives) = n * 2**(k-twos) * 5**(k-fives) / 10**k
+	int k = twos > fives ? twos : fives;
+	vlong f;
+	f.Pow(2, k - twos);
+	n.Mul(n, f);
+	f.Pow(5, k - fives);
+	n.Mul(n, f);
+
+	BigDecimal result(scale_ - rhs.scale_ + k);
+	result.m_.swap(n);
+	if (result.scale_ < 0)
+		result.roundTo(0, ROUND_UNNECESSARY);
+	return result;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Elementary functions
+//
+// Computed in fixed point: a vlong x stands for x/10**W, W being the
+// number of working digits (the requested precision plus guard digits).
+
+// x <- x * 10**n, truncating if n is negative
+static void shift10(vlong &x, int n)
+{
+	vlong p10;
+	if (n > 0)
+	{
+		p10.Pow(10, n);
+		x.Mul(x, p10);
+	}
+	if (n < 0)
+	{
+		p10.Pow(10, -n);
+		x.Div(x, p10);
+	}
+}
+
+// Natural logarithm of x/10**W in double precision
+static double lnApprox(const vlong &x, int W)
+{
+	size_t nu = x.GetNumDigits();
+	size_t top = nu > 3 ? nu - 3 : 0;
+	double m = 0;
+	for (size_t i = nu; i > top; i--)
+		m = ldexp(m, (int) (sizeof(udig_t) * 8)) + x.GetDigit(i - 1);
+	return log(m) + (double) (top * sizeof(udig_t) * 8) * log(2.0) - W * log(10.0);
+}
+
+// Binary splitting of the series sum(x**k/k!) for k in [l, r), x = c/b:
+// the partial sum is T/Q and P = c**(r-l)
+static void expSplit(const vlong &c, const vlong &b, int l, int r, vlong &P, vlong &Q, vlong &T)
+{
+	if (r - l == 1)
+	{
+		P = c;
+		Q.Mul(b, l);
+		T = c;
+		return;
+	}
+
+	vlong P2, Q2, T2;
+	int m = (l + r) / 2;
+	expSplit(c, b, l, m, P, Q, T);
+	expSplit(c, b, m, r, P2, Q2, T2);
+
+	// T = T*Q2 + P*T2
+	T.Mul(T, Q2);
+	T2.Mul(P, T2);
+	T.Add(T, T2);
+	P.Mul(P, P2);
+	Q.Mul(Q, Q2);
+}
+
+// y <- exp(c/10**q) in fixed point, |c/10**q| < 1
+static void expSeries(vlong &y, const vlong &c, int q, int W)
+{
+	// number of terms: |x|**n/n! < 10**-(W+2)
+	double lx = decimalDigits(c) - q;
+	double term = 0;
+	int n = 1;
+	while (term > -(W + 2))
+	{
+		term += lx - log10((double) n);
+		n++;
+	}
+
+	vlong b, P, Q, T;
+	b.Pow(10, q);
+	expSplit(c, b, 1, n, P, Q, T);
+
+	y.Pow(10, W);
+	T.Mul(T, y);
+	T.Div(T, Q);
+	y.Add(y, T);
+}
+
+// y <- exp(x) in fixed point
+// The argument is halved k times to below 2**-8 and split into chunks of
+// 4, 8, 16, ... digits (the bit-burst method), so that each series has a
+// short numerator. The result is then squared k times.
+static void expFixed(vlong &y, const vlong &x, int W)
+{
+	vlong a, one;
+	int sign = x.GetSign();
+	a.Abs(x);
+	one.Pow(10, W);
+
+	int k = (int) a.GetNumBits() - (int) one.GetNumBits() + 8;
+	if (k < 0)
+		k = 0;
+	int w = W + 4 + (k * 3) / 10;
+
+	vlong r(a), c, rest, e, p10;
+	shift10(r, w - W);
+	r.ShiftRight(r, k);
+	y.Pow(10, w);
+
+	for (int pos = 0, len = 4; !r.isZero() && pos < w; pos += len, len *= 2)
+	{
+		if (pos + len > w)
+			len = w - pos;
+		p10.Pow(10, w - pos - len);
+		c.Div(r, p10, &rest);
+		r.swap(rest);
+		if (c.isZero())
+			continue;
+		expSeries(e, c, pos + len, w);
+		y.Mul(y, e);
+		shift10(y, -w);
+	}
+
+	for (int i = 0; i < k; i++)
+	{
+		y.Mul(y, y);
+		shift10(y, -w);
+	}
+
+	if (sign < 0)
+	{
+		p10.Pow(10, 2 * w);
+		y.Div(p10, y);
+	}
+	shift10(y, W - w);
+}
+
+// y <- ln(f) in fixed point, f > 0.1
+// Newton's iteration y <- y + f/exp(y) - 1 started from the double
+// precision estimate, doubling the number of working digits each step
+static void lnFixed(vlong &y, const vlong &f, int W)
+{
+	int levels[64];
+	int n = 0;
+	for (int w = W; ; w = w / 2 + 2)
+	{
+		levels[n++] = w;
+		if (w <= 24)
+			break;
+	}
+
+	double y0 = lnApprox(f, W);
+	int prev = 15;
+	y.SetWord((swrd_t) (y0 * 1e15 + (y0 < 0 ? -0.5 : 0.5)));
+
+	vlong fw, e, one;
+	while (n > 0)
+	{
+		int w = levels[--n];
+		shift10(y, w - prev);
+		prev = w;
+
+		fw = f;
+		shift10(fw, 2 * w - W);
+		one.Pow(10, w);
+		expFixed(e, y, w);
+		e.Div(fw, e);
+		e.Sub(e, one);
+		y.Add(y, e);
+	}
+}
+
+static int intDigits(unsigned int n)
+{
+	int digits = 1;
+	for (; n >= 10; n /= 10)
+		digits++;
+	return digits;
+}
+
+BigDecimal BigDecimal::sqrt(const MathContext &mc) const
+{
+	if (m_.GetSign() < 0 && !m_.isZero())
+		throw std::logic_error(szDomainError);
+	if (m_.isZero())
+		return BigDecimal(scale_ / 2);
+
+	// N = m * 10**e having an even scale and, unless the result has to be
+	// exact, at least 2*(precision+2) digits
+	int precision = mc.getPrecision();
+	int e = 0;
+	if (precision > 0)
+	{
+		e = 2 * (precision + 2) - decimalDigits(m_);
+		if (e < 0)
+			e = 0;
+	}
+	if ((scale_ + e) & 1)
+		e++;
+
+	vlong N(m_), t;
+	shift10(N, e);
+	BigDecimal result((scale_ + e) / 2);
+	result.m_.Sqrt(N);
+	t.Mul(result.m_, result.m_);
+	if (t != N)
+	{
+		if (precision == 0)
+			throw std::logic_error(szNonTerminatingError);
+		// sticky digit
+		result.m_.Mul(result.m_, 10);
+		result.m_.Add(result.m_, 1);
+		result.scale_++;
+		result.roundPrecision(mc);
+		return result;
+	}
+	result.roundPrecision(mc);
+	result.stripZeros(scale_ / 2);
+	return result;
+}
+
+BigDecimal BigDecimal::exp(const MathContext &mc) const
+{
+	int precision = mc.getPrecision();
+	if (m_.isZero())
+		return BigDecimal(vlong(1), 0);
+	if (precision == 0)
+		throw std::logic_error(szPrecisionError);
+
+	// exp(-x) = 1/exp(x) keeps the relative error small for large x
+	if (m_.GetSign() < 0)
+	{
+		BigDecimal x(*this);
+		x.m_.SetSign(1);
+		return BigDecimal(vlong(1), 0).div(x.exp(MathContext(precision + 10, ROUND_HALF_EVEN)), mc);
+	}
+
+	// exp(x) >= 1, so W fractional digits are at least W significant ones
+	int W = precision + 10;
+
+#ifdef VLONG_MAX_DIGITS
+	// exp(x) has x*log10(e) integer digits, squaring needs twice as many
+	double digits = ::exp(lnApprox(m_, scale_)) * 0.4342944819032518 + W;
+	if (2 * digits > VLONG_MAX_DIGITS * sizeof(udig_t) * 8 * 0.3010299956639812)
+		throw std::logic_error(szRangeError);
+#endif
+	vlong x(m_);
+	shift10(x, W - scale_);
+
+	BigDecimal result(W);
+	expFixed(result.m_, x, W);
+	result.roundPrecision(mc);
+	return result;
+}
+
+BigDecimal BigDecimal::ln(const MathContext &mc) const
+{
+	int precision = mc.getPrecision();
+	if (m_.GetSign() < 0 || m_.isZero())
+		throw std::logic_error(szDomainError);
+
+	vlong p10;
+	p10.Pow(10, scale_);
+	if (m_.Compare(p10) == 0)
+		return BigDecimal(0);
+	if (precision == 0)
+		throw std::logic_error(szPrecisionError);
+
+	// x = f * 10**E with 0.1 <= f < 1, unless x is in [0.1, 10**40) already
+	int E = decimalDigits(m_) - scale_;
+	int extra = 0;
+	if (E >= 0 && E <= 40)
+	{
+		// ln(x) is about x-1 near 1, it needs as many more digits as x-1 has leading zeros
+		vlong d;
+		d.Sub(m_, p10);
+		extra = scale_ - decimalDigits(d);
+		if (extra < 0)
+			extra = 0;
+		E = 0;
+	}
+
+	int W = precision + 10 + extra + intDigits(E < 0 ? 0u - (unsigned int) E : (unsigned int) E);
+	vlong f(m_);
+	shift10(f, W - scale_ - E);
+
+	BigDecimal result(W);
+	lnFixed(result.m_, f, W);
+	if (E != 0)
+	{
+		vlong ln10, ten;
+		ten.Pow(10, W + 1);
+		lnFixed(ln10, ten, W);
+		ln10.Mul(ln10, E);
+		result.m_.Add(result.m_, ln10);
+	}
+	result.roundPrecision(mc);
+	return result;
+}
+
+BigDecimal BigDecimal::pow(int n, const MathContext &mc) const
+{
+	int precision = mc.getPrecision();
+	unsigned int e = n < 0 ? 0u - (unsigned int) n : (unsigned int) n;
+
+	// Exact with unlimited precision, otherwise each product keeps guard digits
+	MathContext work(precision == 0 ? 0 : precision + intDigits(e) + 3, ROUND_HALF_EVEN);
+	BigDecimal result(vlong(1), 0);
+	BigDecimal base(*this);
+	while (e > 0)
+	{
+		if (e & 1)
+			result = result.mul(base, work);
+		e >>= 1;
+		if (e > 0)
+			base = base.mul(base, work);
+	}
+	if (n < 0)
+		return BigDecimal(vlong(1), 0).div(result, mc);
+	result.roundPrecision(mc);
+	return result;
+}
+
+BigDecimal BigDecimal::pow(const BigDecimal &y, const MathContext &mc) const
+{
+	// integral exponents also work for negative bases
+	BigDecimal yi(y);
+	yi.stripZeros(0);
+	swrd_t n;
+	if (yi.scale_ == 0 && yi.m_.GetWord(&n) == VLONG_SUCCESS && n >= INT_MIN && n <= INT_MAX)
+		return pow((int) n, mc);
+
+	int precision = mc.getPrecision();
+	if (m_.GetSign() < 0 && !m_.isZero())
+		throw std::logic_error(szDomainError);
+	if (m_.isZero())
+	{
+		if (y.m_.GetSign() < 0)
+			throw std::logic_error(szDomainError);
+		return BigDecimal(0);
+	}
+	if (precision == 0)
+		throw std::logic_error(szPrecisionError);
+
+	// x**y = exp(y*ln(x)), every integer digit of y*ln(x) costs a digit of ln(x)
+	MathContext work(precision + 10, ROUND_HALF_EVEN);
+	BigDecimal z = y.mul(ln(work), work);
+	int k = decimalDigits(z.m_) - z.scale_;
+	if (k > 0)
+	{
+		work = MathContext(precision + 10 + k, ROUND_HALF_EVEN);
+		z = y.mul(ln(work), work);
+	}
+	return z.exp(mc);
 }
@@ -39,24 +39,114 @@
 #include <string>
 #include "vlong.h"
 
+// Rounding applied when digits of a result have to be discarded
+enum RoundingMode
+{
+	ROUND_UP,           // away from zero
+	ROUND_DOWN,         // towards zero (truncation)
+	ROUND_CEILING,      // towards positive infinity
+	ROUND_FLOOR,        // towards negative infinity
+	ROUND_HALF_UP,      // to nearest, ties away from zero
+	ROUND_HALF_DOWN,    // to nearest, ties towards zero
+	ROUND_HALF_EVEN,    // to nearest, ties to the even neighbour (banker's rounding)
+	ROUND_UNNECESSARY   // the result must be exact, throws otherwise
+};
+
+// Number of significant digits (0 means unlimited) and rounding mode
+// of BigDecimal operations
+class MathContext
+{
+public:
+	explicit MathContext(int precision = 0, RoundingMode mode = ROUND_HALF_UP)
+		: precision_(precision < 0 ? 0 : precision), mode_(mode) {}
+
+	int getPrecision() const { return precision_; }
+	RoundingMode getRoundingMode() const { return mode_; }
+
+	// IEEE 754 decimal formats and exact arithmetic
+	static const MathContext DECIMAL32;
+	static const MathContext DECIMAL64;
+	static const MathContext DECIMAL128;
+	static const MathContext UNLIMITED;
+
+private:
+	int precision_;
+	RoundingMode mode_;
+};
+
+// 64-bit integers, which may be wider than a word with 16-bit digits
+#if defined(_MSC_VER)
+typedef   signed __int64   sllong_t;
+typedef unsigned __int64   ullong_t;
+#else
+typedef   signed long long sllong_t;
+typedef unsigned long long ullong_t;
+#endif
+
 class BigDecimal
 {
 public:
 	explicit BigDecimal(int scale);
 	explicit BigDecimal(const char *szNumber);
 	BigDecimal(double d, int scale);
+	BigDecimal(const vlong &unscaled, int scale);
 
 	void fromString(const char *szNumber);
+
+	// Parses characters in [first, last), e.g. "-123.4500" or "1.5E-3".
+	// Digits are accumulated into the unscaled value a machine word at a time.
+	void fromChars(const char *first, const char *last);
+
+	// Parses up to count delimiter-separated values (a CSV column) into a preallocated array.
+	// Returns the number of values stored.
+	static size_t fromCharsBulk(const char *first, const char *last, char delimiter, BigDecimal *out, size_t count);
+
+	// Bulk conversion from and to fixed-width little-endian two's complement
+	// decimals, e.g. Arrow and Parquet decimal128 (width 16) and decimal256 (width 32).
+	// Unscaled values are copied directly with no text round trip. On output values
+	// are rounded half up to the scale of the buffer, and a value with more than
+	// precision digits (if precision > 0) or too wide for the buffer throws.
+	static void fromFixedWidthBulk(const char *in, size_t count, size_t width, int scale, BigDecimal *out);
+	static void toFixedWidthBulk(const BigDecimal *in, size_t count, size_t width, int precision, int scale, char *out);
+
 	void fromDouble(double d);
 	void fromDouble(double d, int scale);
 
 	std::string toString() const;
 	int getScale() const { return scale_; }
+	const vlong &getUnscaled() const { return m_; }
 	void setScale(int scale);
+	void setScale(int scale, RoundingMode mode);
+
+	// Number of significant decimal digits of the unscaled value
+	int precision() const;
+
+	// Rounded to the precision of a MathContext
+	BigDecimal round(const MathContext &mc) const;
+
+	// Arithmetic with the result rounded to the precision of a MathContext.
+	// Division computes only the digits requested; with unlimited precision
+	// the quotient must have a terminating decimal expansion.
+	BigDecimal add(const BigDecimal &rhs, const MathContext &mc) const;
+	BigDecimal sub(const BigDecimal &rhs, const MathContext &mc) const;
+	BigDecimal mul(const BigDecimal &rhs, const MathContext &mc) const;
+	BigDecimal div(const BigDecimal &rhs, const MathContext &mc) const;
+
+	// Elementary functions rounded to the precision of a MathContext.
+	// Unlimited precision is accepted only where the result can be exact:
+	// sqrt of a perfect square and pow with an integral exponent.
+	BigDecimal sqrt(const MathContext &mc) const;
+	BigDecimal exp(const MathContext &mc) const;
+	BigDecimal ln(const MathContext &mc) const;
+	BigDecimal pow(int n, const MathContext &mc) const;
+	BigDecimal pow(const BigDecimal &y, const MathContext &mc) const;
 
 	int compare(double rhs) const { return compare(BigDecimal(rhs, scale_)); }
 	int compare(const BigDecimal &rhs) const;
 
+	// Hash of the value: equal numbers with different scales (1.5 and 1.50) hash alike
+	size_t hash() const;
+
 	//Comparison
 	bool operator > (double x) const { return compare(x) > 0; }
 	bool operator > (const BigDecimal &x) const { return compare(x) > 0; }
@@ -77,7 +167,7 @@ public:
 	void operator -= (const BigDecimal &rhs) { sub(rhs); }
 	void operator *= (double rhs) { mul(BigDecimal(rhs, scale_)); }
 	void operator *= (const BigDecimal &rhs) { mul(rhs); }
-	void operator /= (double rhs) { div(BigDecimal(rhs, scale_)); }
+	void operator /= (double rhs) { div(rhs); }
 	void operator /= (const BigDecimal &rhs) { div(rhs); }
 
 	BigDecimal operator + (double rhs) const { BigDecimal t(*this); t.add(BigDecimal(rhs, scale_)); return t; }
@@ -86,18 +176,50 @@ public:
 	BigDecimal operator - (const BigDecimal &rhs) const { BigDecimal t(*this); t.sub(rhs); return t; }
 	BigDecimal operator * (double rhs) const { BigDecimal t(*this); t.mul(BigDecimal(rhs, scale_)); return t; }
 	BigDecimal operator * (const BigDecimal &rhs) const { BigDecimal t(*this); t.mul(rhs); return t; }
-	BigDecimal operator / (double ths) const { BigDecimal t(*this); t.div(BigDecimal(ths, scale_)); return t; }
+	BigDecimal operator / (double ths) const { BigDecimal t(*this); t.div(ths); return t; }
 	BigDecimal operator / (const BigDecimal &rhs) const { BigDecimal t(*this); t.div(rhs); return t; }
 
+	// Division by an integer keeps the scale and rounds half up as the division above,
+	// but divides by a single digit instead of a long division. A power of ten only
+	// moves the decimal point.
+	void operator /= (int rhs) { divInt(magnitude(rhs), rhs < 0 ? -1 : 1, 0); }
+	void operator /= (long rhs) { divInt(magnitude(rhs), rhs < 0 ? -1 : 1, 0); }
+	void operator /= (unsigned int rhs) { divInt(rhs, 1, 0); }
+	void operator /= (unsigned long rhs) { divInt(rhs, 1, 0); }
+	void operator /= (sllong_t rhs) { divLong(rhs < 0 ? (ullong_t)0 - (ullong_t)rhs : (ullong_t)rhs, rhs < 0 ? -1 : 1); }
+	void operator /= (ullong_t rhs) { divLong(rhs, 1); }
+	BigDecimal operator / (int rhs) const { BigDecimal t(*this); t /= rhs; return t; }
+	BigDecimal operator / (long rhs) const { BigDecimal t(*this); t /= rhs; return t; }
+	BigDecimal operator / (unsigned int rhs) const { BigDecimal t(*this); t /= rhs; return t; }
+	BigDecimal operator / (unsigned long rhs) const { BigDecimal t(*this); t /= rhs; return t; }
+	BigDecimal operator / (sllong_t rhs) const { BigDecimal t(*this); t /= rhs; return t; }
+	BigDecimal operator / (ullong_t rhs) const { BigDecimal t(*this); t /= rhs; return t; }
+
 private:
 	void add(const BigDecimal &rhs);
 	void sub(const BigDecimal &rhs);
 	void mul(const BigDecimal &rhs);
 	void div(const BigDecimal &rhs);
+	void div(double rhs);
+	void divInt(uwrd_t d, int sign, int k);
+	void divLong(ullong_t d, int sign);
+	static uwrd_t magnitude(swrd_t v) { return v < 0 ? (uwrd_t)0 - (uwrd_t)v : (uwrd_t)v; }
+
+	int compareMag(const BigDecimal &rhs) const;
+	void addExact(const BigDecimal &rhs, bool subtract);
+	BigDecimal divExact(const BigDecimal &rhs) const;
+	void roundTo(int scale, RoundingMode mode);
+	void roundPrecision(const MathContext &mc);
+	void stripZeros(int scale);
 
 	int scale_;
 	vlong m_;
 };
 
+// Hash function object for hashed containers keyed by BigDecimal
+struct BigDecimalHash
+{
+	size_t operator()(const BigDecimal &x) const { return x.hash(); }
+};
 
 #endif // _BIG_DECIMAL_H_INCLUDED_
@@ -0,0 +1,480 @@
+/* BigDecimal10, fixed-point decimal numbers stored in base 10**9 limbs
+*
+* Decimal text conversions and rescaling without binary conversions.
+* Implementation is in plain C++ and thus architecture and endian-portable.
+*
+* Anyone can use it freely for any purpose. There is
+* absolutely no guarantee it works or fits a particular purpose (see below).
+*
+* This class has been made by Ruslan Yushchenko (yruslan@gmail.com)
+*
+* This is free and unencumbered software released into the public domain.
+*
+* Anyone is free to copy, modify, publish, use, compile, sell, or
+* distribute this software, either in source code form or as a compiled
+* binary, for any purpose, commercial or non-commercial, and by any
+* means.
+*
+* In jurisdictions that recognize copyright laws, the author or authors
+* of this software dedicate any and all copyright interest in the
+* software to the public domain. We make this dedication for the benefit
+* of the public at large and to the detriment of our heirs and
+* successors. We intend this dedication to be an overt act of
+* relinquishment in perpetuity of all present and future rights to this
+* software under copyright law.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* For more information, please refer to <http://unlicense.org/>
+*/
+#include "BigDecimal10.h"
+#include <string.h>
+#include <stdexcept>
+
+static const char *szFormatError = "Numeric Format Error";
+static const char *szRoundingError = "Rounding necessary";
+
+static const int LIMB_DIGITS = BIG_DECIMAL10_LIMB_DIGITS;
+static const udig_t LIMB_BASE = BIG_DECIMAL10_LIMB_BASE;
+
+// 10**n for 0 <= n <= LIMB_DIGITS-1
+static udig_t pow10(int n)
+{
+	udig_t p = 1;
+	while (n-- > 0)
+		p *= 10;
+	return p;
+}
+
+// a += b
+static void addMag(std::vector<udig_t> &a, const std::vector<udig_t> &b)
+{
+	if (a.size() < b.size())
+		a.resize(b.size(), 0);
+
+	udig_t carry = 0;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		uwrd_t t = (uwrd_t) a[i] + carry + (i < b.size() ? b[i] : 0);
+		carry = t >= LIMB_BASE ? 1 : 0;
+		a[i] = (udig_t) (carry ? t - LIMB_BASE : t);
+		if (carry == 0 && i >= b.size())
+			break;
+	}
+	if (carry)
+		a.push_back(carry);
+}
+
+// a -= b, must hold |a| >= |b|
+static void subMag(std::vector<udig_t> &a, const std::vector<udig_t> &b)
+{
+	udig_t borrow = 0;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		udig_t u = (i < b.size() ? b[i] : 0) + borrow;
+		borrow = a[i] < u ? 1 : 0;
+		a[i] = borrow ? a[i] + (LIMB_BASE - u) : a[i] - u;
+		if (borrow == 0 && i >= b.size())
+			break;
+	}
+}
+
+static int compareMag(const std::vector<udig_t> &a, const std::vector<udig_t> &b)
+{
+	if (a.size() != b.size())
+		return a.size() < b.size() ? -1 : 1;
+	for (size_t i = a.size(); i > 0; i--)
+	{
+		if (a[i - 1] != b[i - 1])
+			return a[i - 1] < b[i - 1] ? -1 : 1;
+	}
+	return 0;
+}
+
+BigDecimal10::BigDecimal10(int scale)
+	: sign_(1), scale_(scale < 0 ? 0 : scale)
+{
+
+}
+
+BigDecimal10::BigDecimal10(const char *szNumber)
+	: sign_(1), scale_(0)
+{
+	fromString(szNumber);
+}
+
+// Repeated division by the limb base, a single pass over the binary digits per limb
+BigDecimal10::BigDecimal10(const BigDecimal &x)
+	: sign_(1), scale_(x.getScale())
+{
+	vlong a, q;
+	sdig_t r;
+	a.Abs(x.getUnscaled());
+	while (!a.isZero())
+	{
+		q.Div(a, (sdig_t) LIMB_BASE, &r);
+		limbs_.push_back((udig_t) r);
+		a.swap(q);
+	}
+	if (x.getUnscaled().GetSign() < 0 && !limbs_.empty())
+		sign_ = -1;
+}
+
+// Horner's scheme over the limbs, a single MulAdd() pass per limb
+BigDecimal BigDecimal10::toBigDecimal() const
+{
+	vlong m;
+	for (size_t i = limbs_.size(); i > 0; i--)
+		m.MulAdd(m, LIMB_BASE, limbs_[i - 1]);
+	if (sign_ < 0)
+		m.SetSign(-1);
+	return BigDecimal(m, scale_);
+}
+
+void BigDecimal10::fromString(const char *szNumber)
+{
+	fromChars(szNumber, szNumber + strlen(szNumber));
+}
+
+void BigDecimal10::fromChars(const char *first, const char *last)
+{
+	const char *p = first;
+	bool negative = false, havePoint = false;
+	int scale = 0, exp = 0, digits = 0;
+
+	if (p < last && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	const char *mantissa = p;
+	for (; p < last; p++)
+	{
+		if (*p >= '0' && *p <= '9')
+		{
+			if (havePoint)
+				scale++;
+			digits++;
+			continue;
+		}
+		if (*p == '.' && !havePoint)
+		{
+			havePoint = true;
+			continue;
+		}
+		break;
+	}
+	if (digits == 0)
+		throw std::logic_error(szFormatError);
+	const char *mantissaEnd = p;
+
+	// Exponent
+	if (p < last && (*p == 'e' || *p == 'E'))
+	{
+		int expSign = 1;
+		p++;
+		if (p < last && (*p == '-' || *p == '+'))
+		{
+			expSign = *p == '-' ? -1 : 1;
+			p++;
+		}
+		if (p == last)
+			throw std::logic_error(szFormatError);
+		for (; p < last && *p >= '0' && *p <= '9'; p++)
+		{
+			if (exp >= 100000000)
+				throw std::logic_error(szFormatError);
+			exp = exp * 10 + *p - '0';
+		}
+		exp *= expSign;
+	}
+	if (p != last)
+		throw std::logic_error(szFormatError);
+
+	// Limbs are filled from the least significant digit
+	limbs_.clear();
+	limbs_.reserve(digits / LIMB_DIGITS + 1);
+	udig_t limb = 0, mul = 1;
+	int n = 0;
+	for (p = mantissaEnd; p > mantissa; p--)
+	{
+		if (p[-1] == '.')
+			continue;
+		limb += (udig_t) (p[-1] - '0') * mul;
+		mul *= 10;
+		if (++n == LIMB_DIGITS)
+		{
+			limbs_.push_back(limb);
+			limb = 0;
+			mul = 1;
+			n = 0;
+		}
+	}
+	if (n > 0)
+		limbs_.push_back(limb);
+	trim();
+
+	sign_ = negative && !limbs_.empty() ? -1 : 1;
+	scale_ = scale - exp;
+	if (scale_ < 0)
+	{
+		shiftLeft(-scale_);
+		scale_ = 0;
+	}
+}
+
+std::string BigDecimal10::toString() const
+{
+	// Most significant limb unpadded, the others with all of their digits
+	std::string digits;
+	digits.reserve(limbs_.size() * LIMB_DIGITS + 1);
+	char buf[LIMB_DIGITS];
+	for (size_t i = limbs_.size(); i > 0; i--)
+	{
+		udig_t limb = limbs_[i - 1];
+		int n = 0;
+		do
+		{
+			buf[n++] = (char) ('0' + limb % 10);
+			limb /= 10;
+		} while (i == limbs_.size() ? limb != 0 : n < LIMB_DIGITS);
+		while (n > 0)
+			digits += buf[--n];
+	}
+	if (digits.empty())
+		digits = "0";
+
+	// Same format as BigDecimal::toString(): no trailing fractional zeros
+	if ((int) digits.size() <= scale_)
+		digits.insert(0, scale_ + 1 - digits.size(), '0');
+	size_t point = digits.size() - scale_;
+	size_t end = digits.size();
+	while (end > point && digits[end - 1] == '0')
+		end--;
+
+	std::string result;
+	if (sign_ < 0)
+		result += '-';
+	result.append(digits, 0, point);
+	if (end > point)
+	{
+		result += '.';
+		result.append(digits, point, end - point);
+	}
+	return result;
+}
+
+void BigDecimal10::setScale(int scale)
+{
+	setScale(scale, ROUND_HALF_UP);
+}
+
+void BigDecimal10::setScale(int scale, RoundingMode mode)
+{
+	if (scale < 0) scale = 0;
+	if (scale > scale_)
+		shiftLeft(scale - scale_);
+	if (scale < scale_)
+		shiftRight(scale_ - scale, mode);
+	scale_ = scale;
+}
+
+int BigDecimal10::digitAt(int pos) const
+{
+	size_t i = pos / LIMB_DIGITS;
+	if (i >= limbs_.size())
+		return 0;
+	return (int) (limbs_[i] / pow10(pos % LIMB_DIGITS) % 10);
+}
+
+// Multiplies the magnitude by 10**digits: whole limbs are inserted below,
+// the remaining digits take a single pass
+void BigDecimal10::shiftLeft(int digits)
+{
+	if (limbs_.empty())
+		return;
+
+	int part = digits % LIMB_DIGITS;
+	if (part > 0)
+	{
+		udig_t p10 = pow10(part);
+		uwrd_t carry = 0;
+		for (size_t i = 0; i < limbs_.size(); i++)
+		{
+			uwrd_t t = (uwrd_t) limbs_[i] * p10 + carry;
+			limbs_[i] = (udig_t) (t % LIMB_BASE);
+			carry = t / LIMB_BASE;
+		}
+		if (carry)
+			limbs_.push_back((udig_t) carry);
+	}
+	limbs_.insert(limbs_.begin(), digits / LIMB_DIGITS, 0);
+}
+
+// Divides the magnitude by 10**digits rounding by the dropped digits
+void BigDecimal10::shiftRight(int digits, RoundingMode mode)
+{
+	if (limbs_.empty())
+		return;
+
+	// The first dropped digit and whether anything below it is nonzero
+	int first = digitAt(digits - 1);
+	size_t i, low = (digits - 1) / LIMB_DIGITS;
+	bool rest = low < limbs_.size() && limbs_[low] % pow10((digits - 1) % LIMB_DIGITS) != 0;
+	for (i = 0; i < low && i < limbs_.size() && !rest; i++)
+		rest = limbs_[i] != 0;
+
+	size_t whole = digits / LIMB_DIGITS;
+	if (whole >= limbs_.size())
+		limbs_.clear();
+	else
+		limbs_.erase(limbs_.begin(), limbs_.begin() + whole);
+
+	int part = digits % LIMB_DIGITS;
+	if (part > 0 && !limbs_.empty())
+	{
+		udig_t p10 = pow10(part);
+		udig_t rem = 0;
+		for (i = limbs_.size(); i > 0; i--)
+		{
+			uwrd_t t = (uwrd_t) rem * LIMB_BASE + limbs_[i - 1];
+			limbs_[i - 1] = (udig_t) (t / p10);
+			rem = (udig_t) (t % p10);
+		}
+	}
+	// the sign is still needed for rounding
+	while (!limbs_.empty() && limbs_.back() == 0)
+		limbs_.pop_back();
+
+	bool up = false;
+	if (first != 0 || rest)
+	{
+		switch (mode)
+		{
+		case ROUND_UP:
+			up = true;
+			break;
+		case ROUND_DOWN:
+			break;
+		case ROUND_CEILING:
+			up = sign_ > 0;
+			break;
+		case ROUND_FLOOR:
+			up = sign_ < 0;
+			break;
+		case ROUND_UNNECESSARY:
+			throw std::logic_error(szRoundingError);
+		default:
+			if (first != 5)
+				up = first > 5;
+			else if (rest)
+				up = true;
+			else
+				up = mode == ROUND_HALF_UP || (mode == ROUND_HALF_EVEN && !limbs_.empty() && (limbs_[0] & 1));
+		}
+	}
+	if (up)
+	{
+		std::vector<udig_t> one(1, 1);
+		addMag(limbs_, one);
+	}
+	if (limbs_.empty())
+		sign_ = 1;
+}
+
+void BigDecimal10::trim()
+{
+	while (!limbs_.empty() && limbs_.back() == 0)
+		limbs_.pop_back();
+	if (limbs_.empty())
+		sign_ = 1;
+}
+
+int BigDecimal10::compare(const BigDecimal10 &rhs) const
+{
+	int sign = limbs_.empty() ? 0 : sign_;
+	int rhsSign = rhs.limbs_.empty() ? 0 : rhs.sign_;
+	if (sign != rhsSign)
+		return sign < rhsSign ? -1 : 1;
+	if (sign == 0)
+		return 0;
+	if (scale_ == rhs.scale_)
+		return sign * compareMag(limbs_, rhs.limbs_);
+
+	BigDecimal10 tmp(scale_ < rhs.scale_ ? *this : rhs);
+	tmp.setScale(scale_ < rhs.scale_ ? rhs.scale_ : scale_);
+	if (scale_ < rhs.scale_)
+		return sign * compareMag(tmp.limbs_, rhs.limbs_);
+	return sign * compareMag(limbs_, tmp.limbs_);
+}
+
+// Same as BigDecimal: the result has the scale of the left operand
+void BigDecimal10::add(const BigDecimal10 &rhs, bool subtract)
+{
+	int scale = scale_;
+	BigDecimal10 b(rhs);
+	if (subtract)
+		b.sign_ = -b.sign_;
+	if (b.scale_ < scale_)
+		b.setScale(scale_);
+	if (b.scale_ > scale_)
+		setScale(b.scale_);
+
+	if (limbs_.empty() || sign_ == b.sign_)
+	{
+		if (limbs_.empty())
+			sign_ = b.sign_;
+		addMag(limbs_, b.limbs_);
+	}
+	else if (compareMag(limbs_, b.limbs_) >= 0)
+	{
+		subMag(limbs_, b.limbs_);
+	}
+	else
+	{
+		subMag(b.limbs_, limbs_);
+		limbs_.swap(b.limbs_);
+		sign_ = b.sign_;
+	}
+	trim();
+	setScale(scale);
+}
+
+// Schoolbook multiplication, the product of two limbs plus a limb
+// and a carry fits a word
+void BigDecimal10::mul(const BigDecimal10 &rhs)
+{
+	int scale = scale_;
+	const std::vector<udig_t> &a = limbs_, &b = rhs.limbs_;
+	std::vector<udig_t> r(a.size() + b.size(), 0);
+
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		uwrd_t carry = 0;
+		for (size_t j = 0; j < b.size(); j++)
+		{
+			uwrd_t t = (uwrd_t) a[i] * b[j] + r[i + j] + carry;
+			r[i + j] = (udig_t) (t % LIMB_BASE);
+			carry = t / LIMB_BASE;
+		}
+		r[i + b.size()] = (udig_t) carry;
+	}
+
+	limbs_.swap(r);
+	sign_ *= rhs.sign_;
+	scale_ += rhs.scale_;
+	trim();
+	setScale(scale);
+}
+
+void BigDecimal10::div(const BigDecimal10 &rhs)
+{
+	*this = BigDecimal10(toBigDecimal() / rhs.toBigDecimal());
+}
@@ -0,0 +1,126 @@
+/* BigDecimal10, fixed-point decimal numbers stored in base 10**9 limbs
+*
+* Decimal text conversions and rescaling without binary conversions.
+* Implementation is in plain C++ and thus architecture and endian-portable.
+*
+* Anyone can use it freely for any purpose. There is
+* absolutely no guarantee it works or fits a particular purpose (see below).
+*
+* This class has been made by Ruslan Yushchenko (yruslan@gmail.com)
+*
+* This is free and unencumbered software released into the public domain.
+*
+* Anyone is free to copy, modify, publish, use, compile, sell, or
+* distribute this software, either in source code form or as a compiled
+* binary, for any purpose, commercial or non-commercial, and by any
+* means.
+*
+* In jurisdictions that recognize copyright laws, the author or authors
+* of this software dedicate any and all copyright interest in the
+* software to the public domain. We make this dedication for the benefit
+* of the public at large and to the detriment of our heirs and
+* successors. We intend this dedication to be an overt act of
+* relinquishment in perpetuity of all present and future rights to this
+* software under copyright law.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* For more information, please refer to <http://unlicense.org/>
+*/
+#ifndef _BIG_DECIMAL10_H_INCLUDED_
+#define _BIG_DECIMAL10_H_INCLUDED_
+
+#include <vector>
+#include <string>
+#include "BigDecimal.h"
+
+//Configuration
+//Decimal digits in a limb and the limb base: the largest power of 10
+//that fits a signed vlong digit, so that a product of two limbs fits a word
+//and the base can be passed to vlong::Div(const vlong &, sdig_t)
+#if defined(VLONG_64BIT)
+#define BIG_DECIMAL10_LIMB_DIGITS   18
+#define BIG_DECIMAL10_LIMB_BASE     1000000000000000000L
+#elif defined(VLONG_32BIT)
+#define BIG_DECIMAL10_LIMB_DIGITS   9
+#define BIG_DECIMAL10_LIMB_BASE     1000000000
+#elif defined(VLONG_16BIT)
+#define BIG_DECIMAL10_LIMB_DIGITS   4
+#define BIG_DECIMAL10_LIMB_BASE     10000
+#else
+#define BIG_DECIMAL10_LIMB_DIGITS   2
+#define BIG_DECIMAL10_LIMB_BASE     100
+#endif
+
+// Fixed-point decimal number with the same semantics as BigDecimal, but the
+// unscaled value is kept in base 10**9 limbs (10**18 with 64-bit digits)
+// instead of binary vlong digits.
+//
+// Parsing and formatting are linear in the number of digits, and rescaling
+// by whole limbs only moves limbs. Addition, subtraction and multiplication
+// work on the decimal limbs. Division goes through BigDecimal, and so can
+// any multiply/divide heavy code: toBigDecimal() and the BigDecimal
+// constructor convert between the two representations.
+class BigDecimal10
+{
+public:
+	explicit BigDecimal10(int scale = 0);
+	explicit BigDecimal10(const char *szNumber);
+	explicit BigDecimal10(const BigDecimal &x);
+
+	void fromString(const char *szNumber);
+
+	// Parses characters in [first, last), e.g. "-123.4500" or "1.5E-3"
+	void fromChars(const char *first, const char *last);
+
+	std::string toString() const;
+
+	// Bridge to the binary representation
+	BigDecimal toBigDecimal() const;
+
+	int getScale() const { return scale_; }
+	void setScale(int scale);
+	void setScale(int scale, RoundingMode mode);
+
+	int compare(const BigDecimal10 &rhs) const;
+
+	//Comparison
+	bool operator > (const BigDecimal10 &x) const { return compare(x) > 0; }
+	bool operator >= (const BigDecimal10 &x) const { return compare(x) >= 0; }
+	bool operator < (const BigDecimal10 &x) const { return compare(x) < 0; }
+	bool operator <= (const BigDecimal10 &x) const { return compare(x) <= 0; }
+	bool operator == (const BigDecimal10 &x) const { return compare(x) == 0; }
+	bool operator != (const BigDecimal10 &x) const { return compare(x) != 0; }
+
+	void operator += (const BigDecimal10 &rhs) { add(rhs, false); }
+	void operator -= (const BigDecimal10 &rhs) { add(rhs, true); }
+	void operator *= (const BigDecimal10 &rhs) { mul(rhs); }
+	void operator /= (const BigDecimal10 &rhs) { div(rhs); }
+
+	BigDecimal10 operator + (const BigDecimal10 &rhs) const { BigDecimal10 t(*this); t.add(rhs, false); return t; }
+	BigDecimal10 operator - (const BigDecimal10 &rhs) const { BigDecimal10 t(*this); t.add(rhs, true); return t; }
+	BigDecimal10 operator * (const BigDecimal10 &rhs) const { BigDecimal10 t(*this); t.mul(rhs); return t; }
+	BigDecimal10 operator / (const BigDecimal10 &rhs) const { BigDecimal10 t(*this); t.div(rhs); return t; }
+
+private:
+	void add(const BigDecimal10 &rhs, bool subtract);
+	void mul(const BigDecimal10 &rhs);
+	void div(const BigDecimal10 &rhs);
+
+	void shiftLeft(int digits);
+	void shiftRight(int digits, RoundingMode mode);
+	int digitAt(int pos) const;
+	void trim();
+
+	std::vector<udig_t> limbs_;  // magnitude, least significant limb first, no leading zero limbs
+	int sign_;                   // -1 for negative numbers, 1 otherwise
+	int scale_;
+};
+
+#endif // _BIG_DECIMAL10_H_INCLUDED_
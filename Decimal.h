@@ -0,0 +1,324 @@
+/* Decimal, fixed-point decimal numbers with a compile-time scale
+*
+* Machine word storage with scaling constants fixed at compile time.
+* Implementation is in plain C++ and thus architecture and endian-portable.
+*
+* Anyone can use it freely for any purpose. There is
+* absolutely no guarantee it works or fits a particular purpose (see below).
+*
+* This class has been made by Ruslan Yushchenko (yruslan@gmail.com)
+*
+* This is free and unencumbered software released into the public domain.
+*
+* Anyone is free to copy, modify, publish, use, compile, sell, or
+* distribute this software, either in source code form or as a compiled
+* binary, for any purpose, commercial or non-commercial, and by any
+* means.
+*
+* In jurisdictions that recognize copyright laws, the author or authors
+* of this software dedicate any and all copyright interest in the
+* software to the public domain. We make this dedication for the benefit
+* of the public at large and to the detriment of our heirs and
+* successors. We intend this dedication to be an overt act of
+* relinquishment in perpetuity of all present and future rights to this
+* software under copyright law.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* For more information, please refer to <http://unlicense.org/>
+*/
+#ifndef _DECIMAL_H_INCLUDED_
+#define _DECIMAL_H_INCLUDED_
+
+#include <string>
+#include "BigDecimal.h"
+
+// 10**N as a word, computed by the compiler
+template<int N>
+struct DecimalPow10
+{
+	static swrd_t value() { return 10 * DecimalPow10<N - 1>::value(); }
+};
+
+template<>
+struct DecimalPow10<0>
+{
+	static swrd_t value() { return 1; }
+};
+
+// Whether 10**N fits a signed Storage, N <= (bits - 1) * log10(2)
+template<int N, class Storage>
+struct DecimalPow10Fits
+{
+	enum { value = N <= (int) ((sizeof(Storage) * 8 - 1) * 30103 / 100000) };
+};
+
+template<int A, int B>
+struct DecimalMax
+{
+	enum { value = A > B ? A : B };
+};
+
+// Range of a signed integer storage type
+template<class Storage>
+struct DecimalLimits
+{
+	static Storage max() { return (Storage) (((((Storage) 1 << (sizeof(Storage) * 8 - 2)) - 1) << 1) + 1); }
+	static Storage min() { return (Storage) (-max() - 1); }
+
+	// Magnitudes below this bound multiply without overflow
+	static Storage mulMax() { return (Storage) 1 << (sizeof(Storage) * 4 - 1); }
+};
+
+// Fixed-point decimal number with the scale as a template parameter, e.g.
+// Decimal<2> for cents or Decimal<8> for 1e-8 units.
+//
+// The unscaled value is a signed machine integer (Storage, swrd_t by default:
+// 64 bits, or 128 bits with VLONG_64BIT). All powers of 10 and overflow
+// bounds depend only on template parameters, so the compiler folds them into
+// constants. A result that does not fit Storage spills into a vlong and the
+// arithmetic continues exactly on the slow path.
+//
+// Addition and comparison of different scales return the larger scale and
+// multiplication the sum of the scales, both resolved at compile time.
+// Division and rescale<>() to a smaller scale round half up like BigDecimal.
+template<int Scale, class Storage = swrd_t>
+class Decimal
+{
+	template<int, class> friend class Decimal;
+
+	// Conversions to vlong go through a signed word
+	typedef char StorageFitsWord[sizeof(Storage) <= sizeof(swrd_t) ? 1 : -1];
+
+public:
+	enum { scale = Scale };
+
+	Decimal() : value_(0), spill_(NULL) {}
+	Decimal(const Decimal &x) : value_(x.value_), spill_(x.spill_ ? new vlong(*x.spill_) : NULL) {}
+	explicit Decimal(const char *szNumber) : value_(0), spill_(NULL) { assign(BigDecimal(szNumber)); }
+	explicit Decimal(const BigDecimal &x) : value_(0), spill_(NULL) { assign(x); }
+	~Decimal() { delete spill_; }
+
+	Decimal &operator = (const Decimal &x)
+	{
+		if (this != &x)
+		{
+			if (x.spill_)
+				setSpill(*x.spill_);
+			else
+				setValue(x.value_);
+		}
+		return *this;
+	}
+
+	static Decimal fromUnscaled(Storage v) { Decimal d; d.value_ = v; return d; }
+
+	// The unscaled value is valid unless the number spilled
+	Storage unscaled() const { return value_; }
+	bool spilled() const { return spill_ != NULL; }
+
+	BigDecimal toBigDecimal() const
+	{
+		vlong m;
+		getUnscaled(m);
+		return BigDecimal(m, Scale);
+	}
+	std::string toString() const { return toBigDecimal().toString(); }
+
+	// Rounds half up when the scale is reduced. Scale differences whose power
+	// of 10 does not fit Storage go through BigDecimal.
+	template<int S2>
+	Decimal<S2, Storage> rescale() const
+	{
+		enum { diff = S2 > Scale ? S2 - Scale : Scale - S2, fits = DecimalPow10Fits<diff, Storage>::value };
+		Decimal<S2, Storage> r;
+		if (spill_ == NULL && fits)
+		{
+			const Storage f = (Storage) DecimalPow10<fits ? (int) diff : 0>::value();
+			if (S2 < Scale)
+			{
+				Storage q = value_ / f, rem = value_ % f;
+				if (rem > 0 && rem >= f - rem)
+					q++;
+				if (rem < 0 && -rem >= f + rem)
+					q--;
+				r.value_ = q;
+				return r;
+			}
+			if (value_ <= DecimalLimits<Storage>::max() / f && value_ >= -(DecimalLimits<Storage>::max() / f))
+			{
+				r.value_ = value_ * f;
+				return r;
+			}
+		}
+		BigDecimal b = toBigDecimal();
+		b.setScale(S2);
+		r.assign(b);
+		return r;
+	}
+
+	//Arithmetic
+	Decimal operator - () const
+	{
+		Decimal r;
+		if (spill_ == NULL && value_ != DecimalLimits<Storage>::min())
+		{
+			r.value_ = -value_;
+			return r;
+		}
+		vlong m;
+		getUnscaled(m);
+		m.SetSign(-m.GetSign());
+		r.assign(m);
+		return r;
+	}
+
+	Decimal operator + (const Decimal &rhs) const { Decimal r(*this); r.add(rhs, false); return r; }
+	Decimal operator - (const Decimal &rhs) const { Decimal r(*this); r.add(rhs, true); return r; }
+	void operator += (const Decimal &rhs) { add(rhs, false); }
+	void operator -= (const Decimal &rhs) { add(rhs, true); }
+
+	template<int S2>
+	Decimal<DecimalMax<Scale, S2>::value, Storage> operator + (const Decimal<S2, Storage> &rhs) const
+	{
+		return rescale<DecimalMax<Scale, S2>::value>() + rhs.template rescale<DecimalMax<Scale, S2>::value>();
+	}
+
+	template<int S2>
+	Decimal<DecimalMax<Scale, S2>::value, Storage> operator - (const Decimal<S2, Storage> &rhs) const
+	{
+		return rescale<DecimalMax<Scale, S2>::value>() - rhs.template rescale<DecimalMax<Scale, S2>::value>();
+	}
+
+	// Exact product, its scale is the sum of the scales
+	template<int S2>
+	Decimal<Scale + S2, Storage> operator * (const Decimal<S2, Storage> &rhs) const
+	{
+		Decimal<Scale + S2, Storage> r;
+		const Storage lim = DecimalLimits<Storage>::mulMax();
+		if (spill_ == NULL && rhs.spill_ == NULL &&
+			(value_ < lim) && (value_ > -lim) && (rhs.value_ < lim) && (rhs.value_ > -lim))
+		{
+			r.value_ = value_ * rhs.value_;
+			return r;
+		}
+		vlong a, b;
+		getUnscaled(a);
+		rhs.getUnscaled(b);
+		a.Mul(a, b);
+		r.assign(a);
+		return r;
+	}
+
+	// Quotient at the scale of the left operand, rounded half up
+	template<int S2>
+	Decimal operator / (const Decimal<S2, Storage> &rhs) const
+	{
+		return Decimal(toBigDecimal() / rhs.toBigDecimal());
+	}
+
+	//Comparison
+	int compare(const Decimal &rhs) const
+	{
+		if (spill_ == NULL && rhs.spill_ == NULL)
+			return value_ < rhs.value_ ? -1 : value_ > rhs.value_ ? 1 : 0;
+		return toBigDecimal().compare(rhs.toBigDecimal());
+	}
+
+	template<int S2>
+	int compare(const Decimal<S2, Storage> &rhs) const
+	{
+		return rescale<DecimalMax<Scale, S2>::value>().compare(rhs.template rescale<DecimalMax<Scale, S2>::value>());
+	}
+
+	template<int S2> bool operator > (const Decimal<S2, Storage> &x) const { return compare(x) > 0; }
+	template<int S2> bool operator >= (const Decimal<S2, Storage> &x) const { return compare(x) >= 0; }
+	template<int S2> bool operator < (const Decimal<S2, Storage> &x) const { return compare(x) < 0; }
+	template<int S2> bool operator <= (const Decimal<S2, Storage> &x) const { return compare(x) <= 0; }
+	template<int S2> bool operator == (const Decimal<S2, Storage> &x) const { return compare(x) == 0; }
+	template<int S2> bool operator != (const Decimal<S2, Storage> &x) const { return compare(x) != 0; }
+
+private:
+	void add(const Decimal &rhs, bool subtract)
+	{
+		if (spill_ == NULL && rhs.spill_ == NULL)
+		{
+			Storage b = rhs.value_;
+			bool fits;
+			if (subtract)
+				fits = b >= 0 ? value_ >= DecimalLimits<Storage>::min() + b : value_ <= DecimalLimits<Storage>::max() + b;
+			else
+				fits = b >= 0 ? value_ <= DecimalLimits<Storage>::max() - b : value_ >= DecimalLimits<Storage>::min() - b;
+			if (fits)
+			{
+				value_ = subtract ? value_ - b : value_ + b;
+				return;
+			}
+		}
+		vlong a, b;
+		getUnscaled(a);
+		rhs.getUnscaled(b);
+		if (subtract)
+			a.Sub(a, b);
+		else
+			a.Add(a, b);
+		assign(a);
+	}
+
+	void getUnscaled(vlong &m) const
+	{
+		if (spill_ != NULL)
+			m = *spill_;
+		else
+			m.SetWord((swrd_t) value_);
+	}
+
+	void assign(const BigDecimal &x)
+	{
+		if (x.getScale() == Scale)
+		{
+			assign(x.getUnscaled());
+			return;
+		}
+		BigDecimal t(x);
+		t.setScale(Scale);
+		assign(t.getUnscaled());
+	}
+
+	// Keeps the unscaled value in Storage if it fits, spills otherwise
+	void assign(const vlong &m)
+	{
+		swrd_t w;
+		if (m.GetWord(&w) == VLONG_SUCCESS && w >= (swrd_t) DecimalLimits<Storage>::min() && w <= (swrd_t) DecimalLimits<Storage>::max())
+			setValue((Storage) w);
+		else
+			setSpill(m);
+	}
+
+	void setValue(Storage v)
+	{
+		delete spill_;
+		spill_ = NULL;
+		value_ = v;
+	}
+
+	void setSpill(const vlong &m)
+	{
+		if (spill_ == NULL)
+			spill_ = new vlong(m);
+		else
+			*spill_ = m;
+		value_ = 0;
+	}
+
+	Storage value_;
+	vlong *spill_;  // unscaled value if it does not fit Storage
+};
+
+#endif // _DECIMAL_H_INCLUDED_
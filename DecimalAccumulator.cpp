@@ -0,0 +1,166 @@
+/* DecimalAccumulator, exact summation of many BigDecimal numbers
+*
+* Keeps per-scale partial sums with deferred carry propagation.
+* Implementation is in plain C++ and thus architecture and endian-portable.
+*
+* Anyone can use it freely for any purpose. There is
+* absolutely no guarantee it works or fits a particular purpose (see below).
+*
+* This class has been made by Ruslan Yushchenko (yruslan@gmail.com)
+*
+* This is free and unencumbered software released into the public domain.
+*
+* Anyone is free to copy, modify, publish, use, compile, sell, or
+* distribute this software, either in source code form or as a compiled
+* binary, for any purpose, commercial or non-commercial, and by any
+* means.
+*
+* In jurisdictions that recognize copyright laws, the author or authors
+* of this software dedicate any and all copyright interest in the
+* software to the public domain. We make this dedication for the benefit
+* of the public at large and to the detriment of our heirs and
+* successors. We intend this dedication to be an overt act of
+* relinquishment in perpetuity of all present and future rights to this
+* software under copyright law.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* For more information, please refer to <http://unlicense.org/>
+*/
+#include "DecimalAccumulator.h"
+#include <string.h>
+
+// Bits in a single digit
+static const int DIGIT_BITS = (int)sizeof(udig_t)*8;
+
+// Adds into a register before its lanes have to be flushed. Every add changes
+// a lane by less than 2**DIGIT_BITS, and a lane holds 2**(2*DIGIT_BITS-1).
+static const size_t MAX_PENDING = ((size_t)1) << (DIGIT_BITS - 1 < 30 ? DIGIT_BITS - 1 : 30);
+
+DecimalAccumulator::DecimalAccumulator()
+	: last_(0), count_(0)
+{
+
+}
+
+void DecimalAccumulator::clear()
+{
+	partials_.clear();
+	last_ = 0;
+	count_ = 0;
+}
+
+DecimalAccumulator::Partial &DecimalAccumulator::partial(int scale)
+{
+	// Sums usually see long runs of the same scale
+	if (last_ < partials_.size() && partials_[last_].scale == scale)
+		return partials_[last_];
+
+	for (last_ = 0; last_ < partials_.size(); last_++)
+	{
+		if (partials_[last_].scale == scale)
+			return partials_[last_];
+	}
+
+	Partial p;
+	p.scale = scale;
+	p.pending = 0;
+	memset(p.lanes, 0, sizeof(p.lanes));
+	partials_.push_back(p);
+	return partials_[last_];
+}
+
+// Propagate the carries of the register into the vlong partial sum
+void DecimalAccumulator::flush(Partial &p)
+{
+	vlong t;
+	for (int j = 0; j < DECIMAL_ACCUMULATOR_DIGITS; j++)
+	{
+		if (p.lanes[j] == 0)
+			continue;
+		t.SetWord(p.lanes[j]);
+		t.ShiftLeft(t, j * DIGIT_BITS);
+		p.sum.Add(p.sum, t);
+		p.lanes[j] = 0;
+	}
+	p.pending = 0;
+}
+
+void DecimalAccumulator::add(const BigDecimal &v)
+{
+	const vlong &m = v.getUnscaled();
+	size_t j, n = m.GetNumDigits();
+
+	count_++;
+	if (n == 0)
+		return;
+
+	Partial &p = partial(v.getScale());
+	if (n > DECIMAL_ACCUMULATOR_DIGITS)
+	{
+		p.sum.Add(p.sum, m);
+		return;
+	}
+
+	if (p.pending == MAX_PENDING)
+		flush(p);
+
+	if (m.GetSign() < 0)
+	{
+		for (j = 0; j < n; j++)
+			p.lanes[j] -= (swrd_t) m.GetDigit(j);
+	}
+	else
+	{
+		for (j = 0; j < n; j++)
+			p.lanes[j] += (swrd_t) m.GetDigit(j);
+	}
+	p.pending++;
+}
+
+void DecimalAccumulator::merge(const DecimalAccumulator &other)
+{
+	for (size_t i = 0; i < other.partials_.size(); i++)
+	{
+		const Partial &o = other.partials_[i];
+		Partial &p = partial(o.scale);
+
+		// Registers are added lane by lane while the sum of pending adds still fits
+		if (p.pending + o.pending > MAX_PENDING)
+			flush(p);
+		for (int j = 0; j < DECIMAL_ACCUMULATOR_DIGITS; j++)
+			p.lanes[j] += o.lanes[j];
+		p.pending += o.pending;
+		p.sum.Add(p.sum, o.sum);
+	}
+	count_ += other.count_;
+}
+
+BigDecimal DecimalAccumulator::result() const
+{
+	int scale = 0;
+	size_t i;
+
+	for (i = 0; i < partials_.size(); i++)
+		scale = partials_[i].scale > scale ? partials_[i].scale : scale;
+
+	vlong total, p10;
+	for (i = 0; i < partials_.size(); i++)
+	{
+		Partial p(partials_[i]);
+		flush(p);
+		if (p.scale < scale)
+		{
+			p10.Pow(10, scale - p.scale);
+			p.sum.Mul(p.sum, p10);
+		}
+		total.Add(total, p.sum);
+	}
+	return BigDecimal(total, scale);
+}
@@ -0,0 +1,88 @@
+/* DecimalAccumulator, exact summation of many BigDecimal numbers
+*
+* Keeps per-scale partial sums with deferred carry propagation.
+* Implementation is in plain C++ and thus architecture and endian-portable.
+*
+* Anyone can use it freely for any purpose. There is
+* absolutely no guarantee it works or fits a particular purpose (see below).
+*
+* This class has been made by Ruslan Yushchenko (yruslan@gmail.com)
+*
+* This is free and unencumbered software released into the public domain.
+*
+* Anyone is free to copy, modify, publish, use, compile, sell, or
+* distribute this software, either in source code form or as a compiled
+* binary, for any purpose, commercial or non-commercial, and by any
+* means.
+*
+* In jurisdictions that recognize copyright laws, the author or authors
+* of this software dedicate any and all copyright interest in the
+* software to the public domain. We make this dedication for the benefit
+* of the public at large and to the detriment of our heirs and
+* successors. We intend this dedication to be an overt act of
+* relinquishment in perpetuity of all present and future rights to this
+* software under copyright law.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* For more information, please refer to <http://unlicense.org/>
+*/
+#ifndef _DECIMAL_ACCUMULATOR_H_INCLUDED_
+#define _DECIMAL_ACCUMULATOR_H_INCLUDED_
+
+#include <vector>
+#include "BigDecimal.h"
+
+//Configuration
+//Digits in the fixed-size register kept for every scale.
+//Wider values are added to a vlong partial sum directly.
+#define DECIMAL_ACCUMULATOR_DIGITS  8
+
+// Exact sum of many BigDecimal numbers.
+//
+// Every add() only adds the digits of the unscaled value to the register of
+// its scale. The register lanes are double digit words, so carries are not
+// propagated until one of the lanes could overflow or the result is requested.
+// Scales are aligned only once, in result().
+//
+// An accumulator is not thread-safe. For parallel aggregation use one
+// accumulator per thread and merge() them at the end.
+class DecimalAccumulator
+{
+public:
+	DecimalAccumulator();
+
+	void add(const BigDecimal &v);
+	void merge(const DecimalAccumulator &other);
+	void clear();
+
+	// Number of values added (including merged accumulators)
+	size_t count() const { return count_; }
+
+	// Exact sum at the largest scale seen
+	BigDecimal result() const;
+
+private:
+	struct Partial
+	{
+		int scale;
+		size_t pending;
+		swrd_t lanes[DECIMAL_ACCUMULATOR_DIGITS];
+		vlong sum;
+	};
+
+	Partial &partial(int scale);
+	static void flush(Partial &p);
+
+	std::vector<Partial> partials_;
+	size_t last_;
+	size_t count_;
+};
+
+#endif // _DECIMAL_ACCUMULATOR_H_INCLUDED_
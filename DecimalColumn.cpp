@@ -0,0 +1,592 @@
+/* DecimalColumn, a column of fixed-point numbers sharing one scale
+*
+* Stores mantissas as contiguous machine words and spills the ones that overflow to vlong.
+* Implementation is in plain C++ and thus architecture and endian-portable.
+*
+* Anyone can use it freely for any purpose. There is
+* absolutely no guarantee it works or fits a particular purpose (see below).
+*
+* This class has been made by Ruslan Yushchenko (yruslan@gmail.com)
+*
+* This is free and unencumbered software released into the public domain.
+*
+* Anyone is free to copy, modify, publish, use, compile, sell, or
+* distribute this software, either in source code form or as a compiled
+* binary, for any purpose, commercial or non-commercial, and by any
+* means.
+*
+* In jurisdictions that recognize copyright laws, the author or authors
+* of this software dedicate any and all copyright interest in the
+* software to the public domain. We make this dedication for the benefit
+* of the public at large and to the detriment of our heirs and
+* successors. We intend this dedication to be an overt act of
+* relinquishment in perpetuity of all present and future rights to this
+* software under copyright law.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* For more information, please refer to <http://unlicense.org/>
+*/
+#include "DecimalColumn.h"
+#include <stdexcept>
+
+static const char *szSizeError = "Column Size Mismatch";
+static const char *szOverflowError = "Value does not fit the decimal type";
+
+// Marks a spilled entry. It is the most negative word and is never stored inline.
+static const swrd_t SPILL = (swrd_t)(((uwrd_t)1) << (sizeof(uwrd_t)*8 - 1));
+static const swrd_t WORD_MAX = (swrd_t)(~((uwrd_t)SPILL));
+
+// Bits in a single digit
+static const int DIGIT_BITS = (int)sizeof(udig_t)*8;
+
+static inline uwrd_t absWord(swrd_t v)
+{
+	return v < 0 ? ((uwrd_t)0) - (uwrd_t)v : (uwrd_t)v;
+}
+
+DecimalColumn::DecimalColumn(int scale, size_t size)
+	: scale_(scale < 0 ? 0 : scale), m_(size, 0)
+{
+
+}
+
+void DecimalColumn::resize(size_t size)
+{
+	spill_.erase(spill_.lower_bound(size), spill_.end());
+	m_.resize(size, 0);
+}
+
+void DecimalColumn::getValue(size_t i, vlong &v) const
+{
+	if (m_[i] == SPILL)
+		v = spill_.find(i)->second;
+	else
+		v.SetWord(m_[i]);
+}
+
+void DecimalColumn::setValue(size_t i, const vlong &v)
+{
+	swrd_t w;
+	if (v.GetWord(&w) == VLONG_SUCCESS && w != SPILL)
+	{
+		if (m_[i] == SPILL)
+			spill_.erase(i);
+		m_[i] = w;
+	}
+	else
+	{
+		m_[i] = SPILL;
+		spill_[i] = v;
+	}
+}
+
+BigDecimal DecimalColumn::get(size_t i) const
+{
+	vlong v;
+	getValue(i, v);
+	return BigDecimal(v, scale_);
+}
+
+void DecimalColumn::set(size_t i, const BigDecimal &v)
+{
+	if (v.getScale() == scale_)
+	{
+		setValue(i, v.getUnscaled());
+		return;
+	}
+	BigDecimal t(v);
+	t.setScale(scale_);
+	setValue(i, t.getUnscaled());
+}
+
+void DecimalColumn::push_back(const BigDecimal &v)
+{
+	m_.push_back(0);
+	set(m_.size() - 1, v);
+}
+
+void DecimalColumn::fromFixedWidth(const char *in, size_t count, size_t width, int scale)
+{
+	const unsigned char *p = (const unsigned char *) in;
+	const size_t nw = width < sizeof(swrd_t) ? width : sizeof(swrd_t);
+	int target = scale_;
+	vlong v;
+
+	spill_.clear();
+	m_.assign(count, 0);
+	if (width == 0)
+		return;
+
+	for (size_t i = 0; i < count; i++, p += width)
+	{
+		// The value is kept inline if the bytes above a word only repeat its sign
+		unsigned char ext = (p[nw - 1] & 0x80) ? 0xFF : 0;
+		uwrd_t u = ext ? ~(uwrd_t)0 : 0;
+		size_t k;
+		bool inline_ = true;
+
+		for (k = nw; k-- > 0; )
+			u = (u << 8) | p[k];
+		for (k = nw; k < width; k++)
+			inline_ = inline_ && p[k] == ext;
+
+		if (inline_ && (swrd_t)u != SPILL)
+			m_[i] = (swrd_t)u;
+		else
+		{
+			v.FromTwosComplementLE((const char *)p, width);
+			setValue(i, v);
+		}
+	}
+
+	if (scale < 0)
+	{
+		vlong p10;
+		p10.Pow(10, -scale);
+		scale_ = 0;
+		mul(BigDecimal(p10, 0));
+	}
+	else
+		scale_ = scale;
+	rescale(target);
+}
+
+void DecimalColumn::toFixedWidth(char *out, size_t width, int precision) const
+{
+	unsigned char *p = (unsigned char *) out;
+	vlong v, limit;
+	swrd_t wordLimit = 0;
+
+	// Inline values are checked against the limit as a word when it fits one
+	if (precision > 0)
+	{
+		limit.Pow(10, precision);
+		if (limit.GetWord(&wordLimit) != VLONG_SUCCESS)
+			wordLimit = 0;
+	}
+
+	for (size_t i = 0; i < m_.size(); i++, p += width)
+	{
+		swrd_t w = m_[i];
+		if (w != SPILL && width >= sizeof(swrd_t) && (wordLimit == 0 || (w < wordLimit && w > -wordLimit)))
+		{
+			uwrd_t u = (uwrd_t)w;
+			size_t k;
+			for (k = 0; k < sizeof(swrd_t); k++, u >>= 8)
+				p[k] = (unsigned char)u;
+			for (; k < width; k++)
+				p[k] = w < 0 ? 0xFF : 0;
+			continue;
+		}
+		getValue(i, v);
+		if ((precision > 0 && vlong::CompareMag(v, limit) >= 0) || v.ToTwosComplementLE((char *)p, width) != VLONG_SUCCESS)
+			throw std::logic_error(szOverflowError);
+	}
+}
+
+void DecimalColumn::add(const DecimalColumn &rhs)
+{
+	addSub(rhs, false);
+}
+
+void DecimalColumn::sub(const DecimalColumn &rhs)
+{
+	addSub(rhs, true);
+}
+
+void DecimalColumn::addSub(const DecimalColumn &rhs, bool subtract)
+{
+	size_t i, n = m_.size();
+
+	if (rhs.m_.size() != n)
+		throw std::logic_error(szSizeError);
+
+	if (&rhs == this)
+	{
+		// The loops below read rhs while writing this column
+		DecimalColumn t(rhs);
+		addSub(t, subtract);
+		return;
+	}
+	if (rhs.scale_ > scale_)
+	{
+		// Compute at the finer scale and round back (see BigDecimal::add)
+		int scale = scale_;
+		rescale(rhs.scale_);
+		addSub(rhs, subtract);
+		rescale(scale);
+		return;
+	}
+	if (rhs.scale_ < scale_)
+	{
+		DecimalColumn t(rhs);
+		t.rescale(scale_);
+		addSub(t, subtract);
+		return;
+	}
+	if (n == 0)
+		return;
+
+	swrd_t *a = &m_[0];
+	const swrd_t *b = &rhs.m_[0];
+	uwrd_t overflow = 0;
+	int sentinel = 0;
+
+	// Wrapping arithmetic. The sign bit of 'overflow' collects signed overflows
+	// and 'sentinel' results that collide with the spill marker.
+	if (subtract)
+	{
+		for (i = 0; i < n; i++)
+		{
+			swrd_t r = (swrd_t)((uwrd_t)a[i] - (uwrd_t)b[i]);
+			overflow |= (uwrd_t)((a[i] ^ b[i]) & (a[i] ^ r));
+			sentinel |= (r == SPILL);
+			a[i] = r;
+		}
+	}
+	else
+	{
+		for (i = 0; i < n; i++)
+		{
+			swrd_t r = (swrd_t)((uwrd_t)a[i] + (uwrd_t)b[i]);
+			overflow |= (uwrd_t)((a[i] ^ r) & (b[i] ^ r));
+			sentinel |= (r == SPILL);
+			a[i] = r;
+		}
+	}
+
+	if ((swrd_t)overflow >= 0 && !sentinel && spill_.empty() && rhs.spill_.empty())
+		return;
+
+	// Redo the entries that overflowed or were spilled with vlong.
+	// The left operand is recovered by undoing the wrapping operation.
+	vlong x, y;
+	for (i = 0; i < n; i++)
+	{
+		swrd_t r = a[i], orig;
+		bool over;
+		if (subtract)
+		{
+			orig = (swrd_t)((uwrd_t)r + (uwrd_t)b[i]);
+			over = ((orig ^ b[i]) & (orig ^ r)) < 0;
+		}
+		else
+		{
+			orig = (swrd_t)((uwrd_t)r - (uwrd_t)b[i]);
+			over = ((orig ^ r) & (b[i] ^ r)) < 0;
+		}
+		if (!over && r != SPILL && orig != SPILL && b[i] != SPILL)
+			continue;
+
+		if (orig == SPILL)
+			x = spill_[i];
+		else
+			x.SetWord(orig);
+		rhs.getValue(i, y);
+		if (subtract)
+			x.Sub(x, y);
+		else
+			x.Add(x, y);
+
+		m_[i] = SPILL;
+		setValue(i, x);
+	}
+}
+
+void DecimalColumn::mul(swrd_t factor)
+{
+	size_t i, n = m_.size();
+	swrd_t *a = n > 0 ? &m_[0] : NULL;
+
+	if (factor == 0)
+	{
+		for (i = 0; i < n; i++)
+			a[i] = 0;
+		spill_.clear();
+		return;
+	}
+
+	// Bound the magnitude of the column once, so the multiplication
+	// loop itself needs no overflow checks
+	swrd_t lo = 0, hi = 0;
+	for (i = 0; i < n; i++)
+	{
+		swrd_t v = a[i] == SPILL ? 0 : a[i];
+		lo = v < lo ? v : lo;
+		hi = v > hi ? v : hi;
+	}
+
+	uwrd_t limit = ((uwrd_t)WORD_MAX) / absWord(factor);
+	vlong x, f;
+	f.SetWord(factor);
+
+	std::map<size_t, vlong> spilled;
+	spilled.swap(spill_);
+
+	if (absWord(hi) <= limit && absWord(lo) <= limit)
+	{
+		for (i = 0; i < n; i++)
+			a[i] = (swrd_t)((uwrd_t)a[i] * (uwrd_t)factor);
+	}
+	else
+	{
+		for (i = 0; i < n; i++)
+		{
+			if (a[i] == SPILL)
+				continue;
+			if (absWord(a[i]) <= limit)
+			{
+				a[i] = (swrd_t)((uwrd_t)a[i] * (uwrd_t)factor);
+				continue;
+			}
+			x.SetWord(a[i]);
+			x.Mul(x, f);
+			setValue(i, x);
+		}
+	}
+
+	for (std::map<size_t, vlong>::iterator it = spilled.begin(); it != spilled.end(); ++it)
+	{
+		it->second.Mul(it->second, f);
+		m_[it->first] = SPILL;
+		setValue(it->first, it->second);
+	}
+}
+
+void DecimalColumn::mulSlow(const vlong &factor)
+{
+	vlong x;
+	for (size_t i = 0; i < m_.size(); i++)
+	{
+		getValue(i, x);
+		x.Mul(x, factor);
+		setValue(i, x);
+	}
+}
+
+void DecimalColumn::mul(const BigDecimal &factor)
+{
+	int scale = scale_;
+	swrd_t w;
+
+	if (factor.getUnscaled().GetWord(&w) == VLONG_SUCCESS)
+		mul(w);
+	else
+		mulSlow(factor.getUnscaled());
+
+	scale_ += factor.getScale();
+	rescale(scale);
+}
+
+void DecimalColumn::rescale(int scale)
+{
+	size_t i, n = m_.size();
+	vlong p10;
+	swrd_t p;
+
+	if (scale < 0) scale = 0;
+	if (scale == scale_)
+		return;
+
+	if (scale > scale_)
+	{
+		p10.Pow(10, scale - scale_);
+		if (p10.GetWord(&p) == VLONG_SUCCESS)
+			mul(p);
+		else
+			mulSlow(p10);
+		scale_ = scale;
+		return;
+	}
+
+	p10.Pow(10, scale_ - scale);
+	if (p10.GetWord(&p) != VLONG_SUCCESS)
+	{
+		// Divisor is wider than a word: round every entry with BigDecimal
+		for (i = 0; i < n; i++)
+		{
+			vlong x;
+			getValue(i, x);
+			BigDecimal t(x, scale_);
+			t.setScale(scale);
+			setValue(i, t.getUnscaled());
+		}
+		scale_ = scale;
+		return;
+	}
+
+	// Round half away from zero (as BigDecimal::setScale does)
+	swrd_t *a = n > 0 ? &m_[0] : NULL;
+	for (i = 0; i < n; i++)
+	{
+		swrd_t v = a[i];
+		if (v == SPILL)
+			continue;
+		swrd_t q = v / p, r = v % p;
+		if (r < 0) r = -r;
+		if (r >= p - r)
+			q += v < 0 ? -1 : 1;
+		a[i] = q;
+	}
+
+	std::map<size_t, vlong> spilled;
+	spilled.swap(spill_);
+	for (std::map<size_t, vlong>::iterator it = spilled.begin(); it != spilled.end(); ++it)
+	{
+		BigDecimal t(it->second, scale_);
+		t.setScale(scale);
+		setValue(it->first, t.getUnscaled());
+	}
+	scale_ = scale;
+}
+
+void DecimalColumn::compare(const DecimalColumn &rhs, signed char *out) const
+{
+	size_t i, n = m_.size();
+
+	if (rhs.m_.size() != n)
+		throw std::logic_error(szSizeError);
+
+	// Compare exactly at the finer of two scales
+	if (rhs.scale_ > scale_)
+	{
+		DecimalColumn t(*this);
+		t.rescale(rhs.scale_);
+		t.compare(rhs, out);
+		return;
+	}
+	if (rhs.scale_ < scale_)
+	{
+		DecimalColumn t(rhs);
+		t.rescale(scale_);
+		compare(t, out);
+		return;
+	}
+	if (n == 0)
+		return;
+
+	const swrd_t *a = &m_[0];
+	const swrd_t *b = &rhs.m_[0];
+	for (i = 0; i < n; i++)
+		out[i] = (signed char)((a[i] > b[i]) - (a[i] < b[i]));
+
+	vlong x, y;
+	std::map<size_t, vlong>::const_iterator it;
+	for (it = spill_.begin(); it != spill_.end(); ++it)
+	{
+		rhs.getValue(it->first, y);
+		out[it->first] = (signed char) it->second.Compare(y);
+	}
+	for (it = rhs.spill_.begin(); it != rhs.spill_.end(); ++it)
+	{
+		getValue(it->first, x);
+		out[it->first] = (signed char) x.Compare(it->second);
+	}
+}
+
+void DecimalColumn::compare(const BigDecimal &value, signed char *out) const
+{
+	size_t i, n = m_.size();
+	int k = value.getScale() - scale_;
+	vlong lhsMul, rhs, r;
+	swrd_t q;
+	int tie = 0;
+
+	// Compare x*lhsMul with rhs exactly. For the inline fast path find the
+	// threshold q at the column scale: x > value <=> x > q, and on x == q
+	// the result is 'tie' (the value had digits below the column scale).
+	if (k <= 0)
+	{
+		lhsMul.SetValue(1);
+		rhs.Pow(10, -k);
+		rhs.Mul(rhs, value.getUnscaled());
+		q = 0;
+		if (rhs.GetWord(&q) != VLONG_SUCCESS)
+			q = SPILL;
+	}
+	else
+	{
+		vlong t;
+		lhsMul.Pow(10, k);
+		rhs = value.getUnscaled();
+		t.Div(rhs, lhsMul, &r);
+		if (!r.isZero())
+		{
+			// floor towards minus infinity
+			if (rhs.GetSign() < 0)
+				t.Sub(t, 1);
+			tie = -1;
+		}
+		if (t.GetWord(&q) != VLONG_SUCCESS)
+			q = SPILL;
+	}
+
+	if (q == SPILL)
+	{
+		// The threshold is outside of the word range
+		vlong x;
+		for (i = 0; i < n; i++)
+		{
+			getValue(i, x);
+			x.Mul(x, lhsMul);
+			out[i] = (signed char) x.Compare(rhs);
+		}
+		return;
+	}
+
+	const swrd_t *a = n > 0 ? &m_[0] : NULL;
+	for (i = 0; i < n; i++)
+		out[i] = (signed char)((a[i] > q) - (a[i] < q) + (a[i] == q) * tie);
+
+	vlong x;
+	std::map<size_t, vlong>::const_iterator it;
+	for (it = spill_.begin(); it != spill_.end(); ++it)
+	{
+		x.Mul(it->second, lhsMul);
+		out[it->first] = (signed char) x.Compare(rhs);
+	}
+}
+
+BigDecimal DecimalColumn::sum() const
+{
+	size_t n = m_.size(), start, i;
+	const swrd_t *a = n > 0 ? &m_[0] : NULL;
+	vlong total, hiv, lov;
+
+	// Split every word into a signed high digit and an unsigned low digit and
+	// sum them separately in words. A block is small enough for neither sum
+	// to overflow, so the inner loop has no carries and no branches.
+	const size_t block = ((size_t)1) << (DIGIT_BITS - 2 < 30 ? DIGIT_BITS - 2 : 30);
+	for (start = 0; start < n; start += block)
+	{
+		size_t end = n - start > block ? start + block : n;
+		swrd_t hi = 0, lo = 0;
+		for (i = start; i < end; i++)
+		{
+			hi += a[i] >> DIGIT_BITS;
+			lo += (swrd_t)(udig_t)a[i];
+		}
+		hiv.SetWord(hi);
+		hiv.ShiftLeft(hiv, DIGIT_BITS);
+		lov.SetWord(lo);
+		total.Add(total, hiv);
+		total.Add(total, lov);
+	}
+
+	// Spilled entries were summed as the marker value
+	std::map<size_t, vlong>::const_iterator it;
+	for (it = spill_.begin(); it != spill_.end(); ++it)
+	{
+		hiv.SetWord(SPILL);
+		total.Sub(total, hiv);
+		total.Add(total, it->second);
+	}
+	return BigDecimal(total, scale_);
+}
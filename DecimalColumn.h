@@ -0,0 +1,108 @@
+/* DecimalColumn, a column of fixed-point numbers sharing one scale
+*
+* Stores mantissas as contiguous machine words and spills the ones that overflow to vlong.
+* Implementation is in plain C++ and thus architecture and endian-portable.
+*
+* Anyone can use it freely for any purpose. There is
+* absolutely no guarantee it works or fits a particular purpose (see below).
+*
+* This class has been made by Ruslan Yushchenko (yruslan@gmail.com)
+*
+* This is free and unencumbered software released into the public domain.
+*
+* Anyone is free to copy, modify, publish, use, compile, sell, or
+* distribute this software, either in source code form or as a compiled
+* binary, for any purpose, commercial or non-commercial, and by any
+* means.
+*
+* In jurisdictions that recognize copyright laws, the author or authors
+* of this software dedicate any and all copyright interest in the
+* software to the public domain. We make this dedication for the benefit
+* of the public at large and to the detriment of our heirs and
+* successors. We intend this dedication to be an overt act of
+* relinquishment in perpetuity of all present and future rights to this
+* software under copyright law.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* For more information, please refer to <http://unlicense.org/>
+*/
+#ifndef _DECIMAL_COLUMN_H_INCLUDED_
+#define _DECIMAL_COLUMN_H_INCLUDED_
+
+#include <vector>
+#include <map>
+#include "BigDecimal.h"
+
+// Structure-of-arrays storage for many decimals of the same scale.
+//
+// Every value is kept as a signed double digit word (swrd_t, 64 bits or
+// 128 bits with VLONG_64BIT) in one contiguous array. The column operations
+// are plain loops over that array so that the compiler can vectorize them.
+// Overflow is detected branch-free and only the overflowed entries are moved
+// to a vlong spill area, marked by a sentinel in the word array.
+class DecimalColumn
+{
+public:
+	explicit DecimalColumn(int scale, size_t size = 0);
+
+	size_t size() const { return m_.size(); }
+	int getScale() const { return scale_; }
+	void resize(size_t size);
+
+	// Value access. Values are rounded to the column scale.
+	BigDecimal get(size_t i) const;
+	void set(size_t i, const BigDecimal &v);
+	void push_back(const BigDecimal &v);
+
+	// Number of entries that do not fit a word and live in the spill area
+	size_t spilled() const { return spill_.size(); }
+
+	// Raw mantissas. Spilled entries contain a sentinel value.
+	const swrd_t *data() const { return m_.empty() ? NULL : &m_[0]; }
+
+	// Arrow/Parquet decimal buffers (see BigDecimal::fromFixedWidthBulk).
+	// Loading replaces the contents and rounds the values to the column scale.
+	// Storing writes the values at the column scale.
+	void fromFixedWidth(const char *in, size_t count, size_t width, int scale);
+	void toFixedWidth(char *out, size_t width, int precision) const;
+
+	// Element-wise arithmetic. Columns must be the same size.
+	// The result keeps the scale of this column (as BigDecimal does).
+	void add(const DecimalColumn &rhs);
+	void sub(const DecimalColumn &rhs);
+
+	// Multiply every element by a scalar
+	void mul(swrd_t factor);
+	void mul(const BigDecimal &factor);
+
+	// Change the scale of the column rounding half away from zero
+	void rescale(int scale);
+
+	// out[i] <- compare(this[i], rhs[i]) or compare(this[i], value) in {-1,0,1}
+	// Used as a filter mask.
+	void compare(const DecimalColumn &rhs, signed char *out) const;
+	void compare(const BigDecimal &value, signed char *out) const;
+
+	// Sum of all elements (exact)
+	BigDecimal sum() const;
+
+private:
+	void getValue(size_t i, vlong &v) const;
+	void setValue(size_t i, const vlong &v);
+	void addSub(const DecimalColumn &rhs, bool subtract);
+	void mulWord(swrd_t factor);
+	void mulSlow(const vlong &factor);
+
+	int scale_;
+	std::vector<swrd_t> m_;
+	std::map<size_t, vlong> spill_;
+};
+
+#endif // _DECIMAL_COLUMN_H_INCLUDED_
@@ -27,8 +27,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <vector>
 #include "vlong.h"
+#include "BigDecimal.h"
+#include "BigDecimal10.h"
 #include "vlong_selftest.h"
+#include "vlong_bench.h"
+#include "vlong_kerneltest.h"
 
 //------------------------------------------------------------------------------------------------------
 
@@ -71,21 +76,19 @@ double GetTime()
 
 int vlong_timing()
 {
-    vlong a,b,c,n,e,d,p,q,dp,dq,qp;
+    vlong a,b,c;
+    vlong_rsa_key key;
 
-    const char *szModulus = "BED310CB2BBFE6BBEE0B3168CD47711AEC9CDACFAA560748C76FA5A6A9381782A1D71D866E7A52F01926BBDB6610A6449BA65E9611D55F1CC0C2F72E157F174ACA26B6AE36560B84E7E325970D52A2591FBD2578D454D22E52F8CC52B7E644198FC4FCD3928E2924FBC64F3F5F586E4542A73948F02FA04DCE0FF9DF1141E2C5";
-    n.FromString(szModulus,16);
-    //Public exponent
-    e.FromString("65537",10);
-    //Private exponent
-    d.FromString("04f4aa4cfc77e16024107a5a046ac48f3471e664da419db2d02b201c31ecd8ff758086adc514bc2eac188b6c693c297542ad916b484f484710e27f54dd0e0de6c1c4b58e54064e9483e9957c9a66f5fa8a58fec97758e2778a3dc453093475f8a3dffdd1bb68ede240643a3d5a8fd71eff09bcbb362dd8f8ed9d8688067b5d89",16);
+    // The key of the 1024-bit RSA workloads ("example workload")
+    if (vlong_rsa_keygen(key, 1024) != 0)
+        return -1;
 
     // Div timing (11 s)
     double fTime1 = GetTime();
     int i;
     for (i=0; i<1000000; i++)
     {
-        c.Div(n, d);
+        c.Div(key.n, key.d);
     }
     double fTime2 = GetTime();
     printf("Divide(1e+6 times): %g seconds\n",fTime2-fTime1);
@@ -94,7 +97,7 @@ int vlong_timing()
     fTime1 = GetTime();
     for (i=0; i<1000000; i++)
     {
-        c.Mod(n, d);
+        c.Mod(key.n, key.d);
     }
     //printf("c=%s\n",c.ToString(10));
     fTime2 = GetTime();
@@ -104,18 +107,12 @@ int vlong_timing()
     fTime1 = GetTime();
     for (i=0; i<1000000; i++)
     {
-        c.Mul(n, d);
+        c.Mul(key.n, key.d);
     }
     //printf("c=%s\n",c.ToString(10));
     fTime2 = GetTime();
     printf("Multiply(1e+6 times): %g seconds\n",fTime2-fTime1);
     
-    p.FromString("f9805c758fce4a9502a6090b1d355869e3e8571a747429d3c5ca12347fa3f0b803a002960df03aa264728af0f2baff0ed4d479186069020cfead8210baf20b63");
-    q.FromString("c3cb7489a2862898e2372f7866b43e94090fe5c36e43a7fd30a228662fe967f8e262b12e97c525150ce074f3c19172ff5ac2d782d99e6f824d0f6b3d3032f5b7");
-    dp.FromString("09616a18816fa01e3a1b43fbc6fd5a75a0bbfb8a63167afc1b539d9b9bb0ee3bfce6e731fd142b202fe69e92b08d97495777259665098daa2f69169aca6c8f41");
-    dq.FromString("77fc5ca463e6d746298b2c1a1ac6667b0dbaa2514b6746b150766f4f801907506c5b92bd3ce0e1c2aeab76c052653215eea6ecaf117198603f9d2d58c80ad2ad");
-    qp.FromString("21e7230c187496bc72ea56e6516e45f0ed0ba434ca6a763caa75d6939ffb98cd326fd9be3267565d29f817a8535a39f2fed84de66e2551f0384f8fd3f628345f");
-
 	a.SetValue(99999);
 	printf("Plaintext  = %s\n", a.ToString(10));
 
@@ -124,13 +121,13 @@ int vlong_timing()
     for (i=0; i<100; i++)
     {
         a.SetValue(99999);
-        b.PowMod(a, e, n);
+        b.PowMod(a, key.e, key.n);
         
         //FULL power modular N
-        //c.PowMod(b, d, n);
+        //c.PowMod(b, key.d, key.n);
 
         //CRT (fast) power modular N    
-        c.PowModCRT(b, p, q, dp, dq, qp);
+        c.PowModCRT(b, key.p, key.q, key.dp, key.dq, key.qp);
     }
 	fTime2 = GetTime();
     printf("\n");
@@ -141,13 +138,102 @@ int vlong_timing()
     return 0;
 }
 
-int main ()
+// BigDecimal functions at 50, 100 and 200 digits, together with a multiplication
+// and a division of the same precision for comparison
+int bigdecimal_timing()
+{
+    BigDecimal x("2.7182818284590452353602874713526624977572470936999595749669676277"), y(0);
+    BigDecimal e("0.7071067811865475244008443621048490392848359376884740365883398689");
+    int i, p;
+    double fTime0, fTime1, fTime2;
+
+    for (p=50; p<=200; p*=2)
+    {
+        MathContext mc(p, ROUND_HALF_EVEN);
+        BigDecimal a = x.pow(p/10, mc), b = e.sqrt(mc);
+        double fTime[7];
+
+        fTime[0] = GetTime();
+        for (i=0; i<1000; i++) y = a.mul(b, mc);
+        fTime[1] = GetTime();
+        for (i=0; i<1000; i++) y = a.div(b, mc);
+        fTime[2] = GetTime();
+        for (i=0; i<1000; i++) y = a.sqrt(mc);
+        fTime[3] = GetTime();
+        for (i=0; i<1000; i++) y = b.exp(mc);
+        fTime[4] = GetTime();
+        for (i=0; i<1000; i++) y = a.ln(mc);
+        fTime[5] = GetTime();
+        for (i=0; i<1000; i++) y = a.pow(e, mc);
+        fTime[6] = GetTime();
+
+        printf("BigDecimal %d digits (1e+3 times): mul %g div %g sqrt %g exp %g ln %g pow %g seconds\n", p,
+            fTime[1]-fTime[0], fTime[2]-fTime[1], fTime[3]-fTime[2], fTime[4]-fTime[3], fTime[5]-fTime[4], fTime[6]-fTime[5]);
+    }
+
+
+    // Parsing and formatting a 2000 digit number in binary and in decimal limbs
+    std::string sz(2000, '7');
+    sz[1000] = '.';
+    BigDecimal10 z;
+    fTime0 = GetTime();
+    for (i=0; i<1000; i++)
+    {
+        y.fromString(sz.c_str());
+        sz = y.toString();
+    }
+    fTime1 = GetTime();
+    for (i=0; i<1000; i++)
+    {
+        z.fromString(sz.c_str());
+        sz = z.toString();
+    }
+    fTime2 = GetTime();
+    printf("Parse and format 2000 digits (1e+3 times): BigDecimal %g BigDecimal10 %g seconds\n", fTime1-fTime0, fTime2-fTime1);
+
+    // Moving a column of decimal128 values (precision 38, scale 6) through text and in bulk
+    std::vector<BigDecimal> col(10000, BigDecimal(0)), back(col);
+    std::vector<char> buf(col.size() * 16);
+    for (i=0; i<(int)col.size(); i++)
+    {
+        col[i] = BigDecimal(x.toString().substr(0, 3 + i % 30).c_str()) * BigDecimal((double)(i - 5000), 0);
+        col[i].setScale(6);
+    }
+    fTime0 = GetTime();
+    for (p=0; p<10; p++)
+        for (i=0; i<(int)col.size(); i++)
+            back[i].fromString(col[i].toString().c_str());
+    fTime1 = GetTime();
+    for (p=0; p<10; p++)
+    {
+        BigDecimal::toFixedWidthBulk(&col[0], col.size(), 16, 38, 6, &buf[0]);
+        BigDecimal::fromFixedWidthBulk(&buf[0], col.size(), 16, 6, &back[0]);
+    }
+    fTime2 = GetTime();
+    printf("Decimal128 column of 1e+4 values (10 times): text %g bulk %g seconds\n", fTime1-fTime0, fTime2-fTime1);
+
+    return 0;
+}
+
+int main (int argc, char *argv[])
 {
+    // "example bench [options]" runs the benchmark suite only
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+        return vlong_bench(argc - 2, argv + 2);
+
+    // "example workload [options]" runs the multithreaded application workloads
+    if (argc > 1 && strcmp(argv[1], "workload") == 0)
+        return vlong_workload(argc - 2, argv + 2);
+
+    // "example kernels [rounds [seed]]" runs longer differential tests of the kernels
+    if (argc > 1 && strcmp(argv[1], "kernels") == 0)
+        return vlong_kerneltest(1, argc > 2 ? atoi(argv[2]) : 1000, argc > 3 ? strtoul(argv[3], NULL, 10) : 1) != 0;
 
-	printf("Performing selftest...\n");
+    printf("Performing selftest...\n");
     vlong_selftest(1); // 1 - verbose
-	printf("Performing timing...\n");
+    printf("Performing timing...\n");
     vlong_timing();
+    bigdecimal_timing();
 
     return 0;
 }
@@ -48,6 +48,14 @@
 
 #include "vlong.h"
 
+#ifdef VLONG_PROFILE_TIMERS
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#endif
+
 // Simulate static asserts (produces "negative subscript" error if fails
 // Signed and unsigned digits and words must be the same size
 typedef int static_assert_acceptable_dig_size1 [sizeof(sdig_t)==sizeof(udig_t) ? 1 : -1];
@@ -85,6 +93,9 @@ static const char BiD = (CiD << 3);
 #define MP_NEG  -1
 #define MP_ZPOS  1
 
+// zero may have no digits allocated
+#define MP_ISODD(a)  ((a).nu>0 && ((a).d[0]&1)!=0)
+
 // Mask to select single digit in double digit data type
 static const udig_t MP_MASK_DIG = ~((udig_t)0);
 
@@ -153,6 +164,504 @@ static int _local_prng(void *pPRNG, char *pOutput, size_t nSize)
     return 0;
 }
 
+//*********************************** Profiling ****************************************
+#ifdef VLONG_PROFILE
+
+#if defined(_MSC_VER)
+#define VLONG_THREAD __declspec(thread)
+#else
+#define VLONG_THREAD __thread
+#endif
+
+// Counters of the calling thread
+static VLONG_THREAD vlong_profile prof_data;
+
+#ifdef VLONG_PROFILE_TIMERS
+// Operations of each kind in progress, so that recursive calls are timed once
+static VLONG_THREAD int prof_depth[VLONG_PROF_OPS];
+
+static vlong_prof_t prof_nanos()
+{
+#ifdef WIN32
+    LARGE_INTEGER t, freq;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&freq);
+    return (vlong_prof_t) ((double) t.QuadPart * 1e9 / (double) freq.QuadPart);
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (vlong_prof_t) t.tv_sec * 1000000000 + t.tv_nsec;
+#endif
+}
+#endif
+
+// Counts an operation and (with VLONG_PROFILE_TIMERS) times it
+// until the end of the enclosing scope
+class ProfScope
+{
+public:
+    ProfScope(int op) : op_(op)
+    {
+        prof_data.count[op]++;
+#ifdef VLONG_PROFILE_TIMERS
+        start_ = prof_depth[op]++ == 0 ? prof_nanos() : 0;
+#endif
+    }
+    ~ProfScope()
+    {
+#ifdef VLONG_PROFILE_TIMERS
+        if (--prof_depth[op_] == 0)
+            prof_data.nanos[op_] += prof_nanos() - start_;
+#endif
+    }
+
+private:
+    int op_;
+#ifdef VLONG_PROFILE_TIMERS
+    vlong_prof_t start_;
+#endif
+};
+
+#define PROF_SCOPE(op)  ProfScope prof_scope(op)
+#define PROF_COUNT(op)  (prof_data.count[op]++)
+
+#else
+
+#define PROF_SCOPE(op)
+#define PROF_COUNT(op)
+
+#endif //VLONG_PROFILE
+
+#ifdef VLONG_PROFILE_SIZES
+#define PROF_SIZE(op, n)  (prof_data.sizes[op][vlong::ProfileSizeBucket(n)]++)
+#else
+#define PROF_SIZE(op, n)
+#endif
+
+//********************************* Tracepoints ****************************************
+// USDT probes of provider "vlong". Sizes are in digits, algorithms are VLONG_PROF_*
+// values. A probe is a nop until a tracer attaches to it.
+#ifdef VLONG_USDT
+#include <sys/sdt.h>
+#define TRACE1(name, a)          DTRACE_PROBE1(vlong, name, a)
+#define TRACE2(name, a, b)       DTRACE_PROBE2(vlong, name, a, b)
+#define TRACE3(name, a, b, c)    DTRACE_PROBE3(vlong, name, a, b, c)
+#else
+#define TRACE1(name, a)
+#define TRACE2(name, a, b)
+#define TRACE3(name, a, b, c)
+#endif
+
+static const char *prof_names[VLONG_PROF_OPS] =
+{
+    "mul_baseline", "mul_karatsuba", "sqr_baseline", "sqr_karatsuba",
+    "div_digit", "div_schoolbook", "div_newton",
+    "reduce_barrett", "reduce_dr", "reduce_montgomery",
+    "powmod_barrett", "powmod_dr", "powmod_montgomery",
+    "gcd", "gcd_step", "miller_rabin", "mul_ntt"
+};
+
+static const char *prof_size_names[VLONG_SIZES_OPS] =
+{
+    "mul", "sqr", "div", "mod", "quotient", "powmod", "powmod_exp_bits"
+};
+
+int vlong::ProfileSnapshot(vlong_profile *p)
+{
+    if (p == NULL) return VLONG_ERR_BAD_ARG_1;
+#ifdef VLONG_PROFILE
+    *p = prof_data;
+    return VLONG_SUCCESS;
+#else
+    memset(p, 0, sizeof(vlong_profile));
+    return VLONG_ERR_NOT_IMPLEMENTED;
+#endif
+}
+
+int vlong::ProfileReset()
+{
+#ifdef VLONG_PROFILE
+    memset(&prof_data, 0, sizeof(vlong_profile));
+    return VLONG_SUCCESS;
+#else
+    return VLONG_ERR_NOT_IMPLEMENTED;
+#endif
+}
+
+const char *vlong::ProfileName(int op)
+{
+    if (op < 0 || op >= VLONG_PROF_OPS) return NULL;
+    return prof_names[op];
+}
+
+const char *vlong::ProfileSizesName(int op)
+{
+    if (op < 0 || op >= VLONG_SIZES_OPS) return NULL;
+    return prof_size_names[op];
+}
+
+int vlong::ProfileSizeBucket(size_t n)
+{
+    if (n < 4) return (int) n;
+    int msb = 2;
+    while ((n >> (msb + 1)) != 0) msb++;
+    int bucket = 4*(msb - 1) + (int) ((n >> (msb - 2)) & 3);
+    return bucket < VLONG_SIZE_BUCKETS ? bucket : VLONG_SIZE_BUCKETS - 1;
+}
+
+size_t vlong::ProfileBucketSize(int bucket)
+{
+    if (bucket < 4) return bucket < 0 ? 0 : (size_t) bucket;
+    return (size_t) (4 + bucket % 4) << (bucket/4 - 1);
+}
+
+int vlong::ProfileDumpSizes(const vlong_profile *p, FILE *f)
+{
+    if (p == NULL) return VLONG_ERR_BAD_ARG_1;
+    if (f == NULL) return VLONG_ERR_BAD_ARG_2;
+    for (int op=0; op<VLONG_SIZES_OPS; op++)
+    {
+        for (int k=0; k<VLONG_SIZE_BUCKETS; k++)
+        {
+            if (p->sizes[op][k] == 0) continue;
+            if (k < VLONG_SIZE_BUCKETS - 1)
+                fprintf(f, "%s %u %u %.0f\n", prof_size_names[op], (unsigned) ProfileBucketSize(k),
+                    (unsigned) ProfileBucketSize(k + 1) - 1, (double) p->sizes[op][k]);
+            else
+                fprintf(f, "%s %u - %.0f\n", prof_size_names[op], (unsigned) ProfileBucketSize(k), (double) p->sizes[op][k]);
+        }
+    }
+#ifdef VLONG_PROFILE_SIZES
+    return VLONG_SUCCESS;
+#else
+    return VLONG_ERR_NOT_IMPLEMENTED;
+#endif
+}
+
+//********************************* Digit buffers **************************************
+// With VLONG_POOL digit buffers are rounded up to a power of two and kept for
+// reuse when freed. Each thread caches up to 2*POOL_CACHE buffers per size
+// class; beyond that it hands POOL_CACHE of them as one batch to a slot of the
+// class shared by all threads, and a thread with an empty cache takes a batch
+// from a slot. Slots are only swapped between empty and full, which needs no
+// lock and has no ABA problem. Without a free slot the batch is deleted, so the
+// pool stays within POOL_SLOTS*POOL_CACHE buffers per class plus the caches.
+// Buffers above the largest class go straight to new[]/delete[].
+#ifdef VLONG_POOL
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#define POOL_THREAD __declspec(thread)
+#else
+#include <pthread.h>
+#define POOL_THREAD __thread
+#endif
+
+#define POOL_CLASSES   16
+#define POOL_CACHE     16
+#define POOL_SLOTS     32
+
+// Digits of the smallest class, room for the link of a free buffer
+#define POOL_MIN_DIGITS  (sizeof(void *) > 4*sizeof(udig_t) ? sizeof(void *)/sizeof(udig_t) : 4)
+
+struct PoolBuf
+{
+    PoolBuf *next;
+};
+
+struct PoolCache
+{
+    PoolBuf *head[POOL_CLASSES];
+    int count[POOL_CLASSES];
+    bool registered;
+};
+
+static PoolBuf * volatile pool_slots[POOL_CLASSES][POOL_SLOTS];
+static POOL_THREAD PoolCache pool_cache;
+
+#if defined(_MSC_VER)
+static PoolBuf *pool_cas(PoolBuf * volatile *p, PoolBuf *cmp, PoolBuf *x)
+{
+    return (PoolBuf *) InterlockedCompareExchangePointer((PVOID volatile *) p, x, cmp);
+}
+static PoolBuf *pool_take(PoolBuf * volatile *p)
+{
+    return (PoolBuf *) InterlockedExchangePointer((PVOID volatile *) p, NULL);
+}
+static PoolBuf *pool_peek(PoolBuf * volatile *p)
+{
+    return *p;
+}
+#else
+static PoolBuf *pool_cas(PoolBuf * volatile *p, PoolBuf *cmp, PoolBuf *x)
+{
+    return __sync_val_compare_and_swap(p, cmp, x);
+}
+static PoolBuf *pool_take(PoolBuf * volatile *p)
+{
+    return __sync_lock_test_and_set(p, (PoolBuf *) NULL);
+}
+static PoolBuf *pool_peek(PoolBuf * volatile *p)
+{
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+#endif
+
+static void pool_delete(PoolBuf *b)
+{
+    PoolBuf *next;
+    for (; b != NULL; b = next)
+    {
+        next = b->next;
+        delete [] (udig_t *) b;
+    }
+}
+
+// Empty the cache of a thread (e.g. when it exits)
+static void pool_release(PoolCache *pc)
+{
+    for (int c=0; c<POOL_CLASSES; c++)
+    {
+        pool_delete(pc->head[c]);
+        pc->head[c] = NULL;
+        pc->count[c] = 0;
+    }
+}
+
+#if !defined(_MSC_VER)
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void pool_thread_exit(void *p)
+{
+    pool_release((PoolCache *) p);
+}
+
+static void pool_key_init()
+{
+    pthread_key_create(&pool_key, pool_thread_exit);
+}
+#endif
+
+// Cache of the calling thread, emptied when the thread exits (with pthreads;
+// on Windows the cache of an exiting thread is not freed)
+static PoolCache *pool_thread_cache()
+{
+    PoolCache *pc = &pool_cache;
+#if !defined(_MSC_VER)
+    if (!pc->registered)
+    {
+        pthread_once(&pool_once, pool_key_init);
+        pthread_setspecific(pool_key, pc);
+        pc->registered = true;
+    }
+#endif
+    return pc;
+}
+
+// Size class of n digits, -1 if there is none
+static int pool_class(size_t n)
+{
+    size_t size = POOL_MIN_DIGITS;
+    for (int c=0; c<POOL_CLASSES; c++, size<<=1)
+        if (n <= size) return c;
+    return -1;
+}
+
+static udig_t *pool_alloc(size_t *n)
+{
+    int c = pool_class(*n);
+    if (c < 0)
+        return new udig_t[*n];
+    *n = POOL_MIN_DIGITS << c;
+
+    PoolCache *pc = pool_thread_cache();
+    if (pc->head[c] == NULL)
+    {
+        for (int i=0; i<POOL_SLOTS && pc->head[c] == NULL; i++)
+            if (pool_peek(&pool_slots[c][i]) != NULL)
+                pc->head[c] = pool_take(&pool_slots[c][i]);
+        if (pc->head[c] == NULL)
+            return new udig_t[*n];
+        pc->count[c] = POOL_CACHE;
+    }
+
+    PoolBuf *b = pc->head[c];
+    pc->head[c] = b->next;
+    pc->count[c]--;
+    return (udig_t *) b;
+}
+
+static void pool_free(udig_t *d, size_t n)
+{
+    int c = pool_class(n);
+    if (c < 0 || n != POOL_MIN_DIGITS << c)
+    {
+        delete [] d;
+        return;
+    }
+
+    PoolCache *pc = pool_thread_cache();
+    if (pc->count[c] >= 2*POOL_CACHE)
+    {
+        // the first POOL_CACHE buffers go to a free slot as one batch
+        PoolBuf *batch = pc->head[c], *last = batch;
+        for (int i=1; i<POOL_CACHE; i++)
+            last = last->next;
+        pc->head[c] = last->next;
+        pc->count[c] -= POOL_CACHE;
+        last->next = NULL;
+
+        int i;
+        for (i=0; i<POOL_SLOTS; i++)
+            if (pool_peek(&pool_slots[c][i]) == NULL && pool_cas(&pool_slots[c][i], NULL, batch) == NULL)
+                break;
+        if (i == POOL_SLOTS)
+            pool_delete(batch);
+    }
+
+    PoolBuf *b = (PoolBuf *) d;
+    b->next = pc->head[c];
+    pc->head[c] = b;
+    pc->count[c]++;
+}
+
+#else
+
+static udig_t *pool_alloc(size_t *n)
+{
+    return new udig_t[*n];
+}
+
+static void pool_free(udig_t *d, size_t)
+{
+    delete [] d;
+}
+
+#endif //VLONG_POOL
+
+//****************************** Mapped digit buffers **********************************
+// Buffers of VLONG_MAP_DIGITS and more are mapped in multiples of 2 MB: anonymous
+// pages with a transparent huge page hint, or after SetMapDir() the pages of a
+// temporary file that is unlinked at once, so the kernel writes them back to the
+// file instead of swap. The space of the file is allocated in advance, so a full
+// disk fails the allocation instead of a later write (but for macOS, which only
+// extends the file). Mapped pages start zeroed.
+#if !defined(WIN32) && !defined(_WIN32)
+#define VLONG_MAPPED
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define MAP_GRANULE  ((size_t) 2 << 20)
+
+#ifdef VLONG_POOL
+// pool_alloc() rounds sizes up within the classes, which must stay unmapped
+typedef int static_assert_map_above_pool [(POOL_MIN_DIGITS << (POOL_CLASSES-1)) < VLONG_MAP_DIGITS ? 1 : -1];
+#endif
+
+static char map_dir[1024];
+
+static udig_t *map_alloc(size_t *n)
+{
+    size_t bytes = (*n*sizeof(udig_t) + MAP_GRANULE - 1) & ~(MAP_GRANULE - 1);
+    void *p = MAP_FAILED;
+
+    if (map_dir[0] != '\0')
+    {
+        char path[sizeof(map_dir) + 16];
+        sprintf(path, "%s/vlongXXXXXX", map_dir);
+        int fd = mkstemp(path);
+        if (fd < 0) return NULL;
+        unlink(path);
+#ifdef __APPLE__
+        if (ftruncate(fd, (off_t) bytes) == 0)
+#else
+        if (posix_fallocate(fd, 0, (off_t) bytes) == 0)
+#endif
+            p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    else
+    {
+        p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+        if (p != MAP_FAILED) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    }
+    if (p == MAP_FAILED) return NULL;
+    *n = bytes / sizeof(udig_t);
+    return (udig_t *) p;
+}
+
+static void map_free(udig_t *d, size_t n)
+{
+    munmap(d, n*sizeof(udig_t));
+}
+
+#endif //VLONG_MAPPED
+
+// Whether buffers of n digits are mapped
+static bool digits_mapped(size_t n)
+{
+#ifdef VLONG_MAPPED
+    return n >= VLONG_MAP_DIGITS;
+#else
+    return false;
+#endif
+}
+
+static udig_t *digits_alloc(size_t *n)
+{
+#ifdef VLONG_MAPPED
+    if (digits_mapped(*n)) return map_alloc(n);
+#endif
+    return pool_alloc(n);
+}
+
+static void digits_free(udig_t *d, size_t n)
+{
+#ifdef VLONG_MAPPED
+    if (digits_mapped(n))
+    {
+        map_free(d, n);
+        return;
+    }
+#endif
+    pool_free(d, n);
+}
+
+int vlong::SetMapDir(const char *szDir)
+{
+#ifdef VLONG_MAPPED
+    if (szDir == NULL)
+    {
+        map_dir[0] = '\0';
+        return VLONG_SUCCESS;
+    }
+    if (strlen(szDir) >= sizeof(map_dir) || access(szDir, W_OK) != 0)
+        return VLONG_ERR_BAD_ARG_1;
+    strcpy(map_dir, szDir);
+    return VLONG_SUCCESS;
+#else
+    return VLONG_ERR_NOT_IMPLEMENTED;
+#endif
+}
+
+int vlong::PoolTrim()
+{
+#ifdef VLONG_POOL
+    for (int c=0; c<POOL_CLASSES; c++)
+        for (int i=0; i<POOL_SLOTS; i++)
+            pool_delete(pool_take(&pool_slots[c][i]));
+    pool_release(&pool_cache);
+    return VLONG_SUCCESS;
+#else
+    return VLONG_ERR_NOT_IMPLEMENTED;
+#endif
+}
+
 // Init vlong number. (For internal use only)
 void vlong::Init()
 {
@@ -186,7 +695,8 @@ int vlong::prvMovePtr(vlong &v)
 {
     try
     {
-        delete [] d;
+        if (d!=NULL)
+            digits_free(d, na);
     }
     catch (...)
     {
@@ -209,7 +719,7 @@ int vlong::Clear()
     try
     {
         if (d!=NULL)
-            delete [] d;
+            digits_free(d, na);
         if (tmp!=NULL)
             delete [] tmp;
     }
@@ -224,9 +734,9 @@ int vlong::Clear()
 // Grow a number to a specified number of digits [BNM pp.25 Algorithm 2.6]
 int vlong::Grow(size_t n)
 {
-    //TODO: Optimization: grow to a nearest larger multiple of 2
-    //                    shrink if n < 1/4 of that power
-	//                    (unimplemented)
+    //TODO: Optimization: shrink if n < 1/4 of the allocated size
+	//                    (unimplemented, with VLONG_POOL the size is
+	//                    rounded up to a power of 2)
 
     if (na>=n)
     {
@@ -238,14 +748,15 @@ int vlong::Grow(size_t n)
 #endif
 
     //At this point guaranteed to be 0<n<VLONG_MAX_DIGITS
+    TRACE2(grow, na, n);
     try
     {
-        udig_t *d_new = new udig_t[n];
+        udig_t *d_new = digits_alloc(&n);
         if (d_new == NULL) return VLONG_ERR_MEMORY_ALLOC;
-        memset(d_new, 0, n*sizeof(udig_t));
+        if (!digits_mapped(n)) memset(d_new, 0, n*sizeof(udig_t));
         if (nu>0) memcpy(d_new, d, nu*sizeof(udig_t));
+        if (d!=NULL) digits_free(d, na);
         na = n;
-        if (d!=NULL) delete [] d;
         d = d_new;
     }
     catch (...)
@@ -259,10 +770,10 @@ int vlong::Grow(size_t n)
 // Remove trailing zeros if any [BNM pp.31 Algorithm 2.9]
 int vlong::Clamp()
 {
-    int i;
+    size_t i;
     if (nu>0)
     {
-        for (i=nu-1; i>=0; i--)
+        for (i=nu; i-- > 0; )
         {
             if (d[i]==0)
                 nu--;
@@ -322,6 +833,40 @@ int vlong::SetValue(sdig_t v)
     return ret;
 }
 
+// Set value to a signed double digit (word) integer
+int vlong::SetWord(swrd_t v)
+{
+    int ret = VLONG_SUCCESS;
+    uwrd_t u = v<0 ? ((uwrd_t)0) - (uwrd_t)v : (uwrd_t)v;
+
+    CHECK( Grow(2) );
+    if (nu>2) memset(d+2, 0, (nu-2)*sizeof(udig_t));
+
+    d[0] = (udig_t)(u & MP_MASK_DIG);
+    d[1] = (udig_t)(u >> BiD);
+    nu = 2;
+    s = v<0 ? MP_NEG : MP_ZPOS;
+
+    return Clamp();
+}
+
+// Get value as a signed double digit (word) integer
+int vlong::GetWord(swrd_t *v) const
+{
+    uwrd_t u = 0;
+    const uwrd_t top = ((uwrd_t)1) << (2*BiD-1);
+
+    if (nu>2) return VLONG_ERR_OUT_OF_RANGE;
+    if (nu>0) u  = (uwrd_t) d[0];
+    if (nu>1) u |= ((uwrd_t) d[1]) << BiD;
+
+    // |v| <= 2**(2*BiD-1)-1 for positive and |v| <= 2**(2*BiD-1) for negative numbers
+    if (u>top || (u==top && s==MP_ZPOS)) return VLONG_ERR_OUT_OF_RANGE;
+
+    if (v!=NULL) *v = (s == MP_NEG) ? (swrd_t)(((uwrd_t)0) - u) : (swrd_t)u;
+    return VLONG_SUCCESS;
+}
+
 // Swap contents of two vlong objects
 // Faster then copying because it doesn't require
 // memory copy operation. Just swaps pointers
@@ -341,6 +886,48 @@ void vlong::swap(vlong &v)
     x  = ntmp;     ntmp= v.ntmp;  v.ntmp= x;
 }
 
+// Radix conversion by splitting at the powers pw[k] = B^(2^k) of the largest
+// power B = radix^m that Div() takes as a single digit
+struct vlong_radix
+{
+    size_t rd;
+    const char *pAlphabet;
+    size_t m;
+    sdig_t B;
+    int npw;
+    vlong *pw;
+
+    vlong_radix() : npw(0), pw(NULL) {}
+    ~vlong_radix() { delete [] pw; }
+};
+
+static bool radix_init(vlong_radix &rc, size_t rd, const char *pAlphabet)
+{
+    udig_t B = 1, lim = MP_MASK_DIG >> 1;
+
+    rc.rd = rd;
+    rc.pAlphabet = pAlphabet;
+    for (rc.m = 0; B <= lim / rd; rc.m++)
+        B *= (udig_t) rd;
+    rc.B = (sdig_t) B;
+    rc.npw = 0;
+    return rc.m > 0;
+}
+
+// Adds the next power of the table
+static int radix_power(vlong_radix &rc)
+{
+    if (rc.pw == NULL)
+        rc.pw = new vlong[64];
+    if (rc.npw == 0)
+    {
+        rc.npw++;
+        return rc.pw[0].SetValue(rc.B);
+    }
+    rc.npw++;
+    return rc.pw[rc.npw-1].Sqr(rc.pw[rc.npw-2]);
+}
+
 // Convert from a NUUL-terminated string of 2<=radix<=16
 int vlong::FromString(const char *szNumber, int radix/* = 16*/)
 {
@@ -353,7 +940,7 @@ int vlong::FromString(const char *szNumber, int radix/* = 16*/)
 // from a custom numeric system (2<=radix<=256)
 int vlong::FromStringBuf(const char *pBuf, size_t nBufLen /*=0*/, int nRadix /*= 16*/, const char *szCustomChars /*= NULL*/)
 {
-    int i,j;
+    size_t i, j;
     size_t len, cd, cp, nNeeds;
     sdig_t dig;
     char c;
@@ -396,7 +983,7 @@ int vlong::FromStringBuf(const char *pBuf, size_t nBufLen /*=0*/, int nRadix /*=
 
     if (rd == 16)
     {
-        for(i=len-1,j=0; i>=0; i--,j++)
+        for(i=len,j=0; i-- > 0; j++)
         {
             cd = (j / (2*CiD));
             cp = (j % (2*CiD));
@@ -429,38 +1016,75 @@ int vlong::FromStringBuf(const char *pBuf, size_t nBufLen /*=0*/, int nRadix /*=
     }
     else
     {
-		int sign = MP_ZPOS;
-        for(i=0; i<(int)len; i++)
-        {
-            c = pBuf[i];
-            if (i==0 && c=='-')
-            {
-				sign = MP_NEG;
-                continue;
-            }
-            if (pAlphabet==MP_DIG_CHARS && rd<=16)
-            {
-                dig=-1;
-                if (c>=48 && c<=57) dig = c - 48;
-                if (c>=65 && c<=70) dig = c - 55;
-                if (c>=97 && c<=102) dig = c - 87;
-                if (dig<0 || ((size_t)dig)>=rd) return VLONG_ERR_INVALID_CHAR;
-            }
-            else
-            {
-                pos = strchr(pAlphabet,c);
-                if (pos==NULL) return VLONG_ERR_INVALID_CHAR;
-                dig = (sdig_t) (pos-pAlphabet);
-            }
+        int sign = MP_ZPOS;
+        vlong_radix rc;
 
-            Mul(*this, rd);
-            Add(*this, dig);
+        if (len>0 && pBuf[0]=='-')
+        {
+            sign = MP_NEG;
+            pBuf++;
+            len--;
         }
-		s = sign;
+        if (nNeeds >= 2*VLONG_PARALLEL_RADIX_CUTOFF && radix_init(rc, rd, pAlphabet))
+        {
+            // powers up to the split of len characters
+            while (rc.npw < 64 && (rc.m << rc.npw) < len)
+                CHECK( radix_power(rc) );
+            CHECK( prvFromCharsDC(pBuf, len, rc) );
+        }
+        else
+            CHECK( prvFromChars(pBuf, len, rd, pAlphabet) );
+        s = nu>0 ? sign : MP_ZPOS;
     }
     return VLONG_SUCCESS;
 }
 
+// Non-negative number from the len characters at p, accumulating as many
+// characters as fit into a single digit and applying them with one
+// multiply-add pass per chunk
+int vlong::prvFromChars(const char *p, size_t len, size_t rd, const char *pAlphabet)
+{
+    size_t i;
+    sdig_t dig;
+    char c;
+    const char *pos;
+    udig_t chunk = 0, chunkMul = 1;
+    udig_t chunkMax = MP_MASK_DIG / (udig_t) rd;
+    int ret = VLONG_SUCCESS;
+
+    SetZero();
+    for(i=0; i<len; i++)
+    {
+        c = p[i];
+        if (pAlphabet==MP_DIG_CHARS && rd<=16)
+        {
+            dig=-1;
+            if (c>=48 && c<=57) dig = c - 48;
+            if (c>=65 && c<=70) dig = c - 55;
+            if (c>=97 && c<=102) dig = c - 87;
+            if (dig<0 || ((size_t)dig)>=rd) return VLONG_ERR_INVALID_CHAR;
+        }
+        else
+        {
+            pos = strchr(pAlphabet,c);
+            if (pos==NULL) return VLONG_ERR_INVALID_CHAR;
+            dig = (sdig_t) (pos-pAlphabet);
+        }
+
+        chunk = chunk*((udig_t) rd) + (udig_t) dig;
+        chunkMul *= (udig_t) rd;
+        if (chunkMul > chunkMax)
+        {
+            CHECK( prvMulAddDig(*this, chunkMul, chunk) );
+            chunk = 0;
+            chunkMul = 1;
+        }
+    }
+    if (chunkMul > 1)
+        CHECK( prvMulAddDig(*this, chunkMul, chunk) );
+    return ret;
+}
+
 // Convert from unsigned big-endian binary number
 int vlong::FromBinary(const char *szNumber, size_t buflen)
 {
@@ -468,6 +1092,42 @@ int vlong::FromBinary(const char *szNumber, size_t buflen)
     return SetBytes(0, buflen, szNumber);
 }
 
+int vlong::FromTwosComplementLE(const char *buf, size_t buflen)
+{
+    const unsigned char *p = (const unsigned char *) buf;
+    size_t i, j, n = CHARS_TO_DIGITS(buflen);
+    udig_t v, carry;
+    int ret = VLONG_SUCCESS;
+
+    SetZero();
+    if (buflen==0) return ret;
+    CHECK( Grow(n+1) );
+
+    // Bytes above the buffer repeat the sign
+    unsigned char ext = (p[buflen-1] & 0x80) ? 0xFF : 0;
+    for (i=0; i<n; i++)
+    {
+        v = 0;
+        for (j=CiD; j-- > 0; )
+            v = (udig_t) ((v << 8) | (i*CiD+j < buflen ? p[i*CiD+j] : ext));
+        d[i] = v;
+    }
+    nu = n;
+
+    // The magnitude of a negative number is ~x + 1
+    if (ext)
+    {
+        carry = 1;
+        for (i=0; i<n; i++)
+        {
+            d[i] = (udig_t) (~d[i] + carry);
+            carry = carry && d[i]==0;
+        }
+        s = MP_NEG;
+    }
+    return Clamp();
+}
+
 // Convert to temporary readable string (useful in printf) 2<=radix<=16
 const char *vlong::ToString(int radix /*= 16*/) const
 {
@@ -684,6 +1344,7 @@ int vlong::ToStringBuf(char *pBuf, size_t &nBufLen, int nRadix /*= 16*/, const c
     size_t i, j, k=0, b;
     size_t nNeeds = 0;
     const char *pAlphabet;
+    vlong_radix rc;
     int ret = VLONG_SUCCESS;
 
     size_t rd = nRadix;
@@ -739,6 +1400,35 @@ int vlong::ToStringBuf(char *pBuf, size_t &nBufLen, int nRadix /*= 16*/, const c
         }
         *(pBuf++) = '\0';
     }
+    else if (nu >= VLONG_RADIX_DC_CUTOFF && radix_init(rc, rd, pAlphabet))
+    {
+        vlong v(*this);
+        v.s = MP_ZPOS;
+
+        // pw[k] <= v < pw[k+1], so v has at most 2*m*2^k characters
+        CHECK( radix_power(rc) );
+        while (rc.npw < 64 && 2*rc.pw[rc.npw-1].nu - 1 <= v.nu)
+        {
+            CHECK( radix_power(rc) );
+            if (CompareMag(rc.pw[rc.npw-1], v) == MP_GT)
+            {
+                rc.npw--;
+                break;
+            }
+        }
+        k = rc.m << rc.npw;
+        char *pt = new char[k];
+        ret = v.prvToCharsDC(pt, rc.npw, rc);
+        if (ret == VLONG_SUCCESS)
+        {
+            for (i=0; i<k-1 && pt[i]==pAlphabet[0]; i++)
+                ;
+            memcpy(pBuf, pt+i, k-i);
+            pBuf[k-i] = '\0';
+            nBufLen = k-i+1;
+        }
+        delete [] pt;
+    }
     else
     {
         vlong v(*this);
@@ -772,6 +1462,105 @@ int vlong::ToStringBuf(char *pBuf, size_t &nBufLen, int nRadix /*= 16*/, const c
     return ret;
 }
 
+// The two halves of a split radix conversion, on separate threads
+struct RadixHalves
+{
+    const vlong_radix *rc;
+    vlong *x[2];
+    const char *in[2];
+    char *out[2];
+    size_t len[2];
+    int k;
+    int ret[2];
+};
+
+void vlong::prvRadixHalves(void *ctx, size_t i, size_t, size_t)
+{
+    RadixHalves *t = (RadixHalves *) ctx;
+    if (t->out[i] != NULL)
+        t->ret[i] = t->x[i]->prvToCharsDC(t->out[i], t->k, *t->rc);
+    else
+        t->ret[i] = t->x[i]->prvFromCharsDC(t->in[i], t->len[i], *t->rc);
+}
+
+// Number from len characters: hi * pw[k] + lo for the m*2^k characters of lo,
+// with hi and lo on separate threads [Brent, Zimmermann. Modern Computer
+// Arithmetic, 2010, pp.43 1.7]
+int vlong::prvFromCharsDC(const char *p, size_t len, const vlong_radix &rc)
+{
+    int k;
+    vlong hi, lo;
+    RadixHalves t;
+    int ret = VLONG_SUCCESS;
+
+    for (k = 0; k+1 < rc.npw && (rc.m << (k+1)) < len; k++)
+        ;
+    if ((rc.m << k) >= len || rc.pw[k].nu < VLONG_PARALLEL_RADIX_CUTOFF)
+        return prvFromChars(p, len, rc.rd, rc.pAlphabet);
+
+    t.rc = &rc;
+    t.x[0] = &hi;
+    t.x[1] = &lo;
+    t.in[0] = p;
+    t.in[1] = p + len - (rc.m << k);
+    t.out[0] = t.out[1] = NULL;
+    t.len[0] = len - (rc.m << k);
+    t.len[1] = rc.m << k;
+    t.k = k;
+    prvParallelFor(2, 2, prvRadixHalves, &t);
+    CHECK( t.ret[0] );
+    CHECK( t.ret[1] );
+
+    CHECK( Mul(hi, rc.pw[k]) );
+    return Add(*this, lo);
+}
+
+// The m*2^k characters of a number < pw[k], zero padded: q and r of the
+// division by pw[k-1], or m characters per division by B for small numbers
+int vlong::prvToCharsDC(char *p, int k, const vlong_radix &rc) const
+{
+    size_t j;
+    vlong q, r;
+    RadixHalves t;
+    int ret = VLONG_SUCCESS;
+
+    if (k == 0 || nu < VLONG_RADIX_DC_CUTOFF)
+    {
+        char *pt = p + (rc.m << k);
+        sdig_t dr;
+        CHECK( q.Copy(*this) );
+        while (pt > p)
+        {
+            dr = 0;
+            if (q.nu > 0) CHECK( q.Div(q, rc.B, &dr) );
+            for (j=0; j<rc.m; j++)
+            {
+                *(--pt) = rc.pAlphabet[dr % (sdig_t) rc.rd];
+                dr /= (sdig_t) rc.rd;
+            }
+        }
+        return ret;
+    }
+
+    CHECK( q.Div(*this, rc.pw[k-1], &r) );
+
+    t.rc = &rc;
+    t.x[0] = &q;
+    t.x[1] = &r;
+    t.out[0] = p;
+    t.out[1] = p + (rc.m << (k-1));
+    t.k = k-1;
+    if (rc.pw[k-1].nu >= VLONG_PARALLEL_RADIX_CUTOFF)
+        prvParallelFor(2, 2, prvRadixHalves, &t);
+    else
+    {
+        prvRadixHalves(&t, 0, 0, 1);
+        prvRadixHalves(&t, 1, 1, 2);
+    }
+    CHECK( t.ret[0] );
+    return t.ret[1];
+}
+
 // Convert unsigned part of the vlong number to big-endian binary buffer
 int vlong::ToBinary(char *buf, size_t buflen) const
 {
@@ -781,6 +1570,223 @@ int vlong::ToBinary(char *buf, size_t buflen) const
     return GetBytes(0, buflen, buf);
 }
 
+int vlong::ToTwosComplementLE(char *buf, size_t buflen) const
+{
+    unsigned char *p = (unsigned char *) buf;
+    size_t i, k, nb = GetNumBits();
+    unsigned char b, carry = 1;
+
+    // The range is [-2^(8*buflen-1), 2^(8*buflen-1))
+    if (nb >= buflen*8 && !(nb == buflen*8 && s == MP_NEG && GetNumLSB() == nb-1))
+        return VLONG_ERR_BUFFER_SMALL;
+
+    for (k=0; k<buflen; k++)
+    {
+        i = k/CiD;
+        b = i<nu ? (unsigned char) (d[i] >> (k%CiD)*8) : 0;
+        if (s == MP_NEG)
+        {
+            b = (unsigned char) (~b + carry);
+            carry = carry && b==0;
+        }
+        p[k] = b;
+    }
+    return VLONG_SUCCESS;
+}
+
+//************************** Parallel linear passes ************************************
+// Additions, subtractions, shifts and comparisons of VLONG_PARALLEL_LINEAR_CUTOFF
+// digits and more run in chunks on separate threads. A chunk of an addition
+// (subtraction) assumes no incoming carry (borrow) and records the one it
+// produces and whether an incoming one would pass through it; the carries
+// into the chunks then follow in one step over the chunks, and the chunks that
+// get one add (subtract) it in a second parallel pass, which ends at the first
+// digit that absorbs it.
+
+#define LINEAR_CHUNKS   64      // most chunks of prvParallelChunks()
+
+struct LinearPass
+{
+    udig_t *c;
+    const udig_t *a, *b;        // a has na digits, b the first nb of them (nb <= na)
+    size_t na, nb;
+    bool sub;
+    udig_t carry[LINEAR_CHUNKS];
+    bool through[LINEAR_CHUNKS], in[LINEAR_CHUNKS];
+};
+
+static void linear_addsub(void *ctx, size_t i, size_t lo, size_t hi)
+{
+    LinearPass *p = (LinearPass *) ctx;
+    udig_t u = 0;
+    bool through = true;
+    size_t k;
+    if (p->sub)
+    {
+        for (k=lo; k<hi; k++)
+        {
+            swrd_t dif = ((swrd_t) p->a[k]) - (k < p->nb ? (swrd_t) p->b[k] : 0) - (swrd_t) u;
+            u = dif<0 ? 1 : 0;
+            p->c[k] = (udig_t) (dif & MP_MASK_DIG);
+            through = through && p->c[k] == 0;
+        }
+    }
+    else
+    {
+        for (k=lo; k<hi; k++)
+        {
+            uwrd_t sum = ((uwrd_t) p->a[k]) + (k < p->nb ? (uwrd_t) p->b[k] : 0) + (uwrd_t) u;
+            p->c[k] = (udig_t) (sum & MP_MASK_DIG);
+            u = (udig_t) (sum >> BiD);
+            through = through && p->c[k] == MP_MASK_DIG;
+        }
+    }
+    p->carry[i] = u;
+    p->through[i] = through;
+}
+
+static void linear_fixup(void *ctx, size_t i, size_t lo, size_t hi)
+{
+    LinearPass *p = (LinearPass *) ctx;
+    size_t k;
+    if (!p->in[i])
+        return;
+    for (k=lo; k<hi; k++)
+    {
+        if (p->sub ? p->c[k]-- != 0 : ++p->c[k] != 0)
+            break;
+    }
+}
+
+udig_t vlong::prvAddSubParallel(udig_t *c, const udig_t *a, size_t na, const udig_t *b, size_t nb, bool sub, size_t chunks)
+{
+    LinearPass p;
+    p.c = c;
+    p.a = a;
+    p.b = b;
+    p.na = na;
+    p.nb = nb;
+    p.sub = sub;
+    prvParallelFor(na, chunks, linear_addsub, &p);
+
+    udig_t u = 0;
+    bool fix = false;
+    for (size_t i=0; i<chunks; i++)
+    {
+        p.in[i] = u != 0;
+        fix = fix || p.in[i];
+        u = p.carry[i] | (p.through[i] && u != 0 ? 1 : 0);
+    }
+    if (fix)
+        prvParallelFor(na, chunks, linear_fixup, &p);
+    return u;
+}
+
+struct LinearShift
+{
+    udig_t *c;
+    const udig_t *a;
+    size_t na, digs;
+    int bits;                   // below a digit
+    bool left;
+};
+
+struct LinearCompare
+{
+    const udig_t *a, *b;
+    int cmp[LINEAR_CHUNKS];
+};
+
+// c[digs+k] <- a[k] << bits | a[k-1] >> (BiD-bits) for k <= na, or
+// c[k] <- a[digs+k] >> bits | a[digs+k+1] << (BiD-bits) for k < na-digs
+static void linear_shift(void *ctx, size_t, size_t lo, size_t hi)
+{
+    LinearShift *p = (LinearShift *) ctx;
+    size_t k;
+    int b = p->bits;
+    if (p->left)
+    {
+        for (k=lo; k<hi; k++)
+        {
+            udig_t v = k < p->na ? (udig_t) (p->a[k] << b) : 0;
+            if (b > 0 && k > 0) v |= p->a[k-1] >> (BiD - b);
+            p->c[p->digs + k] = v;
+        }
+    }
+    else
+    {
+        for (k=lo; k<hi; k++)
+        {
+            udig_t v = p->a[p->digs + k] >> b;
+            if (b > 0 && p->digs + k + 1 < p->na) v |= (udig_t) (p->a[p->digs + k + 1] << (BiD - b));
+            p->c[k] = v;
+        }
+    }
+}
+
+// The highest differing digit of a chunk decides it, the highest decided chunk the comparison
+static void linear_compare(void *ctx, size_t i, size_t lo, size_t hi)
+{
+    LinearCompare *p = (LinearCompare *) ctx;
+    p->cmp[i] = MP_EQ;
+    for (size_t k=hi; k-- > lo; )
+    {
+        if (p->a[k] != p->b[k])
+        {
+            p->cmp[i] = p->a[k] > p->b[k] ? MP_GT : MP_LT;
+            break;
+        }
+    }
+}
+
+int vlong::prvShiftParallel(const vlong &a, int bits, size_t chunks)
+{
+    int ret = VLONG_SUCCESS;
+    vlong tmp1, *c = &a == this ? &tmp1 : this;
+    LinearShift p;
+    size_t n;
+
+    p.a = a.d;
+    p.na = a.nu;
+    p.left = bits > 0;
+    if (bits < 0) bits = -bits;
+    p.digs = bits / BiD;
+    p.bits = bits % BiD;
+
+    if (p.left)
+    {
+        n = a.nu + 1;
+        if (c->na < p.digs + n) CHECK( c->Grow(p.digs + n) );
+        memset(c->d, 0, p.digs*sizeof(udig_t));
+    }
+    else
+    {
+        if (a.nu <= p.digs) { SetZero(); return ret; }
+        n = a.nu - p.digs;
+        if (c->na < n) CHECK( c->Grow(n) );
+    }
+    p.c = c->d;
+    prvParallelFor(n, chunks, linear_shift, &p);
+
+    c->nu = p.left ? p.digs + n : n;
+    c->s = a.s;
+    if (&a == this) prvMovePtr(tmp1);
+    CHECK( Clamp() );
+    return ret;
+}
+
+int vlong::prvCompareParallel(const udig_t *a, const udig_t *b, size_t n, size_t chunks)
+{
+    LinearCompare p;
+    p.a = a;
+    p.b = b;
+    prvParallelFor(n, chunks, linear_compare, &p);
+    for (size_t i=chunks; i-- > 0; )
+        if (p.cmp[i] != MP_EQ)
+            return p.cmp[i];
+    return MP_EQ;
+}
+
 //******************************* Comparisons ******************************************
 
 int vlong::Compare(sdig_t x) const
@@ -789,14 +1795,14 @@ int vlong::Compare(sdig_t x) const
     if (isZero())
     {
         if (x==0) return MP_EQ;
-        return x>0 ? MP_GT : MP_LT;
+        return x>0 ? MP_LT : MP_GT;
     }
 
     /* compare based on sign */
     if (s == MP_NEG && x>=0)
         return MP_LT;
     if (s == MP_ZPOS && x<=0)
-        return MP_LT;
+        return MP_GT;
 
     /* compare based on magnitude */
     if (nu > 1)
@@ -817,9 +1823,9 @@ int vlong::Compare(sdig_t x) const
     }
     else
     {
-        if ((swrd_t)d[0] > -x)
+        if ((swrd_t)d[0] > -(swrd_t)x)
             return MP_LT;
-        if ((swrd_t)d[0] < -x)
+        if ((swrd_t)d[0] < -(swrd_t)x)
             return MP_GT;
     }
 
@@ -848,7 +1854,7 @@ int vlong::Compare(const vlong &v) const
 // Results are usual {-1,0,1} for {|a|<|b|, |a|==|b|, |a|>|b|} results.
 int vlong::CompareMag(const vlong &a, const vlong &b)
 {
-    int i;
+    size_t i;
 
     /* compare based on # of non-zero digits */
     if (a.nu > b.nu)
@@ -857,8 +1863,12 @@ int vlong::CompareMag(const vlong &a, const vlong &b)
     if (a.nu < b.nu)
         return MP_LT;
 
+    size_t chunks = prvParallelChunks(a.nu);
+    if (chunks > 1 && a.d[a.nu-1] == b.d[a.nu-1])
+        return prvCompareParallel(a.d, b.d, a.nu, chunks);
+
     /* compare based on digits  */
-    for (i=a.nu-1; i>=0; i--)
+    for (i=a.nu; i-- > 0; )
     {
         if (a.d[i] > b.d[i])
             return MP_GT;
@@ -868,6 +1878,27 @@ int vlong::CompareMag(const vlong &a, const vlong &b)
     return MP_EQ;
 }
 
+// The product is generated from the least significant digit up, the last
+// digit that differs from the corresponding digit of c decides the result
+int vlong::CompareMagMul(const vlong &a, udig_t b, const vlong &c)
+{
+    int res = MP_EQ;
+    uwrd_t w = 0;
+    size_t i, n = a.nu + 1 > c.nu ? a.nu + 1 : c.nu;
+
+    for (i=0; i<n; i++)
+    {
+        if (i < a.nu)
+            w += ((uwrd_t) a.d[i]) * b;
+        udig_t u = (udig_t) (w & MP_MASK_DIG);
+        udig_t v = i < c.nu ? c.d[i] : 0;
+        if (u != v)
+            res = u > v ? MP_GT : MP_LT;
+        w >>= BiD;
+    }
+    return res;
+}
+
 
 //*************************** Bitwise operations ***************************************
 
@@ -930,7 +1961,8 @@ int vlong::prvLeftShiftDigits(size_t digs)
     int ret = VLONG_SUCCESS;
     size_t i;
 
-    if (digs==0) return ret;
+    // zero stays zero
+    if (digs==0 || nu==0) return ret;
 
     // grow to fit the new digits
     if (na < nu + digs) CHECK( Grow(nu+digs) );
@@ -969,11 +2001,12 @@ int vlong::prvRightShiftDigits(size_t digs)
 int vlong::ShiftRight(const vlong &a, int bits)
 {
     int ret = VLONG_SUCCESS;
-    size_t b2;
-    int i;
+    size_t b2, i;
     udig_t tmp1,tmp2,mask;
 
     if (bits<0) return ShiftLeft(a, -bits);
+    size_t chunks = bits>0 ? prvParallelChunks(a.nu) : 1;
+    if (chunks > 1) return prvShiftParallel(a, -bits, chunks);
 
     if (&a!=this) SetValue(a);
     if (nu <= (size_t) bits/BiD) {SetZero(); return ret;}
@@ -991,7 +2024,7 @@ int vlong::ShiftRight(const vlong &a, int bits)
         // mask
         mask = (((udig_t)1) << b2) - 1;
         tmp1 = 0;
-        for (i=nu-1; i>=0; i--)
+        for (i=nu; i-- > 0; )
         {
             // get the lower  bits of this word in a temp
             tmp2 = d[i] & mask;
@@ -1019,6 +2052,8 @@ int vlong::ShiftLeft(const vlong &a, int bits)
     udig_t u;
     uwrd_t sum;
     if (bits<0) return ShiftRight(a, -bits);
+    size_t chunks = bits>0 ? prvParallelChunks(a.nu) : 1;
+    if (chunks > 1) return prvShiftParallel(a, bits, chunks);
 
     // copy
     if (&a != this) CHECK( SetValue(a) );
@@ -1092,8 +2127,8 @@ char vlong::GetBit(size_t num)
 
 int vlong::Xor(const vlong &a, const vlong &b)
 {
-    int nmin = a.nu<b.nu? a.nu : b.nu;
-    int i;
+    size_t nmin = a.nu<b.nu? a.nu : b.nu;
+    size_t i;
     int ret = VLONG_SUCCESS;
 
     if (&a==&b) { SetZero(); return ret; }
@@ -1121,7 +2156,7 @@ int vlong::SetBytes(int start, size_t count, const char *buf)
 
     if (start+count > nu*CiD)
     {
-        CHECK( Grow(start+count+1) );
+        CHECK( Grow(CHARS_TO_DIGITS(start+count)+1) );
         nu = CHARS_TO_DIGITS(start+count);
     }
 
@@ -1188,8 +2223,10 @@ int vlong::GenRandomBytes(size_t bytes, int (*pRNG_f)(void *, char *, size_t) /*
     }
 
     ret = FromBinary(buf, bytes);
+    delete [] buf;
     assert(na>=CHARS_TO_DIGITS(bytes));
     nu = CHARS_TO_DIGITS(bytes);
+    Clamp();
 
     return ret;
 }
@@ -1250,6 +2287,7 @@ int vlong::SearchNearestPrime()
 //
 int vlong::prvIsMillerRabinPrime(const vlong &a, const vlong &b, bool &bPrime)
 {
+    PROF_SCOPE(VLONG_PROF_MILLER_RABIN);
     vlong n1, y, r;
     int lsb, j;
     int ret = VLONG_SUCCESS;
@@ -1302,6 +2340,14 @@ int vlong::prvIsMillerRabinPrime(const vlong &a, const vlong &b, bool &bPrime)
 }
 
 bool vlong::IsPrime()
+{
+    TRACE1(isprime__entry, nu);
+    bool bPrime = prvIsPrime();
+    TRACE2(isprime__return, nu, bPrime);
+    return bPrime;
+}
+
+bool vlong::prvIsPrime()
 {
     bool bPrime = false;
     int i,j,n;
@@ -1493,36 +2539,86 @@ int vlong::Mul(const vlong &a, sdig_t b)
 // multiply by a digit
 int vlong::prvMulDig(const vlong &a, udig_t b)
 {
-    //vlong ttt = a;
+    //vlong ttt = a;
+    udig_t u;
+    uwrd_t w;
+    size_t i;
+    int ret = VLONG_SUCCESS;
+
+    if (nu < a.nu+1) CHECK( Grow(a.nu+1) );
+    nu = a.nu;
+
+    // zero carry
+    u = 0;
+    for (i = 0; i <a.nu; i++)
+    {
+        // Compute the sum at one digit, T[i] = A[i] + B[i] + U
+        w = ((uwrd_t) a.d[i]) * ((uwrd_t) b) + (uwrd_t)u ;
+        d[i] = (udig_t)(w & MP_MASK_DIG);
+
+        // U = carry bit of T[i]
+        u = (udig_t) (w >> BiD);
+    }
+
+    // add carry
+    if (u>0)
+    {
+        d[i] = u;
+        nu++;
+    }
+
+    //printf("%s * %x = %s\n", ttt.ToString(16), b, ToString(16));
+    return ret;
+}
+
+// multiply magnitude by a digit and add a digit, X <- |a| * b + c
+// (the added digit is the initial carry, so it costs nothing extra)
+int vlong::prvMulAddDig(const vlong &a, udig_t b, udig_t c)
+{
     udig_t u;
     uwrd_t w;
     size_t i;
     int ret = VLONG_SUCCESS;
 
-    if (nu < a.nu+1) CHECK( Grow(a.nu+1) );
-    nu = a.nu;
+    if (na < a.nu+1) CHECK( Grow(a.nu+1) );
 
-    // zero carry
-    u = 0;
+    u = c;
     for (i = 0; i <a.nu; i++)
     {
-        // Compute the sum at one digit, T[i] = A[i] + B[i] + U
-        w = ((uwrd_t) a.d[i]) * ((uwrd_t) b) + (uwrd_t)u ;
+        // T[i] = A[i] * B + U
+        w = ((uwrd_t) a.d[i]) * ((uwrd_t) b) + (uwrd_t)u;
         d[i] = (udig_t)(w & MP_MASK_DIG);
 
         // U = carry bit of T[i]
         u = (udig_t) (w >> BiD);
     }
+    nu = a.nu;
 
     // add carry
     if (u>0)
     {
-        d[i] = u;
+        d[nu] = u;
         nu++;
     }
+    s = MP_ZPOS;
 
-    //printf("%s * %x = %s\n", ttt.ToString(16), b, ToString(16));
-    return ret;
+    return Clamp();
+}
+
+//X <- a * b + c
+int vlong::MulAdd(const vlong &a, udig_t b, udig_t c)
+{
+    int ret = VLONG_SUCCESS;
+
+    if (a.s == MP_ZPOS)
+        return prvMulAddDig(a, b, c);
+
+    // -|a|*b + c
+    vlong t;
+    CHECK( prvMulAddDig(a, b, 0) );
+    if (nu>0) s = MP_NEG;
+    CHECK( t.prvMulAddDig(t, 1, c) );
+    return Add(*this, t);
 }
 
 // modulus of a number that is a power of 2
@@ -1587,17 +2683,17 @@ int vlong::prvIsPow2(udig_t b, size_t *nbits)
 // based on LibTomMath
 int vlong::prvDivInt(const vlong &a, udig_t b, vlong *q/*=NULL*/, udig_t *r/*=NULL*/)
 {
+    PROF_SCOPE(VLONG_PROF_DIV_DIGIT);
     udig_t t;
     uwrd_t w;
-    size_t ix;
-    int i;
+    size_t ix, i;
     int ret = VLONG_SUCCESS;
 
     if (b == 0) return VLONG_ERR_DIV_BY_ZERO;
     if (a.nu == 0)
     {
         if (q!=NULL) q->SetZero();
-        if (r!=NULL) *r = b;
+        if (r!=NULL) *r = 0;
         return ret;
     }
 
@@ -1627,7 +2723,7 @@ int vlong::prvDivInt(const vlong &a, udig_t b, vlong *q/*=NULL*/, udig_t *r/*=NU
 
     if (q!=NULL) q->nu = a.nu;
     w = 0;
-    for (i=a.nu-1; i>= 0; i--)
+    for (i=a.nu; i-- > 0; )
     {
         w = (w << ((uwrd_t)BiD)) | ((uwrd_t)a.d[i]);
 
@@ -1672,7 +2768,7 @@ int vlong::Div(const vlong &a, sdig_t b, sdig_t *r/*=NULL*/)
     else
         x = this;
 
-    CHECK( prvDivInt(a,b,x,&r2) );
+    CHECK( prvDivInt(a,b2,x,&r2) );
 
     if (r!=NULL)
     {
@@ -1703,10 +2799,15 @@ int vlong::Mod(const vlong &a, sdig_t b)
 sdig_t vlong::ModDig(const vlong &a, sdig_t b) const
 {
     if (b==0) return 0;
-    vlong tmp;
-    sdig_t r=0;
-    int ret = tmp.Div(a,b,&r);
-    return r;
+
+    // Horner's scheme from the most significant digit, no quotient is stored
+    udig_t b2 = b>0 ? (udig_t) b : (udig_t) -b;
+    uwrd_t w = 0;
+    size_t i;
+    for (i=a.nu; i>0; i--)
+        w = ((w << BiD) | a.d[i-1]) % b2;
+
+    return a.s==MP_NEG ? -((sdig_t) w) : (sdig_t) w;
 }
 
 //************************** Long-Long Arithmetic **************************************
@@ -1734,9 +2835,17 @@ int vlong::prvAddMag(const vlong &a, const vlong &b)
     memset(c->d, 0, sizeof(udig_t)*nu);
     c->nu = nmax;
 
-    // zero the carry
+    // zero the carry, huge numbers are added in chunks on separate threads
     u = 0;
-    for (i = 0; i < nmin; i++)
+    i = 0;
+    size_t chunks = prvParallelChunks(nmax);
+    if (chunks > 1)
+    {
+        u = prvAddSubParallel(c->d, x->d, nmax, x == &a ? b.d : a.d, nmin, false, chunks);
+        i = nmax;
+    }
+
+    for (; i < nmin; i++)
     {
         // Compute the sum at one digit, T[i] = A[i] + B[i] + U
         sum = ((uwrd_t) a.d[i]) + ((uwrd_t)b.d[i]) + (uwrd_t)u;
@@ -1748,17 +2857,14 @@ int vlong::prvAddMag(const vlong &a, const vlong &b)
 
     // now copy higher words if any, that is in A+B
     // if A or B has more digits add those in
-    if (nmin != nmax)
+    for (; i<nmax; i++)
     {
-        for (i=nmin; i<nmax; i++)
-        {
-            /* T[i] = X[i] + U */
-            sum = ((uwrd_t) x->d[i]) + (uwrd_t)u;
-            c->d[i] = (udig_t)(sum & MP_MASK_DIG);
+        /* T[i] = X[i] + U */
+        sum = ((uwrd_t) x->d[i]) + (uwrd_t)u;
+        c->d[i] = (udig_t)(sum & MP_MASK_DIG);
 
-            /* U = carry bit of T[i] */
-            u = (udig_t) (sum >> BiD);
-        }
+        /* U = carry bit of T[i] */
+        u = (udig_t) (sum >> BiD);
     }
 
     // add carry
@@ -1795,10 +2901,17 @@ int vlong::prvSubMag(const vlong &a, const vlong &b)
     memset(c->d, 0, sizeof(udig_t)*nmax);
     c->nu = nmax;
 
-    // zero the carry
+    // zero the carry, huge numbers are subtracted in chunks on separate threads
     u = 0;
+    i = 0;
+    size_t chunks = prvParallelChunks(nmax);
+    if (chunks > 1)
+    {
+        u = prvAddSubParallel(c->d, a.d, nmax, b.d, nmin, true, chunks);
+        i = nmax;
+    }
 
-    for (i = 0; i < nmin; i++)
+    for (; i < nmin; i++)
     {
         // T[i] = A[i] - B[i] - U
         dif = ((swrd_t)a.d[i]) - ((swrd_t)b.d[i]) - ((swrd_t)u);
@@ -1807,7 +2920,7 @@ int vlong::prvSubMag(const vlong &a, const vlong &b)
     }
 
     // now copy higher words if any, e.g. if A has more digits than B
-    for (i=nmin; i<nmax; i++)
+    for (; i<nmax; i++)
     {
         // T[i] = A[i] - U
         dif = ((swrd_t)a.d[i]) - ((swrd_t)u);
@@ -1932,7 +3045,7 @@ int vlong::prvMulKaratsuba(const vlong &a, const vlong &b)
     int ret = VLONG_SUCCESS;
 
     vlong x0, x1, y0, y1, t1, x0y0, x1y1;
-    int B;
+    size_t B;
 
     vlong tmp1;
     vlong *c;
@@ -1975,15 +3088,29 @@ int vlong::prvMulKaratsuba(const vlong &a, const vlong &b)
     CHECK( x0.Clamp() );
     CHECK( y0.Clamp() );
 
-    // now calc the products x0y0 and x1y1
-    // after this x0 is no longer required, free temp [x0==t2]!
-    CHECK( x0y0.Mul(x0, y0) );
-    CHECK( x1y1.Mul(x1, y1) );
+    vlong_executor *ex = B*2 >= VLONG_PARALLEL_MUL_CUTOFF ? prvParallelExecutor() : NULL;
+    if (ex != NULL)
+    {
+        // the three products on separate threads (PowModParallel())
+        vlong t2;
+        CHECK( t1.Add( x1, x0 ));
+        CHECK( t2.Add( y1, y0 ));
+        vlong *r[3] = {&x0y0, &x1y1, &t1};
+        const vlong *f1[3] = {&x0, &x1, &t1}, *f2[3] = {&y0, &y1, &t2};
+        CHECK( prvMulParallel(ex, r, f1, f2) );
+    }
+    else
+    {
+        // now calc the products x0y0 and x1y1
+        // after this x0 is no longer required, free temp [x0==t2]!
+        CHECK( x0y0.Mul(x0, y0) );
+        CHECK( x1y1.Mul(x1, y1) );
 
-    // now calc x1+x0 and y1+y0
-    CHECK( t1.Add( x1, x0 ));
-    CHECK( x0.Add( y1, y0 ));
-    CHECK( t1.Mul( x0, t1 ));
+        // now calc x1+x0 and y1+y0
+        CHECK( t1.Add( x1, x0 ));
+        CHECK( x0.Add( y1, y0 ));
+        CHECK( t1.Mul( x0, t1 ));
+    }
 
     // add x0y0
     CHECK( x0.Add( x0y0, x1y1 ));            // t2 = x0y0 + x1y1
@@ -2054,6 +3181,335 @@ int vlong::prvMulBaseline(const vlong &a, const vlong &b, size_t ndigs)
     return ret;
 }
 
+//********************************* NTT multiplication *********************************
+// Products of huge numbers as cyclic convolutions of their 16-bit pieces modulo
+// p = 2^64 - 2^32 + 1, which has roots of unity of every order up to 2^32 and a
+// cheap reduction (2^64 = 2^32 - 1, 2^96 = -1 mod p). The coefficients stay below
+// 2^32 * (2^16-1)^2 < p, so products of up to 2^36 bits are exact; Mul() splits
+// larger ones by Karatsuba.
+//
+// The N = n1*n2 point transform is the four-step one [Bailey. FFTs in external or
+// hierarchical memory, 1990] on the n1 x n2 matrix of the pieces: n1-point column
+// transforms on blocks of NTT_BLOCK pieces (whole pages of each row), a twiddle,
+// then the n2-point row transforms. Each pass reads and writes the transform in
+// order, so it streams through mapped files (see SetMapDir()). Forward transforms
+// leave their outputs in bit reversed order and the inverse ones take them so,
+// which needs no permutation since only the products of the outputs are used.
+
+#if defined(_MSC_VER)
+typedef unsigned __int64 ntt_t;
+#else
+typedef unsigned long long ntt_t;
+#endif
+
+static const ntt_t NTT_P = 0xFFFFFFFF00000001ULL;
+static const ntt_t NTT_EPS = 0xFFFFFFFFULL;     // 2^64 mod p
+static const ntt_t NTT_ROOT = 7;                // generates the multiplicative group
+
+#define NTT_MAX_ROWS   (1 << 12)
+#define NTT_BLOCK      (1 << 22)
+
+static inline ntt_t ntt_add(ntt_t a, ntt_t b)
+{
+    ntt_t r = a + b;
+    if (r < a || r >= NTT_P) r -= NTT_P;
+    return r;
+}
+
+static inline ntt_t ntt_sub(ntt_t a, ntt_t b)
+{
+    ntt_t r = a - b;
+    if (a < b) r += NTT_P;
+    return r;
+}
+
+static inline ntt_t ntt_mul(ntt_t a, ntt_t b)
+{
+    ntt_t lo, hi;
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 x = (unsigned __int128) a * b;
+    lo = (ntt_t) x;
+    hi = (ntt_t) (x >> 64);
+#else
+    ntt_t a0 = a & NTT_EPS, a1 = a >> 32, b0 = b & NTT_EPS, b1 = b >> 32;
+    ntt_t p00 = a0*b0, p01 = a0*b1, p10 = a1*b0;
+    ntt_t mid = (p00 >> 32) + (p01 & NTT_EPS) + (p10 & NTT_EPS);
+    lo = (p00 & NTT_EPS) | (mid << 32);
+    hi = a1*b1 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
+    // lo + 2^64 * (hi mod 2^32) + 2^96 * (hi >> 32) = lo + eps * (hi mod 2^32) - (hi >> 32)
+    ntt_t t = lo - (hi >> 32);
+    if (lo < (hi >> 32)) t -= NTT_EPS;
+    ntt_t u = (hi & NTT_EPS) * NTT_EPS;
+    ntt_t r = t + u;
+    if (r < u) r += NTT_EPS;
+    if (r >= NTT_P) r -= NTT_P;
+    return r;
+}
+
+static ntt_t ntt_pow(ntt_t a, ntt_t e)
+{
+    ntt_t r = 1;
+    for (; e > 0; e >>= 1)
+    {
+        if (e & 1) r = ntt_mul(r, a);
+        a = ntt_mul(a, a);
+    }
+    return r;
+}
+
+// Root of unity of order n (a power of 2), or its inverse
+static ntt_t ntt_root(size_t n, bool inverse)
+{
+    ntt_t w = ntt_pow(NTT_ROOT, (NTT_P - 1) / n);
+    return inverse ? ntt_pow(w, NTT_P - 2) : w;
+}
+
+// tw[h+j] = w^j for the roots w of order 2h, h = 1, 2, 4, ... n/2
+static void ntt_twiddles(ntt_t *tw, size_t n, bool inverse)
+{
+    for (size_t h = 1; h < n; h <<= 1)
+    {
+        ntt_t w = ntt_root(2*h, inverse);
+        tw[h] = 1;
+        for (size_t j = 1; j < h; j++)
+            tw[h+j] = ntt_mul(tw[h+j-1], w);
+    }
+}
+
+// Transforms of the m interleaved columns of the n x m matrix x: decimation in
+// frequency from natural to bit reversed order, and decimation in time back
+static void ntt_dif(ntt_t *x, size_t n, size_t m, const ntt_t *tw)
+{
+    for (size_t h = n >> 1; h > 0; h >>= 1)
+        for (size_t i = 0; i < n; i += 2*h)
+            for (size_t j = 0; j < h; j++)
+            {
+                ntt_t w = tw[h+j], *u = x + (i+j)*m, *v = x + (i+j+h)*m;
+                for (size_t c = 0; c < m; c++)
+                {
+                    ntt_t t = u[c];
+                    u[c] = ntt_add(t, v[c]);
+                    v[c] = ntt_mul(ntt_sub(t, v[c]), w);
+                }
+            }
+}
+
+static void ntt_dit(ntt_t *x, size_t n, size_t m, const ntt_t *tw)
+{
+    for (size_t h = 1; h < n; h <<= 1)
+        for (size_t i = 0; i < n; i += 2*h)
+            for (size_t j = 0; j < h; j++)
+            {
+                ntt_t w = tw[h+j], *u = x + (i+j)*m, *v = x + (i+j+h)*m;
+                for (size_t c = 0; c < m; c++)
+                {
+                    ntt_t t = ntt_mul(v[c], w);
+                    v[c] = ntt_sub(u[c], t);
+                    u[c] = ntt_add(u[c], t);
+                }
+            }
+}
+
+// Four-step transforms of N = n1*n2 points with columns in blocks of b
+struct NttPlan
+{
+    size_t n1, n2, b;
+    ntt_t *tw1, *itw1, *tw2, *itw2;
+    ntt_t *w, *iw;          // (inverse) root of order N to the bit reversed row
+    ntt_t *buf;             // block of b columns, unless b == n2
+
+    NttPlan(int bits)
+    {
+        int l1 = bits / 2;
+        while ((1 << l1) > NTT_MAX_ROWS) l1--;
+        n1 = (size_t) 1 << l1;
+        n2 = (size_t) 1 << (bits - l1);
+        b = n1*n2 <= NTT_BLOCK ? n2 : NTT_BLOCK / n1;
+        tw1 = itw1 = tw2 = itw2 = w = iw = buf = NULL;
+
+        tw1 = new ntt_t[n1];    ntt_twiddles(tw1, n1, false);
+        itw1 = new ntt_t[n1];   ntt_twiddles(itw1, n1, true);
+        tw2 = new ntt_t[n2];    ntt_twiddles(tw2, n2, false);
+        itw2 = new ntt_t[n2];   ntt_twiddles(itw2, n2, true);
+
+        ntt_t wn = ntt_root(n1*n2, false), iwn = ntt_root(n1*n2, true);
+        w = new ntt_t[n1];
+        iw = new ntt_t[n1];
+        for (size_t r = 0; r < n1; r++)
+        {
+            size_t k = 0;
+            for (int i = 0; i < l1; i++)
+                k |= ((r >> i) & 1) << (l1 - 1 - i);
+            w[r] = ntt_pow(wn, k);
+            iw[r] = ntt_pow(iwn, k);
+        }
+        if (b < n2) buf = new ntt_t[n1*b];
+    }
+
+    ~NttPlan()
+    {
+        delete [] tw1; delete [] itw1; delete [] tw2; delete [] itw2;
+        delete [] w; delete [] iw; delete [] buf;
+    }
+
+    void Forward(ntt_t *x) const
+    {
+        size_t r, c, c0, m;
+        for (c0 = 0; c0 < n2; c0 += b)
+        {
+            m = b;
+            ntt_t *y = buf != NULL ? buf : x;
+            if (buf != NULL)
+                for (r = 0; r < n1; r++)
+                    memcpy(y + r*m, x + r*n2 + c0, m*sizeof(ntt_t));
+            ntt_dif(y, n1, m, tw1);
+            for (r = 0; r < n1; r++)
+            {
+                ntt_t t = ntt_pow(w[r], c0), *z = x + r*n2 + c0, *yr = y + r*m;
+                for (c = 0; c < m; c++)
+                {
+                    z[c] = ntt_mul(yr[c], t);
+                    t = ntt_mul(t, w[r]);
+                }
+            }
+        }
+        for (r = 0; r < n1; r++)
+            ntt_dif(x + r*n2, n2, 1, tw2);
+    }
+
+    // Also divides by N
+    void Inverse(ntt_t *x) const
+    {
+        size_t r, c, c0, m;
+        ntt_t inv = ntt_pow((ntt_t) (n1*n2), NTT_P - 2);
+        for (r = 0; r < n1; r++)
+            ntt_dit(x + r*n2, n2, 1, itw2);
+        for (c0 = 0; c0 < n2; c0 += b)
+        {
+            m = b;
+            ntt_t *y = buf != NULL ? buf : x;
+            for (r = 0; r < n1; r++)
+            {
+                ntt_t t = ntt_mul(ntt_pow(iw[r], c0), inv), *z = x + r*n2 + c0, *yr = y + r*m;
+                for (c = 0; c < m; c++)
+                {
+                    yr[c] = ntt_mul(z[c], t);
+                    t = ntt_mul(t, iw[r]);
+                }
+            }
+            ntt_dit(y, n1, m, itw1);
+            if (buf != NULL)
+                for (r = 0; r < n1; r++)
+                    memcpy(x + r*n2 + c0, y + r*m, m*sizeof(ntt_t));
+        }
+    }
+};
+
+// The 16-bit pieces of d[0..n) into x[0..N), zero padded
+static void ntt_load(ntt_t *x, size_t N, const udig_t *d, size_t n)
+{
+    size_t i, k = 0;
+    int b, bits = 0;
+    ntt_t acc = 0;
+    for (i = 0; i < n; i++)
+        for (b = 0; b < BiD; b += 8)
+        {
+            acc |= ((ntt_t) ((d[i] >> b) & 0xFF)) << bits;
+            bits += 8;
+            if (bits == 16)
+            {
+                x[k++] = acc;
+                acc = 0;
+                bits = 0;
+            }
+        }
+    if (bits > 0) x[k++] = acc;
+    for (; k < N; k++) x[k] = 0;
+}
+
+// |a| * |b| from the inverse transform of the products of the transforms
+int vlong::prvMulNTT(const vlong &a, const vlong &b)
+{
+    int ret = VLONG_SUCCESS;
+    size_t pieces = ((a.nu + b.nu) * BiD + 15) / 16;
+    size_t N, k, i, digs = a.nu + b.nu;
+    size_t nx = 0, ny = 0;
+    ntt_t *x = NULL, *y = NULL;
+    int bits;
+
+    for (bits = 1, N = 2; N < pieces; bits++, N <<= 1)
+        ;
+
+    vlong tmp1;
+    vlong *c = (&a==this || &b == this) ? &tmp1 : this;
+    CHECK( c->Grow(digs) );
+
+    try
+    {
+        NttPlan plan(bits);
+
+        nx = N * sizeof(ntt_t) / sizeof(udig_t);
+        x = (ntt_t *) digits_alloc(&nx);
+        if (x == NULL) return VLONG_ERR_MEMORY_ALLOC;
+        ntt_load(x, N, a.d, a.nu);
+        plan.Forward(x);
+        if (&a == &b)
+            for (k = 0; k < N; k++)
+                x[k] = ntt_mul(x[k], x[k]);
+        else
+        {
+            ny = N * sizeof(ntt_t) / sizeof(udig_t);
+            y = (ntt_t *) digits_alloc(&ny);
+            if (y == NULL) ret = VLONG_ERR_MEMORY_ALLOC;
+            else
+            {
+                ntt_load(y, N, b.d, b.nu);
+                plan.Forward(y);
+                for (k = 0; k < N; k++)
+                    x[k] = ntt_mul(x[k], y[k]);
+                digits_free((udig_t *) y, ny);
+            }
+        }
+        if (ret == VLONG_SUCCESS)
+        {
+            plan.Inverse(x);
+
+            // carry the coefficients into 16-bit pieces and those into digits
+            ntt_t carry = 0;
+            udig_t u = 0;
+            int sh = 0;
+            for (k = 0, i = 0; k < N && i < digs; k++)
+            {
+                ntt_t t = x[k] + carry;
+                carry = (t >> 16) | ((ntt_t) (t < carry) << 48);
+                for (int j = 0; j < 16; j += 8)
+                {
+                    u |= ((udig_t) ((t >> j) & 0xFF)) << sh;
+                    sh += 8;
+                    if (sh == BiD)
+                    {
+                        c->d[i++] = u;
+                        u = 0;
+                        sh = 0;
+                    }
+                }
+            }
+            c->nu = digs;
+            c->Clamp();
+        }
+        digits_free((udig_t *) x, nx);
+    }
+    catch (...)
+    {
+        return VLONG_ERR_MEMORY_ALLOC;
+    }
+    if (ret != VLONG_SUCCESS) return ret;
+
+    if (c != this) prvMovePtr(tmp1);
+    return ret;
+}
+
 // high level multiplication
 int vlong::Mul(const vlong &a, const vlong &b, size_t maxdigs /*=0*/)
 {
@@ -2061,12 +3517,13 @@ int vlong::Mul(const vlong &a, const vlong &b, size_t maxdigs /*=0*/)
     int ret = VLONG_SUCCESS;
 
     if (a.nu==0 || b.nu==0) {SetZero(); return ret;}
-    int nmin = a.nu < b.nu ? a.nu : b.nu;
-    int nmax = a.nu > b.nu ? a.nu : b.nu;
+    size_t nmin = a.nu < b.nu ? a.nu : b.nu;
 
     vlong tmp1;
     vlong *x;
 
+    PROF_SIZE(&a == &b ? VLONG_SIZES_SQR : VLONG_SIZES_MUL, nmin);
+
     if (&a==this || &b == this)
         x = &tmp1;
     else
@@ -2076,16 +3533,28 @@ int vlong::Mul(const vlong &a, const vlong &b, size_t maxdigs /*=0*/)
     if (x->nu < digs) CHECK( x->Grow(digs) );
     if (maxdigs>0 && maxdigs<digs) digs = maxdigs;
 
-    // use Karatsuba?
-    if (nmin >= VLONG_KARATSUBA_MUL_CUTOFF)
+    // use Karatsuba? NTT up to products of 2^36 bits (Karatsuba splits larger ones)
+    bool karatsuba = nmin >= VLONG_KARATSUBA_MUL_CUTOFF;
+    bool ntt = nmin >= VLONG_NTT_MUL_CUTOFF && (double) (a.nu + b.nu) * BiD <= 68719476736.0;
+    int alg = &a == &b ? (karatsuba ? VLONG_PROF_SQR_KARATSUBA : VLONG_PROF_SQR_BASELINE)
+                       : (karatsuba ? VLONG_PROF_MUL_KARATSUBA : VLONG_PROF_MUL_BASELINE);
+    if (ntt) alg = VLONG_PROF_MUL_NTT;
+    (void) alg;     // unused without VLONG_PROFILE and VLONG_USDT
+    PROF_SCOPE(alg);
+    TRACE3(mul__entry, a.nu, b.nu, alg);
+    if (ntt)
+        ret = x->prvMulNTT(a, b);
+    else if (karatsuba)
         ret = x->prvMulKaratsuba(a, b);
     else
         ret = x->prvMulBaseline(a, b, digs);
+    TRACE2(mul__return, alg, ret);
 
     if (x->nu>digs)
     {
-        memset(&x->d[digs],0,x->nu-digs*sizeof(udig_t));
+        memset(&x->d[digs],0,(x->nu-digs)*sizeof(udig_t));
         x->nu = digs;
+        x->Clamp();
     }
 
     if (&a==this || &b == this) prvMovePtr(tmp1);
@@ -2126,12 +3595,14 @@ int vlong::Sqr(const vlong &a)
 // based on LibTomMath
 int vlong::prvDivBig(const vlong &a, const vlong &b, vlong *q2/*=NULL*/,  vlong *r/*=NULL*/)
 {
+    PROF_SCOPE(VLONG_PROF_DIV_SCHOOLBOOK);
     int ret = VLONG_SUCCESS;
 
     vlong q,x,y,t1,t2;
     int i,t,n;
     size_t norm;
     char sign = a.s==b.s ? MP_ZPOS : MP_NEG;
+    char rsign = a.s;
 
     if (b.nu==0) return VLONG_ERR_DIV_BY_ZERO;
 
@@ -2148,7 +3619,7 @@ int vlong::prvDivBig(const vlong &a, const vlong &b, vlong *q2/*=NULL*/,  vlong
         if (r!=NULL) r->SetZero();
         if (q2!=NULL)
         {
-            q2->SetValue(a);
+            CHECK( q2->SetValue(1) );
             q2->s = sign;
         }
         return ret;
@@ -2263,29 +3734,171 @@ int vlong::prvDivBig(const vlong &a, const vlong &b, vlong *q2/*=NULL*/,  vlong
     {
         CHECK( x.ShiftRight(x, norm) );
         r->swap(x);
-        r->s = a.s;
+        if (r->nu>0) r->s = rsign;
+    }
+    return ret;
+}
+
+
+// computes X = floor(2**(2n) / b), where b has exactly n bits
+//
+// A half precision reciprocal of the top bits of b is refined by one
+// Newton step X <- X + X*(2**2n - b*X)/2**2n, which doubles the number
+// of correct bits, followed by a final correction to the exact floor.
+// The recursion costs a few multiplications of the full size.
+int vlong::prvReciprocal(const vlong &b, size_t n)
+{
+    int ret = VLONG_SUCCESS;
+    vlong x, e, p2, bh;
+    size_t h;
+
+    // small reciprocals are computed by plain division
+    if (n <= (size_t)(2*BiD))
+    {
+        CHECK( p2.prv2Expt(2*n) );
+        return prvDivBig(p2, b, this, NULL);
     }
+
+    // estimate from the reciprocal of the top h bits of b
+    h = (n+1)/2 + 2;
+    CHECK( bh.ShiftRight(b, (int)(n-h)) );
+    CHECK( x.prvReciprocal(bh, h) );
+    CHECK( x.ShiftLeft(x, (int)(n-h)) );
+
+    // e = 2**2n - b*x
+    CHECK( p2.prv2Expt(2*n) );
+    CHECK( e.Mul(b, x) );
+    CHECK( e.Sub(p2, e) );
+
+    // x = x + x*e/2**2n
+    CHECK( e.Mul(e, x) );
+    CHECK( e.ShiftRight(e, (int)(2*n)) );
+    CHECK( x.Add(x, e) );
+
+    // now x is off by a few units, make 0 <= 2**2n - b*x < b
+    CHECK( e.Mul(b, x) );
+    CHECK( e.Sub(p2, e) );
+    while (e.s == MP_NEG && e.nu>0)
+    {
+        CHECK( x.Sub(x, 1) );
+        CHECK( e.Add(e, b) );
+    }
+    while (CompareMag(e, b) != MP_LT)
+    {
+        CHECK( x.Add(x, 1) );
+        CHECK( e.Sub(e, b) );
+    }
+
+    swap(x);
     return ret;
 }
 
+// determines if division by Newton reciprocal pays off and fits VLONG_MAX_DIGITS
+bool vlong::prvIsNewtonDiv(const vlong &a, const vlong &b)
+{
+    if (b.nu < VLONG_NEWTON_DIV_CUTOFF || a.nu < b.nu + VLONG_NEWTON_DIV_CUTOFF)
+        return false;
+#ifdef VLONG_MAX_DIGITS
+    // the Newton step multiplies numbers of up to 3 times the size of a
+    if (3*a.nu + 4 > VLONG_MAX_DIGITS)
+        return false;
+#endif
+    return true;
+}
+
+// q <- a/b, r <- a%b using the reciprocal of b
+//
+// With L bits in a, n bits in b and t = L - n, X = floor(2**(n+t) / b)
+// gives q0 = floor(a*X / 2**(n+t)) which is at most two less than the
+// quotient. The remainder a - q0*b fixes that.
+int vlong::prvDivNewton(const vlong &a, const vlong &b, vlong *q2/*=NULL*/,  vlong *r/*=NULL*/)
+{
+    PROF_SCOPE(VLONG_PROF_DIV_NEWTON);
+    int ret = VLONG_SUCCESS;
+    vlong x, q, t1, ua, ub;
+    size_t n, t;
+    char sign = a.s==b.s ? MP_ZPOS : MP_NEG;
+    char rsign = a.s;
+
+    if (b.nu==0) return VLONG_ERR_DIV_BY_ZERO;
+
+    CHECK( ua.Abs(a) );
+    CHECK( ub.Abs(b) );
+
+    n = ub.GetNumBits();
+    t = ua.GetNumBits() - n;
+
+    if (t <= n)
+    {
+        CHECK( x.prvReciprocal(ub, n) );
+        CHECK( x.ShiftRight(x, (int)(n-t)) );
+    }
+    else
+    {
+        CHECK( t1.ShiftLeft(ub, (int)(t-n)) );
+        CHECK( x.prvReciprocal(t1, t) );
+    }
+
+    CHECK( q.Mul(ua, x) );
+    CHECK( q.ShiftRight(q, (int)(n+t)) );
+
+    // r = a - q*b, 0 <= r < b
+    CHECK( t1.Mul(q, ub) );
+    CHECK( ua.Sub(ua, t1) );
+    while (CompareMag(ua, ub) != MP_LT)
+    {
+        CHECK( q.Add(q, 1) );
+        CHECK( ua.Sub(ua, ub) );
+    }
+
+    if (q2!=NULL)
+    {
+        q2->swap(q);
+        if (q2->nu>0) q2->s = sign;
+    }
+    if (r!=NULL)
+    {
+        r->swap(ua);
+        if (r->nu>0) r->s = rsign;
+    }
+    return ret;
+}
 
 //X <- a / b
 int vlong::Div(const vlong &a, const vlong &b, vlong *r)
 {
-    return prvDivBig(a, b, this, r);
+    PROF_SIZE(VLONG_SIZES_DIV, b.nu);
+    PROF_SIZE(VLONG_SIZES_QUOTIENT, a.nu > b.nu ? a.nu - b.nu : 0);
+    int alg = prvIsNewtonDiv(a, b) ? VLONG_PROF_DIV_NEWTON : VLONG_PROF_DIV_SCHOOLBOOK;
+    TRACE3(div__entry, a.nu, b.nu, alg);
+    int ret = alg == VLONG_PROF_DIV_NEWTON ? prvDivNewton(a, b, this, r) : prvDivBig(a, b, this, r);
+    TRACE2(div__return, alg, ret);
+    return ret;
 }
 
 //X <- a % b
 int vlong::Mod(const vlong &a, const vlong &b)
 {
     if (b.nu==0) {SetZero(); return VLONG_SUCCESS; }
-    int ret = prvDivBig(a,b,NULL,this);
+    PROF_SIZE(VLONG_SIZES_MOD, b.nu);
+    PROF_SIZE(VLONG_SIZES_QUOTIENT, a.nu > b.nu ? a.nu - b.nu : 0);
+    int alg = prvIsNewtonDiv(a, b) ? VLONG_PROF_DIV_NEWTON : VLONG_PROF_DIV_SCHOOLBOOK;
+    TRACE3(mod__entry, a.nu, b.nu, alg);
+    int ret = alg == VLONG_PROF_DIV_NEWTON ? prvDivNewton(a, b, NULL, this) : prvDivBig(a,b,NULL,this);
+    TRACE2(mod__return, alg, ret);
     return ret;
 }
 
 //X <- a % b (Must hold: 0<a<b*b)
 int vlong::ModBarrett(const vlong &a, const vlong &b)
 {
+    // keep a copy of the modulus if it is overwritten by the result
+    if (&b==this)
+    {
+        vlong n(b);
+        return ModBarrett(a, n);
+    }
+
     vlong mu;
     int ret = VLONG_SUCCESS;
 
@@ -2298,6 +3911,13 @@ int vlong::ModBarrett(const vlong &a, const vlong &b)
 //X <- a % b (Must hold: 0<a<b*b and b is odd)
 int vlong::ModMontgomery(const vlong &a, const vlong &b)
 {
+    // keep a copy of the modulus if it is overwritten by the result
+    if (&b==this)
+    {
+        vlong n(b);
+        return ModMontgomery(a, n);
+    }
+
     udig_t rho;
     int ret = VLONG_SUCCESS;
 
@@ -2310,6 +3930,13 @@ int vlong::ModMontgomery(const vlong &a, const vlong &b)
 //X <- a % b (Must hold: 0<a<b*b, half or more digits of b must me 1 bits)
 int vlong::ModDRExt(const vlong &a, const vlong &b)
 {
+    // keep a copy of the modulus if it is overwritten by the result
+    if (&b==this)
+    {
+        vlong n(b);
+        return ModDRExt(a, n);
+    }
+
     vlong mu;
     int ret = VLONG_SUCCESS;
 
@@ -2484,6 +4111,51 @@ int vlong::Root(const vlong &a, udig_t n)
     return ret;
 }
 
+// integer square root
+//
+// Newton's iteration x[i+1] = (x[i] + a/x[i])/2 started above
+// the root decreases monotonically until it reaches floor(sqrt(a)).
+// Unlike Root() it starts from 2^ceil(bits/2), so the number
+// of iterations is logarithmic in the size of a.
+//
+// based on mp_sqrt() of LibTomMath
+int vlong::Sqrt(const vlong &a)
+{
+    vlong t1, t2;
+    int ret = VLONG_SUCCESS;
+
+    if (a.s == MP_NEG && a.nu > 0)
+        return VLONG_ERR_NEGATIVE_ARG;
+
+    if (a.nu == 0)
+    {
+        SetZero();
+        return ret;
+    }
+
+    // t1 = 2^ceil(bits/2) > sqrt(a)
+    CHECK( t1.SetValue(1) );
+    CHECK( t1.ShiftLeft(t1, (int) ((a.GetNumBits()+1)/2)) );
+
+    for (;;)
+    {
+        // t2 = (t1 + a/t1)/2
+        CHECK( t2.Div(a, t1) );
+        t2.s = MP_ZPOS;
+        CHECK( t2.Add(t2, t1) );
+        CHECK( t2.ShiftRight(t2, 1) );
+
+        if (t2.Compare(t1) != MP_LT)
+            break;
+        t1.swap(t2);
+    }
+
+    swap(t1);
+    s = MP_ZPOS;
+
+    return ret;
+}
+
 //Computes X such as a*X=1 (mod n). Must hold: gcd(a,n)=1
 //HAC 14.61,14.64
 int vlong::InvMod(const vlong &a, const vlong &n)
@@ -2574,6 +4246,7 @@ int vlong::prvMod2d(const vlong &a, int b)
 // From HAC pp.604 Algorithm 14.42
 int vlong::prvReduceBarrett(vlong *x, const vlong &n, const vlong &mu)
 {
+    PROF_SCOPE(VLONG_PROF_REDUCE_BARRETT);
     vlong q;
     size_t um = n.nu;
     int ret = VLONG_SUCCESS;
@@ -2609,7 +4282,7 @@ int vlong::prvReduceBarrett(vlong *x, const vlong &n, const vlong &mu)
         CHECK( x->Add(*x, q) );
     }
 
-    while (x->Compare(n) == MP_GT)
+    while (x->Compare(n) != MP_LT)
     {
         CHECK( x->Sub(*x, n) );
     }
@@ -2681,6 +4354,7 @@ int vlong::prvMontgomeryNorm(vlong *a, const vlong &b)
 // based on mp_montgomery_reduce of LibTomMath
 int vlong::prvReduceMontgomery(vlong *x, const vlong &n, udig_t rho)
 {
+    PROF_SCOPE(VLONG_PROF_REDUCE_MONTGOMERY);
     int i, j, digs;
     int ret = VLONG_SUCCESS;
     udig_t mu, u;
@@ -2745,7 +4419,7 @@ int vlong::prvReduceMontgomery(vlong *x, const vlong &n, udig_t rho)
     x->prvRightShiftDigits(n.nu);
 
     // if x >= n then x = x - n
-    if (CompareMag (*x, n) == MP_GT) return x->prvSubMag(*x, n);
+    if (CompareMag (*x, n) != MP_LT) return x->prvSubMag(*x, n);
 
     return ret;
 }
@@ -2789,6 +4463,7 @@ int vlong::prvReduceDRSetup(const vlong &n, vlong *mu)
 // based on mp_reduce_2k_l of LibTomMath
 int vlong::prvReduceDR(vlong *x, const vlong &n, const vlong &mu)
 {
+    PROF_SCOPE(VLONG_PROF_REDUCE_DR);
     vlong q,ttt;
     size_t p = n.GetNumBits();
     int ret = VLONG_SUCCESS;
@@ -2805,7 +4480,7 @@ int vlong::prvReduceDR(vlong *x, const vlong &n, const vlong &mu)
         // x = x + q
         CHECK( x->prvAddMag(*x, q) );
 
-        if (CompareMag(*x,n) == MP_GT)
+        if (CompareMag(*x,n) != MP_LT)
         {
             CHECK( x->Sub(*x, n) );
             continue;
@@ -2828,6 +4503,7 @@ int vlong::prvReduceDR(vlong *x, const vlong &n, const vlong &mu)
 // based on s_mp_exptmod of LibTomMath
 int vlong::prvPowModBarrett(const vlong &a, const vlong &e, const vlong &n, int redmode)
 {
+    PROF_SCOPE(redmode == 1 ? VLONG_PROF_POWMOD_DR : VLONG_PROF_POWMOD_BARRETT);
     vlong M[TAB_SIZE], res, mu;
     udig_t buf;
     int bitbuf, bitcpy, bitcnt, mode, digidx, x, y, winsize;
@@ -2880,6 +4556,11 @@ int vlong::prvPowModBarrett(const vlong &a, const vlong &e, const vlong &n, int
     //
     CHECK( M[1].Mod(a, n) );
 
+    // a negative base is brought into [0, n) so that the result is too (DR
+    // reduction never terminates on a negative value)
+    if (M[1].s == MP_NEG)
+        CHECK( M[1].Add(M[1], n) );
+
     //compute the value at M[1<<(winsize-1)] by squaring
     // M[1] (winsize-1) times
     CHECK(  M[1 << (winsize - 1)].Copy(M[1]) );
@@ -3001,6 +4682,7 @@ int vlong::prvPowModBarrett(const vlong &a, const vlong &e, const vlong &n, int
 // based on mp_exptmod_fast of LibTomMath
 int vlong::prvPowModMontgomery(const vlong &a, const vlong &e, const vlong &n)
 {
+    PROF_SCOPE(VLONG_PROF_POWMOD_MONTGOMERY);
     int ret = VLONG_SUCCESS;
     vlong M[TAB_SIZE], res;
     udig_t buf, mp;
@@ -3029,6 +4711,8 @@ int vlong::prvPowModMontgomery(const vlong &a, const vlong &e, const vlong &n)
 
     // now set M[1] to G * R mod m
     CHECK( M[1].MulMod(a, res, n) );
+    if (M[1].s == MP_NEG)
+        CHECK( M[1].Add(M[1], n) );
 
     // compute the value at M[1<<(winsize-1)] by squaring M[1] (winsize-1) times
     //compute the value at M[1<<(winsize-1)] by squaring
@@ -3173,31 +4857,34 @@ int vlong::PowMod(const vlong &a, const vlong &e, const vlong &n)
 
         // now get |X|
         CHECK( tmpX.SetValue(e) );
+        tmpX.s = MP_ZPOS;
 
         // and now compute (1/G)**|X| instead of G**X [X < 0]
-        CHECK ( PowMod(a, e, n) );
+        CHECK ( PowMod(tmpG, tmpX, n) );
         return ret;
     }
 
+    PROF_SIZE(VLONG_SIZES_POWMOD, n.nu);
+    PROF_SIZE(VLONG_SIZES_POWMOD_EXP, e.GetNumBits());
+
+    // the generic Barrett reduction technique unless a faster one applies
+    int alg = VLONG_PROF_POWMOD_BARRETT;
+#ifdef VLONG_USE_MONTGOMRTY
+    // if the modulus is odd use the montgomery method
+    if (n.nu>0 && (n.d[0] & 1) == 1)
+        alg = VLONG_PROF_POWMOD_MONTGOMERY;
+#endif
 #ifdef VLONG_USE_DR_REDUCE
     if (n.prvIsDrModulus())
-        return prvPowModBarrett(a, e, n, 1);
+        alg = VLONG_PROF_POWMOD_DR;
 #endif
 
-#ifdef VLONG_USE_MONTGOMRTY
-    if ((a.d[0] & 1) == 1)
-    {
-        // if the modulus is odd or dr != 0 use the montgomery method
-        return prvPowModMontgomery(a, e, n);
-    }
+    TRACE3(powmod__entry, n.nu, e.nu, alg);
+    if (alg == VLONG_PROF_POWMOD_MONTGOMERY)
+        ret = prvPowModMontgomery(a, e, n);
     else
-    {
-        // otherwise use the generic Barrett reduction technique
-        return prvPowModBarrett(a, e, n, 0);
-    }
-#else
-    return prvPowModBarrett(a, e, n, 0);
-#endif
+        ret = prvPowModBarrett(a, e, n, alg == VLONG_PROF_POWMOD_DR ? 1 : 0);
+    TRACE2(powmod__return, alg, ret);
 
     return ret;
 }
@@ -3207,10 +4894,12 @@ int vlong::PowMod(const vlong &a, udig_t e, const vlong &n)
     vlong e2;
 
     e2.na = 1;
+    e2.nu = e ? 1 : 0;
     e2.d = &e;
     int ret = PowMod(a, e2, n);
     e2.d = NULL;
     e2.na = 0;
+    e2.nu = 0;
 
     return ret;
 }
@@ -3278,6 +4967,14 @@ int vlong::PowModSlow(const vlong &a, const vlong &e, const vlong &n)
 //         qp <- q^-1 mod q (must be calculated separately)
 // Output: X  <- a^d (mod n) (RSA plaintext)
 int vlong::PowModCRT(const vlong &a, const vlong &p, const vlong &q, const vlong &dp, const vlong &dq, const vlong &qp)
+{
+    TRACE2(powmodcrt__entry, p.nu, q.nu);
+    int ret = prvPowModCRT(a, p, q, dp, dq, qp);
+    TRACE1(powmodcrt__return, ret);
+    return ret;
+}
+
+int vlong::prvPowModCRT(const vlong &a, const vlong &p, const vlong &q, const vlong &dp, const vlong &dq, const vlong &qp)
 {
     vlong tmp1, t1, t2, *x;
     int ret = VLONG_SUCCESS;
@@ -3296,6 +4993,7 @@ int vlong::PowModCRT(const vlong &a, const vlong &p, const vlong &q, const vlong
     CHECK( x->Sub(t1, t2) );
     CHECK( t1.Mul(*x, qp) );
     CHECK( x->Mod(t1, p) );
+    if (x->s == MP_NEG && x->nu>0) CHECK( x->Add(*x, p) );
 
     // X <- t2 + x*q
     CHECK( t1.Mul(*x, q) );
@@ -3339,6 +5037,7 @@ size_t vlong::prvLSB()
 // based on mp_gcd() of LibTomMath (HAC 14.54)
 int vlong::GCD (const vlong &a, const vlong &b)
 {
+    PROF_SCOPE(VLONG_PROF_GCD);
     int ret = VLONG_SUCCESS;
     size_t u_lsb, v_lsb, k;
     vlong u, v;
@@ -3361,6 +5060,7 @@ int vlong::GCD (const vlong &a, const vlong &b)
 
     while(u.Compare(0) != 0)
     {
+        PROF_COUNT(VLONG_PROF_GCD_STEP);
         CHECK( u.ShiftRight(u,u.prvLSB()) );
         CHECK( v.ShiftRight(v,v.prvLSB()) );
 
@@ -3422,6 +5122,7 @@ int vlong::LCM (const vlong &a, const vlong &b)
 //Y1*a + Y2*b = X, where X <- gcd(a,b), output X, Y1, Y2 (HAC 2.107)
 int vlong::GCDExt (const vlong &a, const vlong &b, vlong *pY1, vlong *pY2)
 {
+    PROF_SCOPE(VLONG_PROF_GCD);
     int ret = VLONG_SUCCESS;
     int swap=0;
 
@@ -3453,6 +5154,7 @@ int vlong::GCDExt (const vlong &a, const vlong &b, vlong *pY1, vlong *pY2)
 
     while (b1.nu > 0)
     {
+        PROF_COUNT(VLONG_PROF_GCD_STEP);
         CHECK( q.Div(*this, b1, &r) );
         CHECK( SetValue(b1) );
         CHECK( b1.SetValue(r) );
@@ -3486,6 +5188,7 @@ int vlong::GCDExt (const vlong &a, const vlong &b, vlong *pY1, vlong *pY2)
 //Y1*a + Y2*b = X, where X <- gcd(a,b), output X, Y1, Y2 (HAC 14.61 / 14.64)
 int vlong::GCDExtBin (const vlong &a, const vlong &b, vlong *pY1, vlong *pY2)
 {
+    PROF_SCOPE(VLONG_PROF_GCD);
     int ret = VLONG_SUCCESS;
     int tg=0;;
     vlong ta, tu, u1, u2, tb, tv, v1, v2;
@@ -3518,11 +5221,12 @@ int vlong::GCDExtBin (const vlong &a, const vlong &b, vlong *pY1, vlong *pY2)
 
     do
     {
+        PROF_COUNT(VLONG_PROF_GCD_STEP);
         while((tu.d[0]&1) == 0)
         {
             CHECK( tu.ShiftRight(tu,1) );
 
-            if((u1.d[0]&1)!=0 || (u2.d[0]&1)!=0)
+            if(MP_ISODD(u1) || MP_ISODD(u2))
             {
                 CHECK( u1.Add(u1, tb) );
                 CHECK( u2.Sub(u2, ta) );
@@ -3536,7 +5240,7 @@ int vlong::GCDExtBin (const vlong &a, const vlong &b, vlong *pY1, vlong *pY2)
         {
             CHECK( tv.ShiftRight(tv, 1) );
 
-            if((v1.d[0]&1)!=0 || (v2.d[0]&1)!=0)
+            if(MP_ISODD(v1) || MP_ISODD(v2))
             {
                 CHECK( v1.Add(v1, tb) );
                 CHECK( v2.Sub(v2, ta) );
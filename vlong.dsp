@@ -95,6 +95,38 @@ SOURCE=.\vlong.cpp
 
 SOURCE=.\vlong_selftest.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=.\BigDecimal.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\DecimalColumn.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\DecimalAccumulator.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\BigDecimal10.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\vlong_bench.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\vlong_kerneltest.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\vlong_pool.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\vlong_batch.cpp
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
@@ -107,6 +139,42 @@ SOURCE=.\vlong.h
 
 SOURCE=.\vlong_selftest.h
 # End Source File
+# Begin Source File
+
+SOURCE=.\BigDecimal.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\DecimalColumn.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\DecimalAccumulator.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\BigDecimal10.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\Decimal.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\vlong_bench.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\vlong_kerneltest.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\vlong_pool.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\vlong_batch_kernel.h
+# End Source File
 # End Group
 # Begin Group "Resource Files"
 
@@ -44,6 +44,7 @@
 #ifndef _VLONG_H_INCLUDED_
 #define _VLONG_H_INCLUDED_
 
+#include <stdio.h>
 #include <algorithm>
 
 //Configuration
@@ -53,12 +54,73 @@
 //Cutoff number of digits for Karatsuba multiply
 #define VLONG_KARATSUBA_MUL_CUTOFF  80
 
+//Cutoff number of digits (of both divisor and quotient) for division
+//by a Newton reciprocal instead of schoolbook division
+//(only reachable if VLONG_MAX_DIGITS is large enough)
+#define VLONG_NEWTON_DIV_CUTOFF     1000
+
+//Cutoff number of digits (of both factors) for PowModParallel() to compute
+//the half products of a Karatsuba multiplication on separate threads
+#define VLONG_PARALLEL_MUL_CUTOFF   256
+
+//Cutoff number of digits for additions, subtractions, shifts and comparisons
+//to run in chunks on separate threads (on the executor of PowModParallel() or
+//the default thread pool; only reachable if VLONG_MAX_DIGITS is large enough)
+#define VLONG_PARALLEL_LINEAR_CUTOFF  (1 << 18)
+
+//Cutoff number of digits for conversion to radixes other than 16 by
+//splitting at powers of the radix instead of one division per character
+#define VLONG_RADIX_DC_CUTOFF       16
+
+//Cutoff number of digits (of the powers split at) for conversion to and from
+//radixes other than 16 to run the two halves of a split on separate threads
+//(on the executor of PowModParallel() or the default thread pool; only
+//reachable if VLONG_MAX_DIGITS is large enough). Parsing splits only there,
+//below one multiply-add pass per digit of characters is faster
+#define VLONG_PARALLEL_RADIX_CUTOFF  4096
+
+//Cutoff number of digits (of both factors) for multiplication by number
+//theoretic transforms (only reachable if VLONG_MAX_DIGITS is large enough)
+#define VLONG_NTT_MUL_CUTOFF        2048
+
+//Cutoff number of digits for digit buffers (and the transforms of the NTT
+//multiplication) to be mapped pages with huge page hints instead of new[],
+//or pages of temporary files after vlong::SetMapDir() (not on Windows; only
+//reachable if VLONG_MAX_DIGITS is large enough)
+#define VLONG_MAP_DIGITS            (1 << 20)
+
 //Enable diminished radix reduction
 #define VLONG_USE_DR_REDUCE
 
 //Enable Montgomery reduction
 #define VLONG_USE_MONTGOMRTY
 
+//Count operations per thread at each algorithm dispatch point
+//(see vlong::ProfileSnapshot())
+//#define VLONG_PROFILE
+
+//Also measure the time spent in each profiled operation
+//(two clock reads per operation, implies VLONG_PROFILE)
+//#define VLONG_PROFILE_TIMERS
+
+//Also count the operand sizes reaching Mul, Div, Mod and PowMod in histograms
+//with four buckets per doubling (implies VLONG_PROFILE)
+//#define VLONG_PROFILE_SIZES
+
+//Compile SystemTap/USDT probes (<sys/sdt.h>) into PowMod, PowModCRT, Div, Mod,
+//Mul, IsPrime and Grow for bpftrace and perf (probe list in README.md)
+//#define VLONG_USDT
+
+//Keep freed digit buffers in power-of-two size classes for reuse, a few per
+//thread and the rest on lock-free lists shared by all threads, so that numbers
+//created in one thread and destroyed in another do not reach new[]/delete[]
+//(see vlong::PoolTrim())
+//#define VLONG_POOL
+
+#if (defined(VLONG_PROFILE_TIMERS) || defined(VLONG_PROFILE_SIZES)) && !defined(VLONG_PROFILE)
+#define VLONG_PROFILE
+#endif
+
 //Setting up the carried digits
 //#define VLONG_8BIT
 //#define VLONG_16BIT
@@ -116,11 +178,72 @@ typedef unsigned long      uwrd_t;
 #define VLONG_ERR_DIV_BY_ZERO      26
 #define VLONG_ERR_NEGATIVE_ARG     27
 #define VLONG_ERR_NO_INVERSE       28
+#define VLONG_ERR_BUSY             29
 #define VLONG_ERR_UNEXPECTED       100
 #define VLONG_ERR_NOT_IMPLEMENTED  101
 
 #define VLONG_WRN_INSECURE_RNG     200
 
+//Profiled operations, the algorithm tier is a separate entry
+enum
+{
+    VLONG_PROF_MUL_BASELINE,       //O(N^2) multiplication
+    VLONG_PROF_MUL_KARATSUBA,
+    VLONG_PROF_SQR_BASELINE,       //multiplication of a number by itself
+    VLONG_PROF_SQR_KARATSUBA,
+    VLONG_PROF_DIV_DIGIT,          //division by a single digit
+    VLONG_PROF_DIV_SCHOOLBOOK,
+    VLONG_PROF_DIV_NEWTON,
+    VLONG_PROF_REDUCE_BARRETT,
+    VLONG_PROF_REDUCE_DR,
+    VLONG_PROF_REDUCE_MONTGOMERY,
+    VLONG_PROF_POWMOD_BARRETT,
+    VLONG_PROF_POWMOD_DR,
+    VLONG_PROF_POWMOD_MONTGOMERY,
+    VLONG_PROF_GCD,                //GCD, GCDExt and GCDExtBin
+    VLONG_PROF_GCD_STEP,           //iterations of the GCD loops (counted only)
+    VLONG_PROF_MILLER_RABIN,       //rounds of the primarity test
+    VLONG_PROF_MUL_NTT,            //multiplication (and squaring) by transforms
+    VLONG_PROF_OPS
+};
+
+//Operand size histograms
+enum
+{
+    VLONG_SIZES_MUL,               //digits of the smaller factor (selects Karatsuba)
+    VLONG_SIZES_SQR,               //digits of a number multiplied by itself
+    VLONG_SIZES_DIV,               //digits of the divisor of Div
+    VLONG_SIZES_MOD,               //digits of the divisor of Mod
+    VLONG_SIZES_QUOTIENT,          //digits of the quotient of Div and Mod (selects Newton with the divisor)
+    VLONG_SIZES_POWMOD,            //digits of the modulus of PowMod
+    VLONG_SIZES_POWMOD_EXP,        //bits of the exponent of PowMod (selects the window size)
+    VLONG_SIZES_OPS
+};
+
+//Sizes 0 to 3 have a bucket each, then every doubling is split into four
+//buckets; sizes of 2^17 and more share the last one
+#define VLONG_SIZE_BUCKETS 64
+
+#if defined(_MSC_VER)
+    typedef unsigned __int64   vlong_prof_t;
+#else
+    typedef unsigned long long vlong_prof_t;
+#endif
+
+//Operation counters of one thread
+struct vlong_profile
+{
+    vlong_prof_t count[VLONG_PROF_OPS];  //Number of calls
+    vlong_prof_t nanos[VLONG_PROF_OPS];  //Time in nanoseconds, including nested operations
+                                         //(zero unless VLONG_PROFILE_TIMERS is defined)
+    vlong_prof_t sizes[VLONG_SIZES_OPS][VLONG_SIZE_BUCKETS];  //Operand size histograms
+                                         //(zero unless VLONG_PROFILE_SIZES is defined)
+};
+
+class vlong_future;
+class vlong_executor;
+struct vlong_radix;
+
 // The class organized as follows
 
 class vlong
@@ -154,12 +277,23 @@ public:
     // Get least significant digit (unsigned)
 	udig_t GetInt() const;
 
+	// Number of used digits and a single digit of the magnitude (least significant first)
+	size_t GetNumDigits() const { return nu; }
+	udig_t GetDigit(size_t i) const { return i<nu ? d[i] : 0; }
+
 	// Set value to a single digit integer
     int SetValue(sdig_t v);
 
 	// Set value to be equal to another number
     int SetValue(const vlong &v) {return Copy(v);}
 
+	// Set value to a signed double digit (word) integer
+    int SetWord(swrd_t v);
+
+	// Get value as a signed double digit (word) integer
+	// Returns VLONG_ERR_OUT_OF_RANGE if the number does not fit
+    int GetWord(swrd_t *v) const;
+
 	// Swap contents of two vlong objects
 	// Faster then copying because it doesn't require
 	// memory copy operation. Just swaps pointers
@@ -180,6 +314,10 @@ public:
     // Convert from unsigned big-endian binary number
     int FromBinary(const char *szNumber, size_t buflen);
 
+    // Convert from signed little-endian two's complement number of buflen bytes
+    // (e.g. Arrow and Parquet decimal128/decimal256 values)
+    int FromTwosComplementLE(const char *buf, size_t buflen);
+
     //****************** Export a number to various formats ********************************
     // Convert to string of 2<=radix<=16
     // or you can supply a custom character alphabet to convert
@@ -198,6 +336,10 @@ public:
     // Convert unsigned part of the vlong number to big-endian binary buffer
     int ToBinary(char *buf, size_t buflen) const;
 
+    // Convert to signed little-endian two's complement number filling buflen bytes
+    // Returns VLONG_ERR_BUFFER_SMALL if the number does not fit
+    int ToTwosComplementLE(char *buf, size_t buflen) const;
+
     //******************************* Comparisons ******************************************
 	// Compare this object to either a a small signed number or to a vlong integer. [BNM pp.50 Algorithm 3.10]
 	// Results are usual {-1,0,1} for {X<v, X==v, X>v} results.
@@ -208,6 +350,9 @@ public:
 	// Results are usual {-1,0,1} for {|a|<|b|, |a|==|b|, |a|>|b|} results.
 	static int CompareMag(const vlong &a, const vlong &b);
 
+	// Compare |a|*b to |c| without computing the product (nothing is allocated)
+	static int CompareMagMul(const vlong &a, udig_t b, const vlong &c);
+
     //*************************** Bitwise operations ***************************************
     // Returns count of number of bits in the vlong integer
     size_t GetNumBits() const;
@@ -219,6 +364,7 @@ public:
     size_t GetNumMSB() const;
 
 	// Shift right by a specified number of digits
+	// (bits is an int, huge numbers are shifted by 2^31 bits or more in steps)
     int ShiftRight(const vlong &a, int bits);
 
 	// Shift left by a specified number of digits
@@ -254,6 +400,10 @@ public:
     int Div(const vlong &a, sdig_t b, sdig_t *r=NULL);
     int Mod(const vlong &a, sdig_t b);
 
+    //X <- a * b + c  [X refers to caller object]
+    //Single pass over the digits of a (used to accumulate numbers chunk by chunk)
+    int MulAdd(const vlong &a, udig_t b, udig_t c);
+
     //Return reminder of a/b. This function has different name, because
     //it does not affect the value of caller object (as Mod() does).
     sdig_t ModDig(const vlong &a, sdig_t b) const;
@@ -287,6 +437,9 @@ public:
     //Computes X such as X^b <= n < (X+1)^n (integer n'th root of a) [X refers to caller object]
     int Root(const vlong &a, udig_t n);
 
+    //Computes X such as X^2 <= a < (X+1)^2 (integer square root of a) [X refers to caller object]
+    int Sqrt(const vlong &a);
+
     //*************************** Modular arithmetic ***************************************
     //X <- a * b mod n  [X refers to caller object]
     int MulMod(const vlong &a, const vlong &b, const vlong &n);
@@ -313,6 +466,35 @@ public:
     // Output: X  <- a^d (mod n) (RSA plaintext)
     int PowModCRT(const vlong &a, const vlong &p, const vlong &q, const vlong &dp, const vlong &dq, const vlong &qp);
 
+    //X[i] <- a[i]^e[i] (mod n[i]) for count independent operations. Odd moduli of
+    //similar size are exponentiated side by side in AVX2 or AVX-512 lanes where the
+    //CPU has them, everything else one by one with PowMod(). x[i] may be a[i] but
+    //no other input. Returns the first error
+    static int PowModBatch(vlong *x, const vlong *a, const vlong *e, const vlong *n, size_t count);
+
+    //Operations PowModBatch() runs side by side on this CPU, 1 without SIMD kernels
+    static int PowModBatchLanes();
+
+    //PowMod() and PowModCRT() on an executor, the default thread pool if ex is NULL
+    //(see vlong_pool.h). The operands are copied; X must stay alive and unused
+    //until f.Wait() returns the result code. VLONG_ERR_BUSY if f is still pending
+    int PowModAsync(const vlong &a, const vlong &e, const vlong &n, vlong_future &f, vlong_executor *ex = NULL);
+    int PowModCRTAsync(const vlong &a, const vlong &p, const vlong &q, const vlong &dp, const vlong &dq, const vlong &qp,
+                       vlong_future &f, vlong_executor *ex = NULL);
+
+    //X <- a^e (mod n) for a single large operation (moduli of thousands of bits)
+    //on the threads of an executor, the default thread pool if ex is NULL.
+    //Multiplications of at least VLONG_PARALLEL_MUL_CUTOFF digits compute the
+    //three half products of Karatsuba's method on separate threads
+    int PowModParallel(const vlong &a, const vlong &e, const vlong &n, vlong_executor *ex = NULL);
+
+    //Fixed-base exponentiation (e.g. with a Diffie-Hellman generator): PowModBases()
+    //computes bases[j] <- a^(2^(j*m)) (mod n) for j < count once, PowModParallel()
+    //cuts an exponent below 2^(count*m) into count segments of m bits, raises the
+    //bases to them on separate threads and multiplies the results
+    static int PowModBases(vlong *bases, size_t count, size_t m, const vlong &a, const vlong &n);
+    int PowModParallel(const vlong *bases, size_t count, size_t m, const vlong &e, const vlong &n, vlong_executor *ex = NULL);
+
     //X <- gcd(|a|, |b|) Greatest common divisor  [X refers to caller object]
     int GCD (const vlong &a, const vlong &b);
 
@@ -327,6 +509,44 @@ public:
     //X <- lcm(|a|, |b|) Least common multiple  [X refers to caller object]
     int LCM (const vlong &a, const vlong &b);
 
+    //******************************** Profiling *******************************************
+    //Copy the operation counters of the calling thread. The difference of two
+    //snapshots taken around a call (e.g. PowMod() or IsPrime()) shows how many
+    //multiplications, reductions and divisions of each kind it performed.
+    //Returns VLONG_ERR_NOT_IMPLEMENTED (and zero counters) unless VLONG_PROFILE is defined
+    static int ProfileSnapshot(vlong_profile *p);
+
+    //Zero the operation counters of the calling thread
+    static int ProfileReset();
+
+    //Name of a profiled operation (e.g. "mul_karatsuba"), NULL if op is out of range
+    static const char *ProfileName(int op);
+
+    //Name of an operand size histogram (e.g. "quotient"), NULL if op is out of range
+    static const char *ProfileSizesName(int op);
+
+    //Histogram bucket of an operand size, and the smallest size counted in a bucket
+    static int ProfileSizeBucket(size_t n);
+    static size_t ProfileBucketSize(int bucket);
+
+    //Write the non-empty buckets of the size histograms of p as lines of
+    //"<histogram> <smallest size> <largest size> <count>" (e.g. summed over the
+    //snapshots of several threads), so that cutoffs can be chosen from them
+    static int ProfileDumpSizes(const vlong_profile *p, FILE *f);
+
+    //******************************** Buffer pool *****************************************
+    //Free the digit buffers kept for reuse by VLONG_POOL on the shared lists and
+    //in the cache of the calling thread (e.g. after a burst of large numbers).
+    //Returns VLONG_ERR_NOT_IMPLEMENTED unless VLONG_POOL is defined
+    static int PoolTrim();
+
+    //Map the digit buffers of VLONG_MAP_DIGITS and more (and the transforms of
+    //the NTT multiplication) from unlinked temporary files in szDir, so that
+    //numbers larger than RAM are paged to disk; NULL for in-RAM pages again.
+    //Call it before numbers are created on other threads. Returns
+    //VLONG_ERR_NOT_IMPLEMENTED on Windows
+    static int SetMapDir(const char *szDir);
+
     //******************************** Operators *******************************************
 	// Commented out as this could be dangerous conversion in various compilers
     //operator const char*() {return ToString(16);}
@@ -375,6 +595,9 @@ public:
     const vlong operator / (const vlong &b) const {vlong t;t.Div(*this,b,NULL); return t;}
 
 private:
+    //Differential tests call the kernels directly (vlong_kerneltest.cpp)
+    friend struct vlong_kernels;
+
     //Memory Management
     void Init();
     int Clear();
@@ -398,15 +621,56 @@ private:
     //Fast Karatsuba multiplication O(N^1.584) (used for long numbers only)
     int prvMulKaratsuba(const vlong &a, const vlong &b);
 
+    //r[i] <- a[i] * b[i] for i < 3, two of them on ex (see PowModParallel()), and
+    //the executor splitting the multiplications of the calling thread, if any
+    static int prvMulParallel(vlong_executor *ex, vlong *r[3], const vlong *a[3], const vlong *b[3]);
+    static vlong_executor *prvParallelExecutor();
+
+    //Chunks (at most 64, one per CPU) for a pass over n digits on separate threads,
+    //1 if it should run on the calling thread. prvParallelFor() runs
+    //body(ctx, i, lo, hi) for the chunks i of [0, n) and waits for them
+    static size_t prvParallelChunks(size_t n);
+    static void prvParallelFor(size_t n, size_t chunks, void (*body)(void *, size_t, size_t, size_t), void *ctx);
+
+    //ShiftLeft() (bits > 0) and ShiftRight() (bits < 0) of a huge number in chunks
+    int prvShiftParallel(const vlong &a, int bits, size_t chunks);
+
+    //CompareMag() of the n digits at a and b in chunks
+    static int prvCompareParallel(const udig_t *a, const udig_t *b, size_t n, size_t chunks);
+
+    //c <- a + b or a - b over the na digits of a (nb <= na) in chunks, returns the carry (borrow)
+    static udig_t prvAddSubParallel(udig_t *c, const udig_t *a, size_t na, const udig_t *b, size_t nb, bool sub, size_t chunks);
+
+    //Non-negative number from the len characters at p one digit-sized chunk at a time
+    int prvFromChars(const char *p, size_t len, size_t rd, const char *pAlphabet);
+
+    //Radix conversion split at the powers rc.pw[k] = radix^(m*2^k): the number from
+    //len characters, the m*2^k characters of a number < rc.pw[k] (zero padded)
+    int prvFromCharsDC(const char *p, size_t len, const vlong_radix &rc);
+    int prvToCharsDC(char *p, int k, const vlong_radix &rc) const;
+    static void prvRadixHalves(void *ctx, size_t i, size_t lo, size_t hi);
+
+    //Multiplication by number theoretic transforms O(N log N) (used for huge numbers only)
+    int prvMulNTT(const vlong &a, const vlong &b);
+
     //Baseline O(N^2) multiplication
     int prvMulBaseline(const vlong &a, const vlong &b, size_t ndigs);
 
     static int prvDivInt(const vlong &a,       udig_t b, vlong *q=NULL, udig_t *r=NULL);
     static int prvDivBig(const vlong &a, const vlong &b, vlong *q=NULL,  vlong *r=NULL);
 
+    //Division using a reciprocal computed by Newton iteration, O(M(N))
+    static bool prvIsNewtonDiv(const vlong &a, const vlong &b);
+    static int prvDivNewton(const vlong &a, const vlong &b, vlong *q=NULL,  vlong *r=NULL);
+    //X <- floor(2**(2*n) / b), where b has exactly n bits
+    int prvReciprocal(const vlong &b, size_t n);
+
     //Multiply by a digit
     int prvMulDig(const vlong &a, udig_t b);
 
+    //Multiply magnitude by a digit and add a digit: X <- |a| * b + c
+    int prvMulAddDig(const vlong &a, udig_t b, udig_t c);
+
     static int prvIsPow2(udig_t b, size_t *nbits);
     int prvModPow2(const vlong &a, size_t bits);
     int prvDivPow2(const vlong &a, size_t bits, vlong *r);
@@ -414,6 +678,7 @@ private:
     //X <- a^e (mod n)
     int prvPowModBarrett(const vlong &a, const vlong &e, const vlong &n, int redmode);
     int prvPowModMontgomery(const vlong &a, const vlong &e, const vlong &n);
+    int prvPowModCRT(const vlong &a, const vlong &p, const vlong &q, const vlong &dp, const vlong &dq, const vlong &qp);
 
     //Reduction
     // computes a = 2**b
@@ -435,6 +700,7 @@ private:
 
     //Primarity tests
     static int prvIsMillerRabinPrime(const vlong &a, const vlong &b, bool &bPrime);
+    bool prvIsPrime();
 
     size_t prvLSB();
 
@@ -0,0 +1,327 @@
+/* 
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org/>
+ */
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "vlong.h"
+
+// Batched modular exponentiation: independent operations of similar size run
+// side by side in the lanes of AVX2 (4) or AVX-512 (8) registers. The kernels
+// need GCC's target pragmas and are selected at run time from the CPU features;
+// other compilers and CPUs (or VLONG_NO_SIMD) run the operations one by one.
+#if !defined(VLONG_NO_SIMD) && defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_X86
+#include <immintrin.h>
+#endif
+
+typedef unsigned long long batch_limb;
+
+#define BATCH_LIMB_BITS   26
+#define BATCH_LIMB_MASK   ((((batch_limb) 1) << BATCH_LIMB_BITS) - 1)
+#define BATCH_WINDOW      4
+
+// Largest modulus; a column of a Montgomery product sums 2k products of two
+// limbs, which must stay below 2^64
+#define BATCH_MAX_BITS    16384
+
+// One group of operations in limb-sliced form (limb j of lane l at j*lanes+l):
+// x <- a^e mod n for a in Montgomery form, with one = R mod n, n0 = -1/n mod
+// 2^BATCH_LIMB_BITS and the exponent windows in digits. Buffers are aligned to
+// 64 bytes, work holds (2^BATCH_WINDOW + 6)*k*lanes limbs
+typedef void (*batch_run_f)(batch_limb *x, const batch_limb *a, const batch_limb *one, const batch_limb *n,
+                            const batch_limb *n0, size_t k, const batch_limb *digits, size_t windows, batch_limb *work);
+
+#ifdef BATCH_X86
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace batch_avx2
+{
+    enum { LANES = 4 };
+    typedef __m256i V;
+
+    static inline V Zero() { return _mm256_setzero_si256(); }
+    static inline V Set1(batch_limb x) { return _mm256_set1_epi64x((long long) x); }
+    static inline V Load(const batch_limb *p) { return _mm256_loadu_si256((const __m256i *) p); }
+    static inline V Add(V a, V b) { return _mm256_add_epi64(a, b); }
+    static inline V Mul(V a, V b) { return _mm256_mul_epu32(a, b); }
+    static inline V Srl(V a) { return _mm256_srli_epi64(a, BATCH_LIMB_BITS); }
+    static inline V And(V a, V b) { return _mm256_and_si256(a, b); }
+    static inline V Select(V idx, batch_limb i, V a, V b) { return _mm256_blendv_epi8(b, a, _mm256_cmpeq_epi64(idx, Set1(i))); }
+
+#include "vlong_batch_kernel.h"
+
+    static void Run(batch_limb *x, const batch_limb *a, const batch_limb *one, const batch_limb *n,
+                    const batch_limb *n0, size_t k, const batch_limb *digits, size_t windows, batch_limb *work)
+    {
+        V *unit = (V *) work, *t = unit + k;
+        for (size_t j=0; j<k; j++)
+            unit[j] = Set1(j == 0 ? 1 : 0);
+        PowModMont((V *) x, (const V *) a, (const V *) one, (const V *) n, Load(n0), k, digits, windows, t + 2*k);
+        MontMul((V *) x, (V *) x, unit, (const V *) n, Load(n0), k, t);
+    }
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+namespace batch_avx512
+{
+    enum { LANES = 8 };
+    typedef __m512i V;
+
+    static inline V Zero() { return _mm512_setzero_si512(); }
+    static inline V Set1(batch_limb x) { return _mm512_set1_epi64((long long) x); }
+    static inline V Load(const batch_limb *p) { return _mm512_loadu_si512((const void *) p); }
+    static inline V Add(V a, V b) { return _mm512_add_epi64(a, b); }
+    // zero-masked forms, the unmasked ones trip -Wmaybe-uninitialized in GCC's headers
+    static inline V Mul(V a, V b) { return _mm512_maskz_mul_epu32((__mmask8) 0xFF, a, b); }
+    static inline V Srl(V a) { return _mm512_maskz_srli_epi64((__mmask8) 0xFF, a, BATCH_LIMB_BITS); }
+    static inline V And(V a, V b) { return _mm512_and_si512(a, b); }
+    static inline V Select(V idx, batch_limb i, V a, V b) { return _mm512_mask_blend_epi64(_mm512_cmpeq_epi64_mask(idx, Set1(i)), b, a); }
+
+#include "vlong_batch_kernel.h"
+
+    static void Run(batch_limb *x, const batch_limb *a, const batch_limb *one, const batch_limb *n,
+                    const batch_limb *n0, size_t k, const batch_limb *digits, size_t windows, batch_limb *work)
+    {
+        V *unit = (V *) work, *t = unit + k;
+        for (size_t j=0; j<k; j++)
+            unit[j] = Set1(j == 0 ? 1 : 0);
+        PowModMont((V *) x, (const V *) a, (const V *) one, (const V *) n, Load(n0), k, digits, windows, t + 2*k);
+        MontMul((V *) x, (V *) x, unit, (const V *) n, Load(n0), k, t);
+    }
+}
+#pragma GCC pop_options
+
+#endif //BATCH_X86
+
+// Lanes of the widest kernel the CPU supports, 1 if none
+static size_t batch_select(batch_run_f *run)
+{
+#ifdef BATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        *run = batch_avx512::Run;
+        return batch_avx512::LANES;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        *run = batch_avx2::Run;
+        return batch_avx2::LANES;
+    }
+#endif
+    *run = NULL;
+    return 1;
+}
+
+// Limbs of 0 <= v < 2^(BATCH_LIMB_BITS*k) into one lane
+static int batch_to_limbs(const vlong &v, batch_limb *out, size_t k, size_t lane, size_t lanes, std::vector<unsigned char> &buf)
+{
+    int ret;
+    buf.assign((k*BATCH_LIMB_BITS + 7)/8 + 1, 0);
+    if ((ret = v.ToTwosComplementLE((char *) &buf[0], buf.size())) != VLONG_SUCCESS)
+        return ret;
+
+    batch_limb acc = 0;
+    size_t pos = 0;
+    int have = 0;
+    for (size_t j=0; j<k; j++)
+    {
+        while (have < BATCH_LIMB_BITS)
+        {
+            acc |= (batch_limb) buf[pos++] << have;
+            have += 8;
+        }
+        out[j*lanes + lane] = acc & BATCH_LIMB_MASK;
+        acc >>= BATCH_LIMB_BITS;
+        have -= BATCH_LIMB_BITS;
+    }
+    return VLONG_SUCCESS;
+}
+
+static int batch_from_limbs(vlong &v, const batch_limb *in, size_t k, size_t lane, size_t lanes, std::vector<unsigned char> &buf)
+{
+    buf.assign((k*BATCH_LIMB_BITS + 7)/8 + 1, 0);
+
+    batch_limb acc = 0;
+    size_t pos = 0;
+    int have = 0;
+    for (size_t j=0; j<k; j++)
+    {
+        acc |= in[j*lanes + lane] << have;
+        for (have += BATCH_LIMB_BITS; have >= 8; have -= 8)
+        {
+            buf[pos++] = (unsigned char) acc;
+            acc >>= 8;
+        }
+    }
+    if (have > 0)
+        buf[pos] = (unsigned char) acc;
+    return v.FromTwosComplementLE((const char *) &buf[0], buf.size());
+}
+
+// -1/n mod 2^BATCH_LIMB_BITS for odd n by Newton's iteration (3, 6, 12, 24, 48 bits)
+static batch_limb batch_n0(batch_limb n)
+{
+    batch_limb x = n;
+    for (int i=0; i<4; i++)
+        x *= 2 - n*x;
+    return (0 - x) & BATCH_LIMB_MASK;
+}
+
+// A group of up to "lanes" operations whose moduli have k limbs, unused lanes
+// repeat the first operation
+static int batch_group(vlong *x, const vlong *a, const vlong *e, const vlong *n, const size_t *idx, size_t used,
+                       size_t lanes, size_t k, batch_run_f run)
+{
+    const size_t entries = (size_t) 1 << BATCH_WINDOW;
+    size_t l, i, w, windows = 1;
+    int ret;
+
+    for (l=0; l<used; l++)
+        windows = std::max(windows, (e[idx[l]].GetNumBits() + BATCH_WINDOW - 1) / BATCH_WINDOW);
+
+    // x, a, one and n, then n0, the exponent windows and the work area, 64-byte aligned
+    size_t vec = k*lanes, total = 4*vec + lanes + windows*lanes + (entries + 6)*vec;
+    std::vector<batch_limb> mem(total + 8);
+    batch_limb *base = &mem[0];
+    while (((size_t) base) % 64 != 0)
+        base++;
+    batch_limb *xs = base, *as = xs + vec, *ones = as + vec, *ns = ones + vec, *n0 = ns + vec;
+    batch_limb *digits = n0 + lanes, *work = digits + windows*lanes;
+
+    std::vector<unsigned char> buf;
+    vlong t;
+    for (l=0; l<lanes; l++)
+    {
+        i = idx[l < used ? l : 0];
+
+        // a*R mod n and R mod n with R = 2^(BATCH_LIMB_BITS*k)
+        if ((ret = t.Mod(a[i], n[i])) != VLONG_SUCCESS) return ret;
+        if (t.GetSign() < 0 && !t.isZero() && (ret = t.Add(t, n[i])) != VLONG_SUCCESS) return ret;
+        if ((ret = t.ShiftLeft(t, (int) (k*BATCH_LIMB_BITS))) != VLONG_SUCCESS) return ret;
+        if ((ret = t.Mod(t, n[i])) != VLONG_SUCCESS) return ret;
+        if ((ret = batch_to_limbs(t, as, k, l, lanes, buf)) != VLONG_SUCCESS) return ret;
+
+        if ((ret = t.SetValue(1)) != VLONG_SUCCESS) return ret;
+        if ((ret = t.ShiftLeft(t, (int) (k*BATCH_LIMB_BITS))) != VLONG_SUCCESS) return ret;
+        if ((ret = t.Mod(t, n[i])) != VLONG_SUCCESS) return ret;
+        if ((ret = batch_to_limbs(t, ones, k, l, lanes, buf)) != VLONG_SUCCESS) return ret;
+
+        if ((ret = batch_to_limbs(n[i], ns, k, l, lanes, buf)) != VLONG_SUCCESS) return ret;
+        n0[l] = batch_n0(ns[l]);
+
+        // windows from the most significant, bits above the exponent are zero
+        if ((ret = t.Copy(e[i])) != VLONG_SUCCESS) return ret;
+        size_t ebits = t.GetNumBits();
+        for (w=0; w<windows; w++)
+        {
+            size_t bit = (windows - 1 - w) * BATCH_WINDOW;
+            batch_limb v = 0;
+            for (int b=BATCH_WINDOW-1; b>=0; b--)
+                v = (v << 1) | (bit + b < ebits ? (batch_limb) t.GetBit(bit + b) : 0);
+            digits[w*lanes + l] = v;
+        }
+    }
+
+    run(xs, as, ones, ns, n0, k, digits, windows, work);
+
+    // the result is at most n, n itself stands for 0
+    for (l=0; l<used; l++)
+    {
+        i = idx[l];
+        if ((ret = batch_from_limbs(x[i], xs, k, l, lanes, buf)) != VLONG_SUCCESS) return ret;
+        if (vlong::CompareMag(x[i], n[i]) >= 0 && (ret = x[i].Sub(x[i], n[i])) != VLONG_SUCCESS) return ret;
+    }
+    return VLONG_SUCCESS;
+}
+
+int vlong::PowModBatchLanes()
+{
+    batch_run_f run;
+    return (int) batch_select(&run);
+}
+
+int vlong::PowModBatch(vlong *x, const vlong *a, const vlong *e, const vlong *n, size_t count)
+{
+    if (x == NULL) return VLONG_ERR_BAD_ARG_1;
+    if (a == NULL) return VLONG_ERR_BAD_ARG_2;
+    if (e == NULL) return VLONG_ERR_BAD_ARG_3;
+    if (n == NULL) return VLONG_ERR_BAD_ARG_4;
+
+    batch_run_f run;
+    const size_t lanes = batch_select(&run);
+#ifdef VLONG_MAX_DIGITS
+    const size_t capacity = (size_t) VLONG_MAX_DIGITS * sizeof(udig_t) * 8;
+#else
+    const size_t capacity = (size_t) -1;
+#endif
+    std::vector<std::pair<size_t, size_t> > simd;     // limbs and index
+    std::vector<size_t> single;
+    size_t i, j;
+    int ret = VLONG_SUCCESS, r;
+
+    // Odd moduli with a non-negative exponent go to the lanes, a*R needs room
+    // for the bits of a and of R
+    for (i=0; i<count; i++)
+    {
+        size_t bits = n[i].GetNumBits(), k = (bits + 2 + BATCH_LIMB_BITS - 1) / BATCH_LIMB_BITS;
+        bool lane = lanes > 1 && n[i].GetSign() > 0 && (n[i].GetDigit(0) & 1) == 1 && bits > 1 &&
+            bits <= BATCH_MAX_BITS && (e[i].GetSign() >= 0 || e[i].isZero()) && bits + k*BATCH_LIMB_BITS + 2*sizeof(udig_t)*8 <= capacity;
+        if (lane)
+            simd.push_back(std::make_pair(k, i));
+        else
+            single.push_back(i);
+    }
+
+    // Groups of equal limb counts, a group of one is faster on its own
+    std::sort(simd.begin(), simd.end());
+    for (i=0; i<simd.size(); i=j)
+    {
+        std::vector<size_t> idx;
+        for (j=i; j<simd.size() && j<i+lanes && simd[j].first == simd[i].first; j++)
+            idx.push_back(simd[j].second);
+        if (idx.size() == 1)
+        {
+            single.push_back(idx[0]);
+            continue;
+        }
+        r = batch_group(x, a, e, n, &idx[0], idx.size(), lanes, simd[i].first, run);
+        if (r != VLONG_SUCCESS && ret == VLONG_SUCCESS)
+            ret = r;
+    }
+
+    for (i=0; i<single.size(); i++)
+    {
+        r = x[single[i]].PowMod(a[single[i]], e[single[i]], n[single[i]]);
+        if (r != VLONG_SUCCESS && ret == VLONG_SUCCESS)
+            ret = r;
+    }
+    return ret;
+}
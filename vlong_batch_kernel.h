@@ -0,0 +1,107 @@
+/* 
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org/>
+ */
+
+// Batched Montgomery exponentiation kernels, included by vlong_batch.cpp once
+// per instruction set. The including file defines the vector type V holding
+// LANES 64-bit lanes and the lane operations Zero, Set1, Add, Mul (product of
+// the low 32 bits of each lane), Srl (shift right by BATCH_LIMB_BITS), And and
+// Select (lanes of a where idx equals i, otherwise lanes of b).
+//
+// Numbers are limb-sliced: limb j of all operations is one vector, limbs have
+// BATCH_LIMB_BITS bits in 64-bit lanes, so sums of up to 2^11 products fit
+// without carries and a Montgomery product needs no carry propagation until
+// its end.
+
+// r <- a*b/R mod n with R = 2^(BATCH_LIMB_BITS*k) > 4n. For a, b < 2n the result
+// is below 2n (not fully reduced), so products can be chained. r may be a or b,
+// t is scratch of 2k vectors
+static void MontMul(V *r, const V *a, const V *b, const V *n, V n0, size_t k, V *t)
+{
+    const V mask = Set1(BATCH_LIMB_MASK);
+    size_t i, j;
+
+    for (j=0; j<2*k; j++)
+        t[j] = Zero();
+
+    for (i=0; i<k; i++)
+    {
+        // t <- (t + a[i]*b + m*n) / 2^BATCH_LIMB_BITS, m chosen so that the division is exact
+        V ai = a[i];
+        V t0 = Add(t[i], Mul(ai, b[0]));
+        V m = And(Mul(t0, n0), mask);
+        t0 = Add(t0, Mul(m, n[0]));
+        for (j=1; j<k; j++)
+            t[i+j] = Add(t[i+j], Add(Mul(ai, b[j]), Mul(m, n[j])));
+        t[i+1] = Add(t[i+1], Srl(t0));
+    }
+
+    V c = Zero();
+    for (j=0; j<k; j++)
+    {
+        V v = Add(t[k+j], c);
+        r[j] = And(v, mask);
+        c = Srl(v);
+    }
+}
+
+// x <- a^e/R^(e-1) mod n (Montgomery form in and out, x < 2n) with fixed windows
+// of BATCH_WINDOW bits. digits holds the windows of all exponents, the most
+// significant first, LANES per window. Every window reads all table entries,
+// so the memory access pattern does not depend on the exponents.
+// work has (2^BATCH_WINDOW + 3)*k vectors
+static void PowModMont(V *x, const V *a, const V *one, const V *n, V n0, size_t k,
+                       const batch_limb *digits, size_t windows, V *work)
+{
+    const size_t entries = (size_t) 1 << BATCH_WINDOW;
+    V *tbl = work, *sel = tbl + entries*k, *t = sel + k;
+    size_t i, j, w;
+
+    for (j=0; j<k; j++)
+    {
+        tbl[j] = one[j];
+        tbl[k+j] = a[j];
+    }
+    for (i=2; i<entries; i++)
+        MontMul(tbl + i*k, tbl + (i-1)*k, a, n, n0, k, t);
+
+    for (j=0; j<k; j++)
+        x[j] = one[j];
+    for (w=0; w<windows; w++)
+    {
+        if (w > 0)
+            for (i=0; i<BATCH_WINDOW; i++)
+                MontMul(x, x, x, n, n0, k, t);
+
+        V idx = Load(digits + w*LANES);
+        for (j=0; j<k; j++)
+            sel[j] = tbl[j];
+        for (i=1; i<entries; i++)
+            for (j=0; j<k; j++)
+                sel[j] = Select(idx, (batch_limb) i, tbl[i*k+j], sel[j]);
+        MontMul(x, x, sel, n, n0, k, t);
+    }
+}
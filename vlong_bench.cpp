@@ -0,0 +1,1388 @@
+/* 
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org/>
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "vlong.h"
+#include "BigDecimal.h"
+#include "DecimalAccumulator.h"
+#include "vlong_bench.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#ifdef __linux__
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+//------------------------------------------------------------------------------------------------------
+
+// Monotonic time in seconds where available
+static double bench_time()
+{
+#ifdef WIN32
+    LARGE_INTEGER t, freq;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&freq);
+    return ((double)t.QuadPart)/((double)freq.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((double)t.tv_sec)+((double)t.tv_nsec)/1.e+9;
+#else
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return ((double)t.tv_sec)+((double)t.tv_usec)/1.e+6;
+#endif
+}
+
+// Deterministic operands, so that results are comparable between runs and commits
+static int bench_rng(void *ctx, char *buf, size_t len)
+{
+    unsigned long *state = (unsigned long *) ctx;
+    for (size_t i=0; i<len; i++)
+    {
+        *state = *state * 1103515245UL + 12345UL;
+        buf[i] = (char) (*state >> 16);
+    }
+    return 0;
+}
+
+static void bench_random(vlong &v, size_t bits, unsigned long *state)
+{
+    std::vector<char> buf((bits+7)/8);
+    bench_rng(state, &buf[0], buf.size());
+    v.FromBinary(&buf[0], buf.size());
+    v.SetBit(bits-1, 1);
+}
+
+//------------------------------------------------------------------------------------------------------
+
+// Hardware performance counters, counted in user space only (Linux perf_event_open).
+// Counters that cannot be opened (other systems, virtual machines without a PMU,
+// perf_event_paranoid) are reported as unavailable.
+enum
+{
+    BENCH_CYCLES,
+    BENCH_INSTRUCTIONS,
+    BENCH_L1D_MISSES,
+    BENCH_LLC_MISSES,
+    BENCH_BRANCH_MISSES,
+    BENCH_NCOUNTERS
+};
+
+static const char *bench_counter_names[BENCH_NCOUNTERS] =
+    {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+
+struct BenchCounters
+{
+    int fd[BENCH_NCOUNTERS];
+    int available;      // number of counters opened
+};
+
+#ifdef __linux__
+
+static int bench_perf_open(unsigned int type, unsigned long long config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // Counters are multiplexed if there are not enough of them, the values are then scaled
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void bench_counters_open(BenchCounters &c)
+{
+    const unsigned long long l1dReadMiss = PERF_COUNT_HW_CACHE_L1D |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+    c.fd[BENCH_CYCLES] = bench_perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    c.fd[BENCH_INSTRUCTIONS] = bench_perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    c.fd[BENCH_L1D_MISSES] = bench_perf_open(PERF_TYPE_HW_CACHE, l1dReadMiss);
+    c.fd[BENCH_LLC_MISSES] = bench_perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    c.fd[BENCH_BRANCH_MISSES] = bench_perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+    c.available = 0;
+    for (int i=0; i<BENCH_NCOUNTERS; i++)
+        if (c.fd[i] >= 0)
+            c.available++;
+    if (c.available < BENCH_NCOUNTERS)
+        fprintf(stderr, "%d of %d hardware counters available (%s)\n", c.available, BENCH_NCOUNTERS,
+            c.available ? "partial PMU support" : strerror(errno));
+}
+
+static void bench_counters_close(BenchCounters &c)
+{
+    for (int i=0; i<BENCH_NCOUNTERS; i++)
+        if (c.fd[i] >= 0)
+            close(c.fd[i]);
+}
+
+static void bench_counters_start(const BenchCounters &c)
+{
+    for (int i=0; i<BENCH_NCOUNTERS; i++)
+    {
+        if (c.fd[i] < 0)
+            continue;
+        ioctl(c.fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(c.fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+// Counts since bench_counters_start(), negative if unavailable
+static void bench_counters_stop(const BenchCounters &c, double *values)
+{
+    for (int i=0; i<BENCH_NCOUNTERS; i++)
+    {
+        unsigned long long v[3];    // value, time enabled, time running
+        values[i] = -1;
+        if (c.fd[i] < 0)
+            continue;
+        ioctl(c.fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(c.fd[i], v, sizeof(v)) == (ssize_t) sizeof(v) && v[2] > 0)
+            values[i] = (double) v[0] * ((double) v[1] / (double) v[2]);
+    }
+}
+
+#else
+
+static void bench_counters_open(BenchCounters &c)
+{
+    for (int i=0; i<BENCH_NCOUNTERS; i++)
+        c.fd[i] = -1;
+    c.available = 0;
+    fprintf(stderr, "Hardware counters are only supported on Linux\n");
+}
+
+static void bench_counters_close(BenchCounters &) {}
+static void bench_counters_start(const BenchCounters &) {}
+
+static void bench_counters_stop(const BenchCounters &, double *values)
+{
+    for (int i=0; i<BENCH_NCOUNTERS; i++)
+        values[i] = -1;
+}
+
+#endif
+
+//------------------------------------------------------------------------------------------------------
+
+// Operands of one size shared by all operations
+struct BenchOperands
+{
+    size_t bits;
+    vlong a, b, wide;            // bits-bit operands and a 2*bits-bit dividend
+    vlong odd, even, dr;         // moduli for Montgomery, Barrett and diminished radix reduction
+    vlong sqOdd, sqEven, sqDr;   // squares of residues, inputs of the reductions
+    vlong base, e, inv;          // PowMod base and exponent, InvMod argument (coprime to odd)
+    std::string dec, hex, text;  // a as text and x as text
+    BigDecimal x, y;             // bits*log10(2) decimal digits, half of them after the point
+
+    vlong r;
+    BigDecimal z;
+
+    BenchOperands() : x(0), y(0), z(0) {}
+};
+
+// Bits a number can hold, and VLONG_MAX_DIGITS for the results (0 if unlimited)
+#ifdef VLONG_MAX_DIGITS
+#define BENCH_MAX_DIGITS  VLONG_MAX_DIGITS
+#define BENCH_CAPACITY    ((size_t) VLONG_MAX_DIGITS * sizeof(udig_t) * 8)
+#else
+#define BENCH_MAX_DIGITS  0
+#define BENCH_CAPACITY    ((size_t) -1)
+#endif
+
+// Operands of double size are only generated when they fit VLONG_MAX_DIGITS
+static void bench_setup(BenchOperands &o, size_t bits, bool wide)
+{
+    unsigned long state = 20240229UL + (unsigned long) bits;
+    vlong t;
+
+    o.bits = bits;
+    bench_random(o.a, bits, &state);
+    bench_random(o.b, bits, &state);
+    bench_random(o.e, bits, &state);
+
+    bench_random(o.odd, bits, &state);
+    o.odd.SetBit(0, 1);
+    bench_random(o.even, bits, &state);
+    o.even.SetBit(0, 0);
+
+    // 2**bits - k, all digits but the lowest one are ones
+    o.dr.SetValue(1);
+    o.dr.ShiftLeft(o.dr, (int) bits);
+    o.dr.Sub(o.dr, 4093);
+
+    if (wide)
+    {
+        bench_random(o.wide, 2*bits, &state);
+        t.Mod(o.a, o.odd);
+        o.sqOdd.Mul(t, t);
+        t.Mod(o.a, o.even);
+        o.sqEven.Mul(t, t);
+        t.Mod(o.a, o.dr);
+        o.sqDr.Mul(t, t);
+    }
+    o.base.Mod(o.b, o.odd);
+
+    o.inv = o.b;
+    for (;;)
+    {
+        t.GCD(o.inv, o.odd);
+        if (t.Compare(1) == 0)
+            break;
+        o.inv.Add(o.inv, 1);
+    }
+
+    o.dec = o.a.ToString(10);
+    o.hex = o.a.ToString(16);
+
+    int scale = (int) o.dec.size() / 2;
+    o.x = BigDecimal(o.a, scale);
+    o.y = BigDecimal(o.b, scale);
+    o.text = o.x.toString();
+}
+
+typedef void (*BenchFunc)(BenchOperands &o);
+
+static void bench_add(BenchOperands &o) { o.r.Add(o.a, o.b); }
+static void bench_sub(BenchOperands &o) { o.r.Sub(o.a, o.b); }
+static void bench_mul(BenchOperands &o) { o.r.Mul(o.a, o.b); }
+static void bench_sqr(BenchOperands &o) { o.r.Sqr(o.a); }
+static void bench_div(BenchOperands &o) { o.r.Div(o.wide, o.b); }
+static void bench_mod(BenchOperands &o) { o.r.Mod(o.wide, o.b); }
+static void bench_mod_barrett(BenchOperands &o) { o.r.ModBarrett(o.sqEven, o.even); }
+static void bench_mod_montgomery(BenchOperands &o) { o.r.ModMontgomery(o.sqOdd, o.odd); }
+static void bench_mod_dr(BenchOperands &o) { o.r.ModDRExt(o.sqDr, o.dr); }
+static void bench_powmod_barrett(BenchOperands &o) { o.r.PowMod(o.base, o.e, o.even); }
+static void bench_powmod_montgomery(BenchOperands &o) { o.r.PowMod(o.base, o.e, o.odd); }
+static void bench_powmod_dr(BenchOperands &o) { o.r.PowMod(o.base, o.e, o.dr); }
+static void bench_gcd(BenchOperands &o) { o.r.GCD(o.a, o.b); }
+static void bench_invmod(BenchOperands &o) { o.r.InvMod(o.inv, o.odd); }
+static void bench_to_dec(BenchOperands &o) { o.a.ToString(10); }
+static void bench_to_hex(BenchOperands &o) { o.a.ToString(16); }
+static void bench_from_dec(BenchOperands &o) { o.r.FromString(o.dec.c_str(), 10); }
+static void bench_from_hex(BenchOperands &o) { o.r.FromString(o.hex.c_str(), 16); }
+static void bench_bd_add(BenchOperands &o) { o.z = o.x + o.y; }
+static void bench_bd_mul(BenchOperands &o) { o.z = o.x * o.y; }
+static void bench_bd_div(BenchOperands &o) { o.z = o.x / o.y; }
+static void bench_bd_to_string(BenchOperands &o) { o.x.toString(); }
+static void bench_bd_from_string(BenchOperands &o) { o.z.fromString(o.text.c_str()); }
+
+struct BenchOp
+{
+    const char *name;
+    BenchFunc func;
+    size_t maxBits;     // default size limit for slow operations
+    size_t width;       // largest intermediate result in multiples of the operand size
+};
+
+static const BenchOp bench_ops[] =
+{
+    {"add",             bench_add,               65536, 1},
+    {"sub",             bench_sub,               65536, 1},
+    {"mul",             bench_mul,               65536, 2},
+    {"sqr",             bench_sqr,               65536, 2},
+    {"div",             bench_div,               65536, 2},
+    {"mod",             bench_mod,               65536, 2},
+    {"mod_barrett",     bench_mod_barrett,       65536, 4},
+    {"mod_montgomery",  bench_mod_montgomery,    65536, 2},
+    {"mod_dr",          bench_mod_dr,            65536, 2},
+    {"powmod_barrett",  bench_powmod_barrett,     4096, 4},
+    {"powmod_montgomery", bench_powmod_montgomery, 4096, 2},
+    {"powmod_dr",       bench_powmod_dr,          4096, 2},
+    {"gcd",             bench_gcd,               65536, 1},
+    {"invmod",          bench_invmod,            16384, 2},
+    {"to_dec",          bench_to_dec,            65536, 1},
+    {"to_hex",          bench_to_hex,            65536, 1},
+    {"from_dec",        bench_from_dec,          65536, 1},
+    {"from_hex",        bench_from_hex,          65536, 1},
+    {"bd_add",          bench_bd_add,            65536, 1},
+    {"bd_mul",          bench_bd_mul,            65536, 2},
+    {"bd_div",          bench_bd_div,            65536, 2},
+    {"bd_to_string",    bench_bd_to_string,      65536, 1},
+    {"bd_from_string",  bench_bd_from_string,    65536, 1},
+};
+
+static const size_t bench_nops = sizeof(bench_ops)/sizeof(bench_ops[0]);
+
+//------------------------------------------------------------------------------------------------------
+
+struct BenchOptions
+{
+    const char *format;
+    const char *out;
+    const char *ops;
+    size_t minBits, maxBits;
+    int reps, warmup;
+    double minTime;     // seconds per sample
+    bool counters;      // hardware performance counters
+    const char *baseline;   // JSON results to compare with
+    double threshold;   // relative change of the median to report
+    double alpha;       // significance level of the rank test
+};
+
+struct BenchResult
+{
+    const char *op;
+    size_t bits;
+    long iters;
+    std::vector<double> samples;    // ns per operation
+    size_t kept;
+    double median, mean, min, stddev;
+    double counters[BENCH_NCOUNTERS];   // per operation over all repetitions, negative if unavailable
+};
+
+static double bench_quantile(const std::vector<double> &sorted, double q)
+{
+    double pos = q * (sorted.size() - 1);
+    size_t i = (size_t) pos;
+    if (i + 1 >= sorted.size())
+        return sorted[sorted.size() - 1];
+    return sorted[i] + (pos - i) * (sorted[i+1] - sorted[i]);
+}
+
+// Statistics of the samples inside the Tukey fences [Q1 - 1.5*IQR, Q3 + 1.5*IQR]
+static void bench_stats(BenchResult &r)
+{
+    std::vector<double> s(r.samples);
+    std::sort(s.begin(), s.end());
+
+    double q1 = bench_quantile(s, 0.25), q3 = bench_quantile(s, 0.75);
+    double lo = q1 - 1.5*(q3 - q1), hi = q3 + 1.5*(q3 - q1);
+    std::vector<double> kept;
+    size_t i;
+
+    for (i=0; i<s.size(); i++)
+        if (s[i] >= lo && s[i] <= hi)
+            kept.push_back(s[i]);
+
+    r.kept = kept.size();
+    r.median = bench_quantile(kept, 0.5);
+    r.min = kept[0];
+    r.mean = 0;
+    for (i=0; i<kept.size(); i++)
+        r.mean += kept[i];
+    r.mean /= kept.size();
+    r.stddev = 0;
+    for (i=0; i<kept.size(); i++)
+        r.stddev += (kept[i] - r.mean)*(kept[i] - r.mean);
+    r.stddev = kept.size() > 1 ? sqrt(r.stddev / (kept.size() - 1)) : 0;
+}
+
+static double bench_sample(BenchFunc f, BenchOperands &o, long iters)
+{
+    double t0 = bench_time();
+    for (long i=0; i<iters; i++)
+        f(o);
+    return bench_time() - t0;
+}
+
+static void bench_run(const BenchOp &op, BenchOperands &o, const BenchOptions &opt, const BenchCounters &c, BenchResult &r)
+{
+    int i;
+
+    r.op = op.name;
+    r.bits = o.bits;
+
+    // Calibrate the number of iterations to fill the minimum sample time
+    double t = bench_sample(op.func, o, 1);
+    r.iters = 1;
+    while (t < opt.minTime && r.iters < 100000000L)
+    {
+        r.iters = t > 0 && opt.minTime / t < 10 ? (long)(r.iters * (opt.minTime / t) * 1.1) + 1 : r.iters * 10;
+        t = bench_sample(op.func, o, r.iters);
+    }
+
+    for (i=0; i<opt.warmup; i++)
+        bench_sample(op.func, o, r.iters);
+
+    r.samples.clear();
+    bench_counters_start(c);
+    for (i=0; i<opt.reps; i++)
+        r.samples.push_back(bench_sample(op.func, o, r.iters) * 1.e+9 / r.iters);
+    bench_counters_stop(c, r.counters);
+
+    for (i=0; i<BENCH_NCOUNTERS; i++)
+        if (r.counters[i] >= 0)
+            r.counters[i] /= (double) opt.reps * r.iters;
+
+    bench_stats(r);
+}
+
+//------------------------------------------------------------------------------------------------------
+
+// Results of a previous "--format json" run
+struct BenchBaseline
+{
+    std::string op;
+    size_t bits;
+    std::vector<double> samples;
+};
+
+// Position just after "key": inside s[from, to), npos if the key is missing
+static size_t bench_json_key(const std::string &s, size_t from, size_t to, const char *key)
+{
+    std::string k = std::string("\"") + key + "\"";
+    size_t p = s.find(k, from);
+    if (p == std::string::npos || p >= to)
+        return std::string::npos;
+    p = s.find(':', p + k.size());
+    return p < to ? p + 1 : std::string::npos;
+}
+
+// Reads the results written by bench_print() in JSON format,
+// returns false if the file cannot be read or holds no results
+static bool bench_load_baseline(const char *fileName, std::vector<BenchBaseline> &base)
+{
+    FILE *f = fopen(fileName, "rb");
+    if (f == NULL)
+        return false;
+    std::string s;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        s.append(buf, n);
+    fclose(f);
+
+    size_t p = bench_json_key(s, 0, s.size(), "results");
+    while (p != std::string::npos && (p = s.find('{', p)) != std::string::npos)
+    {
+        size_t end = s.find('}', p);
+        if (end == std::string::npos)
+            break;
+
+        BenchBaseline b;
+        size_t q = bench_json_key(s, p, end, "op"), r;
+        if (q == std::string::npos || (q = s.find('"', q)) >= end || (r = s.find('"', q + 1)) >= end)
+            return false;
+        b.op = s.substr(q + 1, r - q - 1);
+        if ((q = bench_json_key(s, p, end, "bits")) == std::string::npos)
+            return false;
+        b.bits = (size_t) atol(s.c_str() + q);
+        if ((q = bench_json_key(s, p, end, "samples_ns")) == std::string::npos || (q = s.find('[', q)) >= end)
+            return false;
+        for (q++; q < end && s[q] != ']'; q++)
+        {
+            char *e;
+            double v = strtod(s.c_str() + q, &e);
+            if (e == s.c_str() + q)
+                continue;
+            b.samples.push_back(v);
+            q = e - s.c_str() - 1;
+        }
+        if (b.samples.empty())
+            return false;
+        base.push_back(b);
+        p = end + 1;
+    }
+    return !base.empty();
+}
+
+// Upper tail of the standard normal distribution [Abramowitz & Stegun 26.2.17]
+static double bench_normal_tail(double z)
+{
+    if (z < 0)
+        return 1 - bench_normal_tail(-z);
+    double t = 1 / (1 + 0.2316419 * z);
+    double poly = t * (0.319381530 + t * (-0.356563782 + t * (1.781477937 + t * (-1.821255978 + t * 1.330274429))));
+    return 0.3989422804014327 * exp(-z * z / 2) * poly;
+}
+
+// One-sided Mann-Whitney U test, normal approximation with tie correction.
+// Returns the p-value of the hypothesis that samples of x tend to be larger than y.
+static double bench_mann_whitney(const std::vector<double> &x, const std::vector<double> &y)
+{
+    std::vector< std::pair<double, int> > all;
+    size_t i, j, n1 = x.size(), n2 = y.size(), n = n1 + n2;
+    for (i=0; i<n1; i++)
+        all.push_back(std::make_pair(x[i], 0));
+    for (i=0; i<n2; i++)
+        all.push_back(std::make_pair(y[i], 1));
+    std::sort(all.begin(), all.end());
+
+    // Rank sum of x, tied values get the average rank
+    double r1 = 0, ties = 0;
+    for (i=0; i<n; i=j)
+    {
+        for (j=i+1; j<n && all[j].first == all[i].first; j++)
+            ;
+        double t = (double) (j - i), rank = (i + j + 1) / 2.0;
+        for (size_t k=i; k<j; k++)
+            if (all[k].second == 0)
+                r1 += rank;
+        ties += t*t*t - t;
+    }
+
+    double u = r1 - n1 * (n1 + 1) / 2.0, mu = n1 * n2 / 2.0;
+    double var = n1 * n2 / 12.0 * ((n + 1) - ties / ((double) n * (n - 1)));
+    if (var <= 0)
+        return 1;
+    double z = (u - mu - 0.5) / sqrt(var);
+    return bench_normal_tail(z);
+}
+
+// Compares a result with the baseline and reports it on stderr.
+// Returns true for a regression: the median grew by more than the threshold
+// and the samples are significantly slower.
+static bool bench_compare(const BenchOptions &opt, const std::vector<BenchBaseline> &base, const BenchResult &r)
+{
+    size_t i;
+    for (i=0; i<base.size() && (base[i].op != r.op || base[i].bits != r.bits); i++)
+        ;
+    if (i == base.size())
+    {
+        fprintf(stderr, "%-18s %6u %14s %14.1f %8s %9s  new\n", r.op, (unsigned) r.bits, "-", r.median, "-", "-");
+        return false;
+    }
+
+    BenchResult b;
+    b.samples = base[i].samples;
+    bench_stats(b);
+    double change = b.median > 0 ? r.median / b.median - 1 : 0;
+    double pSlower = bench_mann_whitney(r.samples, b.samples);
+    double pFaster = bench_mann_whitney(b.samples, r.samples);
+    bool regression = change > opt.threshold && pSlower < opt.alpha;
+
+    fprintf(stderr, "%-18s %6u %14.1f %14.1f %+7.1f%% %9.2g  %s\n", r.op, (unsigned) r.bits, b.median, r.median, 100*change,
+        change > 0 ? pSlower : pFaster, regression ? "REGRESSION" : change < -opt.threshold && pFaster < opt.alpha ? "faster" : "ok");
+    return regression;
+}
+
+static bool bench_selected(const char *ops, const char *name)
+{
+    if (ops == NULL)
+        return true;
+    size_t n = strlen(name);
+    for (const char *p = ops; (p = strstr(p, name)) != NULL; p += n)
+    {
+        if ((p == ops || p[-1] == ',') && (p[n] == ',' || p[n] == 0))
+            return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------------------------------
+
+// Instructions per cycle, negative if unavailable
+static double bench_ipc(const BenchResult &r)
+{
+    if (r.counters[BENCH_CYCLES] <= 0 || r.counters[BENCH_INSTRUCTIONS] < 0)
+        return -1;
+    return r.counters[BENCH_INSTRUCTIONS] / r.counters[BENCH_CYCLES];
+}
+
+static void bench_print_header(FILE *f, const BenchOptions &opt)
+{
+    int i;
+    if (strcmp(opt.format, "csv") == 0)
+    {
+        fprintf(f, "op,bits,iters,reps,kept,median_ns,mean_ns,min_ns,stddev_ns");
+        for (i=0; i<BENCH_NCOUNTERS; i++)
+            fprintf(f, ",%s", bench_counter_names[i]);
+        fprintf(f, ",ipc\n");
+    }
+    else if (strcmp(opt.format, "json") == 0)
+    {
+        fprintf(f, "{\n  \"digit_bits\": %d, \"max_digits\": %d, \"karatsuba_cutoff\": %d,\n",
+            (int) sizeof(udig_t)*8, (int) BENCH_MAX_DIGITS, (int) VLONG_KARATSUBA_MUL_CUTOFF);
+        fprintf(f, "  \"reps\": %d, \"warmup\": %d, \"min_time_ms\": %g,\n  \"results\": [", opt.reps, opt.warmup, opt.minTime*1000);
+    }
+    else
+    {
+        fprintf(f, "%-18s %6s %10s %14s %14s %8s %6s", "op", "bits", "iters", "median ns", "mean ns", "stddev", "kept");
+        if (opt.counters)
+            fprintf(f, " %12s %5s %10s %10s %10s", "cycles", "IPC", "L1D miss", "LLC miss", "br miss");
+        fprintf(f, "\n");
+    }
+}
+
+// Counter value in a field of the given width, "-" if unavailable
+static void bench_print_counter(FILE *f, const char *sep, int width, double v, const char *unavailable)
+{
+    if (v < 0)
+        fprintf(f, "%s%*s", sep, width, unavailable);
+    else
+        fprintf(f, "%s%*.*f", sep, width, v < 10 ? 2 : 0, v);
+}
+
+static void bench_print(FILE *f, const BenchOptions &opt, const BenchResult &r, bool first)
+{
+    int i;
+    if (strcmp(opt.format, "csv") == 0)
+    {
+        fprintf(f, "%s,%u,%ld,%u,%u,%.1f,%.1f,%.1f,%.1f", r.op, (unsigned) r.bits, r.iters,
+            (unsigned) r.samples.size(), (unsigned) r.kept, r.median, r.mean, r.min, r.stddev);
+        for (i=0; i<BENCH_NCOUNTERS; i++)
+            bench_print_counter(f, ",", 0, r.counters[i], "");
+        bench_print_counter(f, ",", 0, bench_ipc(r), "");
+        fprintf(f, "\n");
+    }
+    else if (strcmp(opt.format, "json") == 0)
+    {
+        fprintf(f, "%s\n    {\"op\": \"%s\", \"bits\": %u, \"iters\": %ld, \"kept\": %u, \"median_ns\": %.1f, \"mean_ns\": %.1f, "
+            "\"min_ns\": %.1f, \"stddev_ns\": %.1f,\n     \"samples_ns\": [", first ? "" : ",", r.op, (unsigned) r.bits, r.iters,
+            (unsigned) r.kept, r.median, r.mean, r.min, r.stddev);
+        for (size_t k=0; k<r.samples.size(); k++)
+            fprintf(f, "%s%.1f", k ? ", " : "", r.samples[k]);
+        fprintf(f, "]");
+        for (i=0; i<BENCH_NCOUNTERS; i++)
+        {
+            fprintf(f, ", \"%s\": ", bench_counter_names[i]);
+            bench_print_counter(f, "", 0, r.counters[i], "null");
+        }
+        fprintf(f, ", \"ipc\": ");
+        bench_print_counter(f, "", 0, bench_ipc(r), "null");
+        fprintf(f, "}");
+    }
+    else
+    {
+        fprintf(f, "%-18s %6u %10ld %14.1f %14.1f %7.2f%% %3u/%-3u", r.op, (unsigned) r.bits, r.iters, r.median, r.mean,
+            r.mean > 0 ? 100*r.stddev/r.mean : 0, (unsigned) r.kept, (unsigned) r.samples.size());
+        if (opt.counters)
+        {
+            bench_print_counter(f, " ", 12, r.counters[BENCH_CYCLES], "-");
+            bench_print_counter(f, " ", 5, bench_ipc(r), "-");
+            bench_print_counter(f, " ", 10, r.counters[BENCH_L1D_MISSES], "-");
+            bench_print_counter(f, " ", 10, r.counters[BENCH_LLC_MISSES], "-");
+            bench_print_counter(f, " ", 10, r.counters[BENCH_BRANCH_MISSES], "-");
+        }
+        fprintf(f, "\n");
+    }
+    fflush(f);
+}
+
+static void bench_print_footer(FILE *f, const BenchOptions &opt)
+{
+    if (strcmp(opt.format, "json") == 0)
+        fprintf(f, "\n  ]\n}\n");
+}
+
+static void bench_usage()
+{
+    size_t i;
+    printf("Usage: bench [options]\n"
+           "  --format text|csv|json  output format (text)\n"
+           "  --out FILE              write results to FILE instead of stdout\n"
+           "  --ops op1,op2,...       operations to run (all)\n"
+           "  --min-bits N            smallest operand size in bits (64)\n"
+           "  --max-bits N            largest operand size in bits (65536)\n"
+           "  --reps N                measured repetitions (11)\n"
+           "  --warmup N              discarded warm-up repetitions (2)\n"
+           "  --min-time MS           minimum duration of a repetition (5)\n"
+           "  --no-counters           do not read hardware performance counters\n"
+           "  --baseline FILE         compare with the results of a previous --format json run\n"
+           "                          and exit with status 2 if any operation regressed\n"
+           "  --threshold PCT         smallest slowdown of the median reported as a regression (5)\n"
+           "  --alpha P               significance level of the Mann-Whitney test (0.01)\n"
+           "Operand sizes are doubled from min-bits to max-bits. Sizes that do not fit\n"
+           "VLONG_MAX_DIGITS are skipped, and PowMod and InvMod stop at 4096 and 16384\n"
+           "bits unless --max-bits is given. The baseline comparison needs several\n"
+           "repetitions on both sides to be significant (--reps 8 or more).\nOperations:");
+    for (i=0; i<bench_nops; i++)
+        printf("%s%s", i % 8 ? " " : "\n  ", bench_ops[i].name);
+    printf("\n");
+}
+
+int vlong_bench(int argc, char *argv[])
+{
+    BenchOptions opt;
+    bool explicitMax = false;
+    int i;
+
+    opt.format = "text";
+    opt.out = NULL;
+    opt.ops = NULL;
+    opt.minBits = 64;
+    opt.maxBits = 65536;
+    opt.reps = 11;
+    opt.warmup = 2;
+    opt.minTime = 0.005;
+    opt.counters = true;
+    opt.baseline = NULL;
+    opt.threshold = 0.05;
+    opt.alpha = 0.01;
+
+    for (i=0; i<argc; i++)
+    {
+        const char *arg = argv[i], *val = i+1 < argc ? argv[i+1] : NULL;
+        if (strcmp(arg, "--help") == 0)
+        {
+            bench_usage();
+            return 0;
+        }
+        if (strcmp(arg, "--no-counters") == 0)
+        {
+            opt.counters = false;
+            continue;
+        }
+        if (val == NULL)
+        {
+            bench_usage();
+            return 1;
+        }
+        if (strcmp(arg, "--format") == 0)
+            opt.format = val;
+        else if (strcmp(arg, "--out") == 0)
+            opt.out = val;
+        else if (strcmp(arg, "--ops") == 0)
+            opt.ops = val;
+        else if (strcmp(arg, "--min-bits") == 0)
+            opt.minBits = (size_t) atol(val);
+        else if (strcmp(arg, "--max-bits") == 0)
+        {
+            opt.maxBits = (size_t) atol(val);
+            explicitMax = true;
+        }
+        else if (strcmp(arg, "--reps") == 0)
+            opt.reps = atoi(val);
+        else if (strcmp(arg, "--warmup") == 0)
+            opt.warmup = atoi(val);
+        else if (strcmp(arg, "--min-time") == 0)
+            opt.minTime = atof(val) / 1000;
+        else if (strcmp(arg, "--baseline") == 0)
+            opt.baseline = val;
+        else if (strcmp(arg, "--threshold") == 0)
+            opt.threshold = atof(val) / 100;
+        else if (strcmp(arg, "--alpha") == 0)
+            opt.alpha = atof(val);
+        else
+        {
+            bench_usage();
+            return 1;
+        }
+        i++;
+    }
+    if (opt.reps < 1 || opt.minBits < 8 || (strcmp(opt.format, "text") && strcmp(opt.format, "csv") && strcmp(opt.format, "json")))
+    {
+        bench_usage();
+        return 1;
+    }
+
+    std::vector<BenchBaseline> base;
+    if (opt.baseline && !bench_load_baseline(opt.baseline, base))
+    {
+        printf("Cannot read benchmark results from %s\n", opt.baseline);
+        return 1;
+    }
+
+    FILE *f = opt.out ? fopen(opt.out, "w") : stdout;
+    if (f == NULL)
+    {
+        printf("Cannot open %s\n", opt.out);
+        return 1;
+    }
+
+    const size_t capacity = BENCH_CAPACITY;
+    BenchOperands o;
+    BenchResult r;
+    BenchCounters c;
+    bool first = true;
+    int regressions = 0;
+
+    // Counter columns are left out of the table if none of them can be read
+    if (opt.counters)
+        bench_counters_open(c);
+    else
+        for (i=0; i<BENCH_NCOUNTERS; i++)
+            c.fd[i] = -1;
+    opt.counters = opt.counters && c.available > 0;
+
+    bench_print_header(f, opt);
+    if (opt.baseline)
+        fprintf(stderr, "%-18s %6s %14s %14s %8s %9s  (baseline %s)\n", "op", "bits", "baseline ns", "median ns", "change", "p", opt.baseline);
+    for (size_t bits = opt.minBits; bits <= opt.maxBits; bits *= 2)
+    {
+        bool setup = false;
+        for (size_t k=0; k<bench_nops; k++)
+        {
+            const BenchOp &op = bench_ops[k];
+            if (!bench_selected(opt.ops, op.name) || (!explicitMax && bits > op.maxBits))
+                continue;
+
+            // Leave a digit of headroom for carries and normalization
+            if (op.width * bits + 2 * sizeof(udig_t) * 8 > capacity)
+            {
+                fprintf(stderr, "%s at %u bits skipped: exceeds VLONG_MAX_DIGITS\n", op.name, (unsigned) bits);
+                continue;
+            }
+            if (!setup)
+            {
+                bench_setup(o, bits, 2 * bits + 2 * sizeof(udig_t) * 8 <= capacity);
+                setup = true;
+            }
+            bench_run(op, o, opt, c, r);
+            bench_print(f, opt, r, first);
+            first = false;
+            if (opt.baseline && bench_compare(opt, base, r))
+                regressions++;
+        }
+    }
+    bench_print_footer(f, opt);
+    bench_counters_close(c);
+
+    if (f != stdout)
+        fclose(f);
+
+    if (opt.baseline)
+        fprintf(stderr, "%d regression(s) above %g%% at p < %g\n", regressions, opt.threshold*100, opt.alpha);
+    return regressions > 0 ? 2 : 0;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Workloads: complete operations of an application, run on 1..N threads
+
+// RFC 3526 2048-bit MODP group (group 14), the generator is 2
+static const char *work_modp2048 =
+    "FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+    "4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7EDEE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+    "98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+    "E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF6955817183995497CEA956AE515D2261898FA051015728E5A8AACAA68FFFFFFFFFFFFFFFF";
+
+// Data shared by all threads of a workload, every thread works on its own copy
+struct WorkShared
+{
+    vlong_rsa_key key;              // RSA key
+    vlong msg, sig;                 // message representative and its signature
+    vlong g, modp, peer;            // DH group and the public key of the peer
+    std::vector<BigDecimal> amounts, rates;     // ledger postings and their exchange rates
+};
+
+struct WorkThread;
+typedef bool (*WorkSetup)(WorkShared &s, size_t size, unsigned long *state);
+typedef void (*WorkFunc)(WorkThread &t);
+
+struct Workload
+{
+    const char *name;
+    size_t size;        // bits, or postings per batch
+    WorkSetup setup;
+    WorkFunc func;
+};
+
+struct WorkThread
+{
+    const Workload *work;
+    WorkShared data;
+    double duration;
+    unsigned long rng;
+    double start, end;
+    std::vector<double> latency;    // microseconds per operation
+    vlong_profile prof;             // operation counters and operand sizes of the thread
+    vlong r, x, y;
+    BigDecimal z;
+
+    WorkThread() : z(0) {}
+};
+
+// Random prime of the given size with the two top bits set, so that the product
+// of two of them has exactly twice the bits
+static void work_prime_of(vlong &p, size_t bits, unsigned long *state)
+{
+    bench_random(p, bits, state);
+    p.SetBit(bits-2, 1);
+    p.SearchNearestPrime();
+}
+
+// RSA key with e = 65537
+static bool work_rsa_key(vlong_rsa_key &k, size_t bits, unsigned long *state)
+{
+    vlong p1, q1, phi, t;
+
+    k.e.SetValue(65537);
+    do
+    {
+        work_prime_of(k.p, bits/2, state);
+        p1.Sub(k.p, 1);
+        t.GCD(p1, k.e);
+    } while (t.Compare(1) != 0);
+    do
+    {
+        work_prime_of(k.q, bits/2, state);
+        q1.Sub(k.q, 1);
+        t.GCD(q1, k.e);
+    } while (t.Compare(1) != 0 || k.q.Compare(k.p) == 0);
+
+    k.n.Mul(k.p, k.q);
+    phi.Mul(p1, q1);
+    k.d.InvMod(k.e, phi);
+    k.dp.Mod(k.d, p1);
+    k.dq.Mod(k.d, q1);
+    k.qp.InvMod(k.q, k.p);
+    return k.n.GetNumBits() == bits;
+}
+
+int vlong_rsa_keygen(vlong_rsa_key &key, size_t bits)
+{
+    // the workloads seed their setup with the size
+    unsigned long state = (unsigned long) bits;
+    return work_rsa_key(key, bits, &state) ? 0 : -1;
+}
+
+// The message is signed once and verified
+static bool work_rsa_setup(WorkShared &s, size_t bits, unsigned long *state)
+{
+    const vlong_rsa_key &k = s.key;
+    vlong t;
+
+    if (!work_rsa_key(s.key, bits, state))
+        return false;
+    bench_random(s.msg, bits - 8, state);
+    s.sig.PowModCRT(s.msg, k.p, k.q, k.dp, k.dq, k.qp);
+    t.PowMod(s.sig, k.e, k.n);
+    return t.Compare(s.msg) == 0;
+}
+
+static bool work_dh_setup(WorkShared &s, size_t, unsigned long *state)
+{
+    vlong x;
+    s.modp.FromString(work_modp2048, 16);
+    s.g.SetValue(2);
+    bench_random(x, 256, state);
+    return s.peer.PowMod(s.g, x, s.modp) == VLONG_SUCCESS;
+}
+
+// Amounts in cents and exchange rates with 6 decimals
+static bool work_ledger_setup(WorkShared &s, size_t postings, unsigned long *state)
+{
+    char buf[32];
+    s.amounts.clear();
+    s.rates.clear();
+    for (size_t i=0; i<postings; i++)
+    {
+        unsigned long r[2];
+        bench_rng(state, (char *) r, sizeof(r));
+        sprintf(buf, "%s%lu.%02lu", r[0] & 1 ? "-" : "", (r[0] >> 1) % 10000000, r[1] % 100);
+        s.amounts.push_back(BigDecimal(buf));
+        sprintf(buf, "%lu.%06lu", 1 + (r[1] >> 8) % 2, (r[1] >> 12) % 1000000);
+        s.rates.push_back(BigDecimal(buf));
+    }
+    return true;
+}
+
+static void work_rsa_sign(WorkThread &t)
+{
+    const vlong_rsa_key &k = t.data.key;
+    t.r.PowModCRT(t.data.msg, k.p, k.q, k.dp, k.dq, k.qp);
+}
+static void work_rsa_verify(WorkThread &t) { t.r.PowMod(t.data.sig, t.data.key.e, t.data.key.n); }
+
+// Key agreement: a fresh private key, its public key and the shared secret
+static void work_dh(WorkThread &t)
+{
+    bench_random(t.x, 256, &t.rng);
+    t.y.PowMod(t.data.g, t.x, t.data.modp);
+    t.r.PowMod(t.data.peer, t.x, t.data.modp);
+}
+
+static void work_prime(WorkThread &t) { work_prime_of(t.r, t.work->size, &t.rng); }
+
+// A batch of postings converted to the ledger currency, rounded to cents and summed
+static void work_ledger(WorkThread &t)
+{
+    DecimalAccumulator acc;
+    for (size_t i=0; i<t.data.amounts.size(); i++)
+    {
+        BigDecimal v = t.data.amounts[i] * t.data.rates[i];
+        v.setScale(2, ROUND_HALF_EVEN);
+        acc.add(v);
+    }
+    t.z = acc.result();
+}
+
+static const Workload work_loads[] =
+{
+    { "rsa_sign_1024",   1024, work_rsa_setup,    work_rsa_sign },
+    { "rsa_verify_1024", 1024, work_rsa_setup,    work_rsa_verify },
+    { "rsa_sign_2048",   2048, work_rsa_setup,    work_rsa_sign },
+    { "rsa_verify_2048", 2048, work_rsa_setup,    work_rsa_verify },
+    { "rsa_sign_3072",   3072, work_rsa_setup,    work_rsa_sign },
+    { "rsa_verify_3072", 3072, work_rsa_setup,    work_rsa_verify },
+    { "rsa_sign_4096",   4096, work_rsa_setup,    work_rsa_sign },
+    { "rsa_verify_4096", 4096, work_rsa_setup,    work_rsa_verify },
+    { "dh_2048",         2048, work_dh_setup,     work_dh },
+    { "prime_2048",      2048, NULL,              work_prime },
+    { "ledger",          1000, work_ledger_setup, work_ledger },
+};
+
+static const size_t work_nloads = sizeof(work_loads)/sizeof(work_loads[0]);
+
+//------------------------------------------------------------------------------------------------------
+
+// Every thread runs the operation until its time is up, at least once
+#ifdef WIN32
+static DWORD WINAPI work_thread(LPVOID arg)
+#else
+static void *work_thread(void *arg)
+#endif
+{
+    WorkThread &t = *(WorkThread *) arg;
+    vlong::ProfileReset();
+    double now = t.start = bench_time();
+    do
+    {
+        t.work->func(t);
+        double next = bench_time();
+        t.latency.push_back((next - now) * 1e6);
+        now = next;
+    } while (now - t.start < t.duration);
+    t.end = now;
+    vlong::ProfileSnapshot(&t.prof);
+    return 0;
+}
+
+// Returns false if not all threads could be started
+static bool work_run_threads(std::vector<WorkThread> &threads)
+{
+    size_t i, started;
+#ifdef WIN32
+    std::vector<HANDLE> h(threads.size());
+    for (i=0; i<threads.size() && (h[i] = CreateThread(NULL, 0, work_thread, &threads[i], 0, NULL)) != NULL; i++)
+        ;
+    started = i;
+    for (i=0; i<started; i++)
+    {
+        WaitForSingleObject(h[i], INFINITE);
+        CloseHandle(h[i]);
+    }
+#else
+    std::vector<pthread_t> h(threads.size());
+    for (i=0; i<threads.size() && pthread_create(&h[i], NULL, work_thread, &threads[i]) == 0; i++)
+        ;
+    started = i;
+    for (i=0; i<started; i++)
+        pthread_join(h[i], NULL);
+#endif
+    return started == threads.size();
+}
+
+static int work_cpus()
+{
+#ifdef WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int) si.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+#else
+    return 1;
+#endif
+}
+
+struct WorkOptions
+{
+    const char *format;
+    const char *out;
+    const char *ops;
+    int threads;        // largest number of threads
+    double duration;    // seconds per run
+    bool sizes;         // dump operand size histograms
+};
+
+struct WorkResult
+{
+    const char *name;
+    int threads;
+    size_t ops;
+    double opsPerSec;
+    double efficiency;  // throughput relative to threads times the single thread throughput
+    double mean, p50, p99, p999;    // latency in microseconds
+    std::vector<size_t> histogram;  // latencies in [2^(k-1), 2^k) microseconds, k = 0 below 1
+};
+
+// Nearest-rank percentile
+static double work_percentile(const std::vector<double> &sorted, double q)
+{
+    size_t k = (size_t) ceil(q * sorted.size());
+    return sorted[k > 0 ? k-1 : 0];
+}
+
+static void work_stats(const std::vector<WorkThread> &threads, WorkResult &r)
+{
+    std::vector<double> all;
+    double start = threads[0].start, end = threads[0].end, sum = 0;
+    size_t i, k;
+
+    for (i=0; i<threads.size(); i++)
+    {
+        all.insert(all.end(), threads[i].latency.begin(), threads[i].latency.end());
+        start = std::min(start, threads[i].start);
+        end = std::max(end, threads[i].end);
+    }
+    std::sort(all.begin(), all.end());
+
+    r.histogram.clear();
+    for (i=0; i<all.size(); i++)
+    {
+        sum += all[i];
+        for (k=0; k<64 && ldexp(1.0, (int) k) <= all[i]; k++)
+            ;
+        if (r.histogram.size() <= k)
+            r.histogram.resize(k+1);
+        r.histogram[k]++;
+    }
+    r.threads = (int) threads.size();
+    r.ops = all.size();
+    r.opsPerSec = end > start ? r.ops / (end - start) : 0;
+    r.mean = sum / r.ops;
+    r.p50 = work_percentile(all, 0.5);
+    r.p99 = work_percentile(all, 0.99);
+    r.p999 = work_percentile(all, 0.999);
+}
+
+static void work_print_header(FILE *f, const WorkOptions &opt)
+{
+    if (strcmp(opt.format, "csv") == 0)
+        fprintf(f, "workload,threads,ops,ops_per_s,efficiency,mean_us,p50_us,p99_us,p999_us\n");
+    else if (strcmp(opt.format, "json") == 0)
+        fprintf(f, "{\n  \"cpus\": %d, \"time_s\": %g,\n  \"results\": [", work_cpus(), opt.duration);
+    else
+        fprintf(f, "%-16s %7s %9s %11s %8s %11s %11s %11s %11s\n", "workload", "threads", "ops", "ops/s",
+            "scaling", "mean us", "p50 us", "p99 us", "p999 us");
+}
+
+static void work_print(FILE *f, const WorkOptions &opt, const WorkResult &r, bool first)
+{
+    if (strcmp(opt.format, "csv") == 0)
+    {
+        fprintf(f, "%s,%d,%u,%.2f,%.3f,%.1f,%.1f,%.1f,%.1f\n", r.name, r.threads, (unsigned) r.ops, r.opsPerSec,
+            r.efficiency, r.mean, r.p50, r.p99, r.p999);
+    }
+    else if (strcmp(opt.format, "json") == 0)
+    {
+        fprintf(f, "%s\n    {\"workload\": \"%s\", \"threads\": %d, \"ops\": %u, \"ops_per_s\": %.2f, \"efficiency\": %.3f, "
+            "\"mean_us\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f,\n     \"histogram_us\": [",
+            first ? "" : ",", r.name, r.threads, (unsigned) r.ops, r.opsPerSec, r.efficiency, r.mean, r.p50, r.p99, r.p999);
+        bool any = false;
+        for (size_t k=0; k<r.histogram.size(); k++)
+        {
+            if (r.histogram[k] == 0)
+                continue;
+            fprintf(f, "%s[%.0f, %u]", any ? ", " : "", ldexp(1.0, (int) k), (unsigned) r.histogram[k]);
+            any = true;
+        }
+        fprintf(f, "]}");
+    }
+    else
+    {
+        fprintf(f, "%-16s %7d %9u %11.1f %7.0f%% %11.1f %11.1f %11.1f %11.1f\n", r.name, r.threads, (unsigned) r.ops,
+            r.opsPerSec, 100*r.efficiency, r.mean, r.p50, r.p99, r.p999);
+    }
+    fflush(f);
+}
+
+static void work_print_footer(FILE *f, const WorkOptions &opt)
+{
+    if (strcmp(opt.format, "json") == 0)
+        fprintf(f, "\n  ]\n}\n");
+}
+
+static void work_usage()
+{
+    size_t i;
+    printf("Usage: workload [options]\n"
+           "  --format text|csv|json  output format (text)\n"
+           "  --out FILE              write results to FILE instead of stdout\n"
+           "  --ops w1,w2,...         workloads to run (all)\n"
+           "  --threads N             largest number of threads (number of CPUs, %d)\n"
+           "  --time S                duration of every run in seconds (1)\n"
+           "  --sizes                 write the operand sizes reaching Mul, Div, Mod and PowMod\n"
+           "                          to stderr (needs a build with VLONG_PROFILE_SIZES)\n"
+           "Every workload runs on 1, 2, 4, ... and N threads. Reported are the operations\n"
+           "per second, the scaling efficiency against a single thread and the latency\n"
+           "percentiles; the JSON output adds a histogram of the latencies in power of two\n"
+           "buckets (upper bounds in microseconds).\nWorkloads:", work_cpus());
+    for (i=0; i<work_nloads; i++)
+        printf("%s%s", i % 6 ? " " : "\n  ", work_loads[i].name);
+    printf("\n");
+}
+
+int vlong_workload(int argc, char *argv[])
+{
+    WorkOptions opt;
+    int i;
+
+    opt.format = "text";
+    opt.out = NULL;
+    opt.ops = NULL;
+    opt.threads = work_cpus();
+    opt.duration = 1;
+    opt.sizes = false;
+
+    for (i=0; i<argc; i++)
+    {
+        const char *arg = argv[i], *val = i+1 < argc ? argv[i+1] : NULL;
+        if (strcmp(arg, "--help") == 0)
+        {
+            work_usage();
+            return 0;
+        }
+        if (strcmp(arg, "--sizes") == 0)
+        {
+            opt.sizes = true;
+            continue;
+        }
+        if (val == NULL)
+        {
+            work_usage();
+            return 1;
+        }
+        if (strcmp(arg, "--format") == 0)
+            opt.format = val;
+        else if (strcmp(arg, "--out") == 0)
+            opt.out = val;
+        else if (strcmp(arg, "--ops") == 0)
+            opt.ops = val;
+        else if (strcmp(arg, "--threads") == 0)
+            opt.threads = atoi(val);
+        else if (strcmp(arg, "--time") == 0)
+            opt.duration = atof(val);
+        else
+        {
+            work_usage();
+            return 1;
+        }
+        i++;
+    }
+    if (opt.threads < 1 || opt.duration < 0 || (strcmp(opt.format, "text") && strcmp(opt.format, "csv") && strcmp(opt.format, "json")))
+    {
+        work_usage();
+        return 1;
+    }
+
+    FILE *f = opt.out ? fopen(opt.out, "w") : stdout;
+    if (f == NULL)
+    {
+        printf("Cannot open %s\n", opt.out);
+        return 1;
+    }
+
+    const size_t capacity = BENCH_CAPACITY;
+    WorkShared shared;
+    WorkSetup lastSetup = NULL;
+    size_t lastSize = 0;
+    bool first = true;
+    int failed = 0;
+
+    work_print_header(f, opt);
+    for (size_t k=0; k<work_nloads; k++)
+    {
+        const Workload &w = work_loads[k];
+        if (!bench_selected(opt.ops, w.name))
+            continue;
+        if (w.setup != work_ledger_setup && 2 * w.size + 2 * sizeof(udig_t) * 8 > capacity)
+        {
+            fprintf(stderr, "%s skipped: exceeds VLONG_MAX_DIGITS\n", w.name);
+            continue;
+        }
+
+        // Signing and verification share the key
+        if (w.setup && (w.setup != lastSetup || w.size != lastSize))
+        {
+            unsigned long state = (unsigned long) w.size;
+            fprintf(stderr, "%s: setting up...\n", w.name);
+            if (!w.setup(shared, w.size, &state))
+            {
+                fprintf(stderr, "%s: setup failed\n", w.name);
+                failed++;
+                continue;
+            }
+            lastSetup = w.setup;
+            lastSize = w.size;
+        }
+
+        WorkThread proto;
+        proto.work = &w;
+        proto.data = shared;
+        proto.duration = opt.duration;
+
+        vlong_profile sizes;
+        memset(&sizes, 0, sizeof(sizes));
+        double single = 0;
+        for (int n = 1; n <= opt.threads; n = n < opt.threads && 2*n > opt.threads ? opt.threads : 2*n)
+        {
+            std::vector<WorkThread> threads(n, proto);
+            for (i=0; i<n; i++)
+                threads[i].rng = (unsigned long) (w.size + 1000 * (i + 1));
+            if (!work_run_threads(threads))
+            {
+                fprintf(stderr, "%s: cannot start %d threads\n", w.name, n);
+                failed++;
+                break;
+            }
+
+            WorkResult r;
+            r.name = w.name;
+            work_stats(threads, r);
+            if (n == 1)
+                single = r.opsPerSec;
+            r.efficiency = single > 0 ? r.opsPerSec / (n * single) : 0;
+            work_print(f, opt, r, first);
+            first = false;
+
+            for (i=0; i<n; i++)
+                for (int op=0; op<VLONG_SIZES_OPS; op++)
+                    for (int b=0; b<VLONG_SIZE_BUCKETS; b++)
+                        sizes.sizes[op][b] += threads[i].prof.sizes[op][b];
+        }
+
+        // Histograms summed over all threads and runs of the workload
+        if (opt.sizes)
+        {
+            fprintf(stderr, "%s: operand sizes (histogram, digits or bits from, to, count)\n", w.name);
+            if (vlong::ProfileDumpSizes(&sizes, stderr) != VLONG_SUCCESS)
+                fprintf(stderr, "  not recorded, build with VLONG_PROFILE_SIZES\n");
+        }
+    }
+    work_print_footer(f, opt);
+
+    if (f != stdout)
+        fclose(f);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+/* 
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org/>
+ */
+
+#ifndef _VLONG_BENCH_H_INCLUDED
+#define _VLONG_BENCH_H_INCLUDED
+
+#include "vlong.h"
+
+// Benchmarks of vlong and BigDecimal operations over operand sizes from 64 to
+// 65536 bits. Every measurement is calibrated, warmed up and repeated, outliers
+// are rejected and the results are printed as a table, CSV or JSON.
+// Arguments are the options (see "--help"), returns 0 on success.
+int vlong_bench(int argc, char *argv[]);
+
+// RSA signing and verification, DH key agreement, prime generation and a
+// BigDecimal ledger aggregation run on 1, 2, 4, ... threads, reporting the
+// throughput, scaling efficiency and latency percentiles of every workload.
+// Arguments are the options (see "--help"), returns 0 on success.
+int vlong_workload(int argc, char *argv[]);
+
+// RSA key with e = 65537 and its CRT parameters
+struct vlong_rsa_key
+{
+    vlong n, e, d, p, q, dp, dq, qp;
+};
+
+// Generates the key of the RSA workloads of the given size. The key depends
+// only on the size, so vlong_timing() measures the same key. Returns 0 on success.
+int vlong_rsa_keygen(vlong_rsa_key &key, size_t bits);
+
+#endif //_VLONG_BENCH_H_INCLUDED
@@ -0,0 +1,470 @@
+/* 
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org/>
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "vlong.h"
+#include "vlong_kerneltest.h"
+
+//------------------------------------------------------------------------------------------------------
+
+// Operand shapes, the top limb is never zero
+enum
+{
+    KT_RANDOM,      // random limbs
+    KT_ONES,        // all limbs all ones, B**n - 1
+    KT_POW,         // B**(n-1)
+    KT_TOP,         // only the most significant bit set
+    KT_CARRY,       // random top limb over all-ones limbs, carries run across the number
+    KT_SPARSE,      // limbs of 0, 1 and all ones mixed at random
+    KT_PATTERNS
+};
+
+static const char *kt_pattern_names[KT_PATTERNS] = { "random", "ones", "pow", "top", "carry", "sparse" };
+
+// Kinds of kernels and the reference they are checked against
+enum
+{
+    KT_MUL,         // x <- a*b against prvMulBaseline
+    KT_DIV,         // x <- a/b, y <- a%b against prvDivBig
+    KT_REDUCE,      // x <- a mod b for 0 <= a < b*b against prvDivBig
+    KT_ADD,         // x <- |a|+|b|, y <- |a|-|b| against prvAddMag and prvSubMag
+    KT_SHIFT,       // x <- a << s, y <- a >> s (s from the low limb of b) against ShiftLeft and ShiftRight
+    KT_COMPARE      // x <- CompareMag(a, b) against the limb by limb loop
+};
+
+// Requirements on the operands
+enum
+{
+    KT_ANY,
+    KT_SQUARE,      // b is a
+    KT_TRUNCATE,    // only the lower half of the product digits is kept
+    KT_DIGIT,       // b is a positive single signed digit
+    KT_GREATER,     // |a| >= |b|
+    KT_ODD,         // b is odd
+    KT_DR,          // half of the limbs of b are all ones
+    KT_NEAR         // b is a with at most two limbs below the top changed
+};
+
+// Objects shared between inputs and outputs
+enum { KT_NONE, KT_XA, KT_XB, KT_AB, KT_XAB, KT_YA, KT_YB, KT_ALIASES };
+
+static const char *kt_alias_names[KT_ALIASES] = { "none", "x=a", "x=b", "a=b", "x=a=b", "y=a", "y=b" };
+
+static const int kt_aliases[][KT_ALIASES + 1] =
+{
+    { KT_NONE, KT_XA, KT_XB, KT_AB, KT_XAB, -1 },   // KT_MUL
+    { KT_NONE, KT_XA, KT_XB, KT_YA, KT_YB, -1 },    // KT_DIV
+    { KT_NONE, KT_XA, KT_XB, -1 },                  // KT_REDUCE
+    { KT_NONE, -1 },                                // KT_ADD
+    { KT_NONE, KT_XA, -1 },                         // KT_SHIFT
+    { KT_NONE, KT_AB, -1 }                          // KT_COMPARE
+};
+
+typedef int (*KernelFunc)(vlong *x, vlong *y, const vlong &a, const vlong &b, size_t maxdigs);
+
+struct KernelBackend
+{
+    const char *name;
+    int kind;
+    int operands;
+    size_t minDigits;   // of both operands
+    KernelFunc func;
+};
+
+static unsigned long kt_rand(unsigned long *state)
+{
+    *state = (*state * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+    return (*state >> 8) & 0xFFFF;
+}
+
+//------------------------------------------------------------------------------------------------------
+
+// Access to the digits and the private kernels of vlong
+struct vlong_kernels
+{
+    // v <- n limbs of the given pattern
+    static void Operand(vlong &v, size_t n, int pattern, unsigned long *state)
+    {
+        const udig_t ones = ~((udig_t) 0);
+        size_t i, k;
+
+        v.SetZero();
+        v.Grow(n);
+        for (i=0; i<n; i++)
+        {
+            udig_t r = 0;
+            for (k=0; k<sizeof(udig_t); k++)
+                r = (udig_t) ((r << 4 << 4) | (kt_rand(state) & 0xFF));
+
+            switch (pattern)
+            {
+            case KT_ONES:   v.d[i] = ones; break;
+            case KT_POW:    v.d[i] = i == n-1 ? 1 : 0; break;
+            case KT_TOP:    v.d[i] = i == n-1 ? (udig_t) (ones ^ (ones >> 1)) : 0; break;
+            case KT_CARRY:  v.d[i] = i == n-1 ? r : ones; break;
+            case KT_SPARSE: v.d[i] = (r & 3) == 0 ? 0 : (r & 3) == 1 ? 1 : (r & 3) == 2 ? ones : r; break;
+            default:        v.d[i] = r; break;
+            }
+        }
+        if (v.d[n-1] == 0)
+            v.d[n-1] = 1;
+        v.nu = n;
+    }
+
+    // Applies the requirements of a backend to the operands
+    static void Prepare(const KernelBackend &k, vlong &a, vlong &b, unsigned long *state)
+    {
+        size_t i;
+        if (k.kind == KT_REDUCE)
+        {
+            a.s = b.s = 1;
+            if (k.operands == KT_ODD)
+                b.d[0] |= 1;
+            if (k.operands == KT_DR)
+            {
+                // B**k - d or all ones in the lower half of the limbs
+                bool top = (kt_rand(state) & 1) != 0;
+                for (i=0; i<b.nu; i++)
+                    if (top ? 2*i >= b.nu - 1 : 2*i < b.nu)
+                        b.d[i] = ~((udig_t) 0);
+            }
+            if (b.Compare(2) < 0)
+                b.SetValue(3);
+
+            // 0 <= a < b*b
+            vlong bb;
+            RefMul(bb, b, b, 0);
+            if (vlong::CompareMag(a, bb) >= 0)
+                vlong::prvDivBig(a, bb, NULL, &a);
+            return;
+        }
+
+        if (kt_rand(state) & 1)
+            a.s = -1;
+        if (kt_rand(state) & 1)
+            b.s = -1;
+        if (k.operands == KT_DIGIT)
+        {
+            b.nu = 1;
+            b.d[0] &= ~((udig_t) 0) >> 1;
+            if (b.d[0] == 0)
+                b.d[0] = 1;
+        }
+        if (k.operands == KT_NEAR)
+        {
+            b = a;
+            for (int j=0; j<2; j++)
+            {
+                i = kt_rand(state) % (a.nu + 1);
+                if (i + 1 < a.nu)
+                    b.d[i] ^= (udig_t) (kt_rand(state) | 1);
+            }
+        }
+        if (k.operands == KT_GREATER && vlong::CompareMag(a, b) < 0)
+            a.swap(b);
+    }
+
+    // Chunks of the parallel linear passes, forced for any size and uneven
+    static size_t Chunks(size_t n) { return 2 + n % 7; }
+
+    static int ShiftBits(const vlong &b) { return (int) (b.d[0] % (3 * sizeof(udig_t) * 8)); }
+
+    static void RefAddSub(vlong &x, vlong &y, const vlong &a, const vlong &b)
+    {
+        x.prvAddMag(a, b);
+        y.prvSubMag(a, b);
+        x.s = y.s = 1;
+    }
+
+    // x <- a*b (lower maxdigs digits if not zero) by the O(N^2) kernel
+    static int RefMul(vlong &x, const vlong &a, const vlong &b, size_t maxdigs)
+    {
+        vlong t;
+        int ret = t.prvMulBaseline(a, b, a.nu + b.nu);
+        if (maxdigs > 0 && t.nu > maxdigs)
+        {
+            t.nu = maxdigs;
+            t.Clamp();
+        }
+        t.s = a.s == b.s || t.nu == 0 ? 1 : -1;
+        x.swap(t);
+        return ret;
+    }
+
+    static int RefDiv(vlong *q, vlong *r, const vlong &a, const vlong &b)
+    {
+        return vlong::prvDivBig(a, b, q, r);
+    }
+
+    // Same value in a normalized representation
+    static bool Equal(const vlong &x, const vlong &y)
+    {
+        if (x.nu > 0 && x.d[x.nu-1] == 0)
+            return false;
+        return vlong::CompareMag(x, y) == 0 && (x.nu == 0 || x.s == y.s);
+    }
+
+    // x is a * B**(-n) mod b with n the number of digits of b, as Montgomery reduction returns
+    static bool IsMontgomery(const vlong &x, const vlong &a, const vlong &b)
+    {
+        vlong t, ra;
+        if (x.s < 0 || vlong::CompareMag(x, b) >= 0)
+            return false;
+        t.ShiftLeft(x, (int) (b.nu * sizeof(udig_t) * 8));
+        vlong::prvDivBig(t, b, NULL, &t);
+        vlong::prvDivBig(a, b, NULL, &ra);
+        return Equal(x, x) && vlong::CompareMag(t, ra) == 0;
+    }
+
+    static int MulKaratsuba(vlong *x, vlong *, const vlong &a, const vlong &b, size_t)
+    {
+        char sign = a.s == b.s ? 1 : -1;
+        int ret = x->prvMulKaratsuba(a, b);
+        x->s = sign;
+        return ret;
+    }
+    static int MulNTT(vlong *x, vlong *, const vlong &a, const vlong &b, size_t)
+    {
+        char sign = a.s == b.s ? 1 : -1;
+        int ret = x->prvMulNTT(a, b);
+        x->s = sign;
+        return ret;
+    }
+    static int AddSubParallel(vlong *x, vlong *y, const vlong &a, const vlong &b, size_t)
+    {
+        int ret = x->Grow(a.nu + 1);
+        if (ret == VLONG_SUCCESS)
+            ret = y->Grow(a.nu);
+        if (ret != VLONG_SUCCESS)
+            return ret;
+        x->d[a.nu] = vlong::prvAddSubParallel(x->d, a.d, a.nu, b.d, b.nu, false, Chunks(a.nu));
+        x->nu = a.nu + 1;
+        x->s = 1;
+        vlong::prvAddSubParallel(y->d, a.d, a.nu, b.d, b.nu, true, Chunks(a.nu));
+        y->nu = a.nu;
+        y->s = 1;
+        x->Clamp();
+        return y->Clamp();
+    }
+    // y first, x may be a
+    static int ShiftParallel(vlong *x, vlong *y, const vlong &a, const vlong &b, size_t)
+    {
+        int ret = y->prvShiftParallel(a, -ShiftBits(b), Chunks(a.nu));
+        if (ret == VLONG_SUCCESS)
+            ret = x->prvShiftParallel(a, ShiftBits(b), Chunks(a.nu));
+        return ret;
+    }
+    static int CompareParallel(vlong *x, vlong *, const vlong &a, const vlong &b, size_t)
+    {
+        return x->SetValue((sdig_t) vlong::prvCompareParallel(a.d, b.d, a.nu, Chunks(a.nu)));
+    }
+    static int Mul(vlong *x, vlong *, const vlong &a, const vlong &b, size_t) { return x->Mul(a, b); }
+    static int MulLow(vlong *x, vlong *, const vlong &a, const vlong &b, size_t maxdigs) { return x->Mul(a, b, maxdigs); }
+    static int Sqr(vlong *x, vlong *, const vlong &a, const vlong &, size_t) { return x->Sqr(a); }
+    static int MulDigit(vlong *x, vlong *, const vlong &a, const vlong &b, size_t) { return x->Mul(a, (sdig_t) (b.s * (sdig_t) b.d[0])); }
+    static int DivNewton(vlong *x, vlong *y, const vlong &a, const vlong &b, size_t) { return vlong::prvDivNewton(a, b, x, y); }
+    static int Div(vlong *x, vlong *y, const vlong &a, const vlong &b, size_t) { return x->Div(a, b, y); }
+    static int DivDigit(vlong *x, vlong *y, const vlong &a, const vlong &b, size_t)
+    {
+        sdig_t r;
+        int ret = x->Div(a, (sdig_t) (b.s * (sdig_t) b.d[0]), &r);
+        y->SetValue(r);
+        return ret;
+    }
+    static int ModBarrett(vlong *x, vlong *, const vlong &a, const vlong &b, size_t) { return x->ModBarrett(a, b); }
+    static int ModMontgomery(vlong *x, vlong *, const vlong &a, const vlong &b, size_t) { return x->ModMontgomery(a, b); }
+    static int ModDR(vlong *x, vlong *, const vlong &a, const vlong &b, size_t) { return x->ModDRExt(a, b); }
+};
+
+// Registered backends, new kernels are added here
+static const KernelBackend kt_backends[] =
+{
+    { "mul_karatsuba",  KT_MUL,    KT_ANY,      2, vlong_kernels::MulKaratsuba },
+    { "mul_ntt",        KT_MUL,    KT_ANY,      1, vlong_kernels::MulNTT },
+    { "mul",            KT_MUL,    KT_ANY,      1, vlong_kernels::Mul },
+    { "mul_truncated",  KT_MUL,    KT_TRUNCATE, 1, vlong_kernels::MulLow },
+    { "sqr",            KT_MUL,    KT_SQUARE,   1, vlong_kernels::Sqr },
+    { "mul_digit",      KT_MUL,    KT_DIGIT,    1, vlong_kernels::MulDigit },
+    { "div_newton",     KT_DIV,    KT_GREATER,  1, vlong_kernels::DivNewton },
+    { "div",            KT_DIV,    KT_ANY,      1, vlong_kernels::Div },
+    { "div_digit",      KT_DIV,    KT_DIGIT,    1, vlong_kernels::DivDigit },
+    { "mod_barrett",    KT_REDUCE, KT_ANY,      1, vlong_kernels::ModBarrett },
+    { "mod_montgomery", KT_REDUCE, KT_ODD,      1, vlong_kernels::ModMontgomery },
+    { "mod_dr",         KT_REDUCE, KT_DR,       1, vlong_kernels::ModDR },
+    { "addsub_chunked", KT_ADD,    KT_GREATER,  1, vlong_kernels::AddSubParallel },
+    { "shift_chunked",  KT_SHIFT,  KT_ANY,      1, vlong_kernels::ShiftParallel },
+    { "compare_chunked",KT_COMPARE,KT_NEAR,     1, vlong_kernels::CompareParallel }
+};
+
+static const size_t kt_nbackends = sizeof(kt_backends)/sizeof(kt_backends[0]);
+
+//------------------------------------------------------------------------------------------------------
+
+// Runs a backend on a and b with the given aliasing, returns false on a mismatch
+static bool kt_check(const KernelBackend &k, const vlong &a, const vlong &b, int alias)
+{
+    vlong A(a), B(b), X, Y, ex, ey;
+    const vlong *pa = &A, *pb = &B;
+    vlong *px = &X, *py = &Y;
+    size_t maxdigs = k.operands == KT_TRUNCATE ? (a.GetNumDigits() + b.GetNumDigits() + 1) / 2 : 0;
+
+    switch (alias)
+    {
+    case KT_XA:  px = &A; break;
+    case KT_XB:  px = &B; break;
+    case KT_AB:  pb = &A; break;
+    case KT_XAB: px = &A; pb = &A; break;
+    case KT_YA:  py = &A; break;
+    case KT_YB:  py = &B; break;
+    }
+    const vlong &rb = alias == KT_AB || alias == KT_XAB || k.operands == KT_SQUARE ? a : b;
+
+    if (k.func(px, py, *pa, *pb, maxdigs) != VLONG_SUCCESS)
+        return false;
+
+    if (k.kind == KT_MUL)
+    {
+        vlong_kernels::RefMul(ex, a, rb, maxdigs);
+        return vlong_kernels::Equal(*px, ex);
+    }
+    if (k.kind == KT_DIV)
+    {
+        vlong_kernels::RefDiv(&ex, &ey, a, rb);
+        return vlong_kernels::Equal(*px, ex) && vlong_kernels::Equal(*py, ey);
+    }
+    if (k.kind == KT_ADD)
+    {
+        vlong_kernels::RefAddSub(ex, ey, a, rb);
+        return vlong_kernels::Equal(*px, ex) && vlong_kernels::Equal(*py, ey);
+    }
+    if (k.kind == KT_SHIFT)
+    {
+        ex.ShiftLeft(a, vlong_kernels::ShiftBits(rb));
+        ey.ShiftRight(a, vlong_kernels::ShiftBits(rb));
+        return vlong_kernels::Equal(*px, ex) && vlong_kernels::Equal(*py, ey);
+    }
+    if (k.kind == KT_COMPARE)
+    {
+        ex.SetValue((sdig_t) vlong::CompareMag(a, rb));
+        return vlong_kernels::Equal(*px, ex);
+    }
+    if (k.operands == KT_ODD)
+        return vlong_kernels::IsMontgomery(*px, a, rb);
+    vlong_kernels::RefDiv(NULL, &ex, a, rb);
+    return vlong_kernels::Equal(*px, ex);
+}
+
+// One pair of operands in every aliasing of the backend kind
+static bool kt_case(const KernelBackend &k, size_t na, int pa, size_t nb, int pb, unsigned long *state, int verbose)
+{
+    vlong a, b;
+    int i;
+
+    if (na < k.minDigits) na = k.minDigits;
+    if (nb < k.minDigits) nb = k.minDigits;
+    if (k.kind == KT_REDUCE && na > 2*nb) na = 2*nb;
+    vlong_kernels::Operand(a, na, pa, state);
+    vlong_kernels::Operand(b, nb, pb, state);
+    vlong_kernels::Prepare(k, a, b, state);
+
+    for (i=0; kt_aliases[k.kind][i] >= 0; i++)
+    {
+        int alias = kt_aliases[k.kind][i];
+        if (k.operands == KT_SQUARE && alias != KT_NONE && alias != KT_XA)
+            continue;
+        if (k.operands == KT_DIGIT && (alias == KT_AB || alias == KT_XAB))
+            continue;
+        if (!kt_check(k, a, b, alias))
+        {
+            printf("Kernel %s:\tFAIL! (%u and %u digits, %s and %s limbs, %s)\n", k.name, (unsigned) na, (unsigned) nb,
+                kt_pattern_names[pa], kt_pattern_names[pb], kt_alias_names[alias]);
+            if (verbose)
+            {
+                printf("a=%s\n", a.ToString(16));
+                printf("b=%s\n", b.ToString(16));
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+int vlong_kerneltest(int verbose/*=0*/, int rounds/*=20*/, unsigned long seed/*=1*/)
+{
+    // Sizes around the Karatsuba cutoff with room for the product
+    const size_t kc = VLONG_KARATSUBA_MUL_CUTOFF;
+    const size_t classes[] = { 1, 2, 3, 4, 5, 7, 8, 9, 16, 17, 31, 32, 33, kc-1, kc, kc+1, 2*kc-1, 2*kc, 2*kc+1, 3*kc };
+    std::vector<size_t> sizes;
+    size_t i, j;
+    int failed = 0, p, r;
+
+    for (i=0; i<sizeof(classes)/sizeof(classes[0]); i++)
+    {
+#ifdef VLONG_MAX_DIGITS
+        if (4*classes[i] + 4 > VLONG_MAX_DIGITS)
+            continue;
+#endif
+        if (sizes.empty() || classes[i] > sizes.back())
+            sizes.push_back(classes[i]);
+    }
+
+    for (j=0; j<kt_nbackends; j++)
+    {
+        const KernelBackend &k = kt_backends[j];
+        unsigned long state = seed;
+        bool ok = true;
+        int cases = 0;
+
+        // Every size class and shape on each side, random other operand
+        for (i=0; i<sizes.size() && ok; i++)
+        {
+            for (p=0; p<KT_PATTERNS && ok; p++)
+            {
+                size_t n = sizes[kt_rand(&state) % sizes.size()];
+                int q = (int) (kt_rand(&state) % KT_PATTERNS);
+                ok = kt_case(k, sizes[i], p, n, q, &state, verbose) && kt_case(k, n, q, sizes[i], p, &state, verbose);
+                cases += 2;
+            }
+        }
+
+        // Random sizes and shapes
+        for (r=0; r<rounds && ok; r++)
+        {
+            size_t na = 1 + kt_rand(&state) % sizes.back(), nb = 1 + kt_rand(&state) % sizes.back();
+            ok = kt_case(k, na, (int) (kt_rand(&state) % KT_PATTERNS), nb, (int) (kt_rand(&state) % KT_PATTERNS), &state, verbose);
+            cases++;
+        }
+
+        if (!ok)
+            failed++;
+        if (verbose)
+            printf("Kernel %s: %d cases %s\n", k.name, cases, ok ? "OK" : "FAILED");
+    }
+    return failed;
+}
@@ -0,0 +1,42 @@
+/* 
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org/>
+ */
+
+#ifndef _VLONG_KERNELTEST_H_INCLUDED
+#define _VLONG_KERNELTEST_H_INCLUDED
+
+// Differential test of the multiplication, division and reduction kernels.
+// Every registered backend (Karatsuba, Newton division, Barrett, Montgomery
+// and DR reductions, the dispatching public functions) is run against the
+// portable reference kernels prvMulBaseline and prvDivBig, and the chunked
+// additions, shifts and comparisons of huge numbers (with the chunks forced at
+// any size) against the passes over one limb at a time, on structured edge
+// cases (all-ones limbs, carries across limbs, powers of the radix) and on
+// random operands at every size class, with the output aliased to each input.
+// Returns the number of failed backends, verbose prints the first failing case.
+int vlong_kerneltest(int verbose = 0, int rounds = 20, unsigned long seed = 1);
+
+#endif //_VLONG_KERNELTEST_H_INCLUDED
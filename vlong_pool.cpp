@@ -0,0 +1,757 @@
+/* 
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org/>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include "vlong.h"
+#include "vlong_pool.h"
+
+#ifdef WIN32
+#include <windows.h>
+#define VLONG_THREAD __declspec(thread)
+#else
+#include <pthread.h>
+#include <unistd.h>
+#define VLONG_THREAD __thread
+#endif
+
+//------------------------------------------------------------------------------------------------------
+// Portable mutex, semaphore and one-shot event
+
+#ifdef WIN32
+
+struct PoolMutex
+{
+    CRITICAL_SECTION cs;
+    PoolMutex() { InitializeCriticalSection(&cs); }
+    ~PoolMutex() { DeleteCriticalSection(&cs); }
+    void Lock() { EnterCriticalSection(&cs); }
+    void Unlock() { LeaveCriticalSection(&cs); }
+};
+
+struct PoolSemaphore
+{
+    HANDLE h;
+    PoolSemaphore() { h = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL); }
+    ~PoolSemaphore() { CloseHandle(h); }
+    void Post() { ReleaseSemaphore(h, 1, NULL); }
+    void Wait() { WaitForSingleObject(h, INFINITE); }
+    bool TryWait() { return WaitForSingleObject(h, 0) == WAIT_OBJECT_0; }
+};
+
+struct PoolEvent
+{
+    HANDLE h;
+    PoolEvent() { h = CreateEvent(NULL, TRUE, TRUE, NULL); }
+    ~PoolEvent() { CloseHandle(h); }
+    void Reset() { ResetEvent(h); }
+    void Set() { SetEvent(h); }
+    bool IsSet() { return WaitForSingleObject(h, 0) == WAIT_OBJECT_0; }
+    void Wait() { WaitForSingleObject(h, INFINITE); }
+};
+
+#else
+
+struct PoolMutex
+{
+    pthread_mutex_t m;
+    PoolMutex() { pthread_mutex_init(&m, NULL); }
+    ~PoolMutex() { pthread_mutex_destroy(&m); }
+    void Lock() { pthread_mutex_lock(&m); }
+    void Unlock() { pthread_mutex_unlock(&m); }
+};
+
+struct PoolSemaphore
+{
+    pthread_mutex_t m;
+    pthread_cond_t c;
+    long n;
+    PoolSemaphore() : n(0) { pthread_mutex_init(&m, NULL); pthread_cond_init(&c, NULL); }
+    ~PoolSemaphore() { pthread_cond_destroy(&c); pthread_mutex_destroy(&m); }
+    void Post()
+    {
+        pthread_mutex_lock(&m);
+        n++;
+        pthread_cond_signal(&c);
+        pthread_mutex_unlock(&m);
+    }
+    void Wait()
+    {
+        pthread_mutex_lock(&m);
+        while (n == 0)
+            pthread_cond_wait(&c, &m);
+        n--;
+        pthread_mutex_unlock(&m);
+    }
+    bool TryWait()
+    {
+        pthread_mutex_lock(&m);
+        bool taken = n > 0;
+        if (taken) n--;
+        pthread_mutex_unlock(&m);
+        return taken;
+    }
+};
+
+struct PoolEvent
+{
+    pthread_mutex_t m;
+    pthread_cond_t c;
+    bool set;
+    PoolEvent() : set(true) { pthread_mutex_init(&m, NULL); pthread_cond_init(&c, NULL); }
+    ~PoolEvent() { pthread_cond_destroy(&c); pthread_mutex_destroy(&m); }
+    void Reset()
+    {
+        pthread_mutex_lock(&m);
+        set = false;
+        pthread_mutex_unlock(&m);
+    }
+    void Set()
+    {
+        pthread_mutex_lock(&m);
+        set = true;
+        pthread_cond_broadcast(&c);
+        pthread_mutex_unlock(&m);
+    }
+    bool IsSet()
+    {
+        pthread_mutex_lock(&m);
+        bool s = set;
+        pthread_mutex_unlock(&m);
+        return s;
+    }
+    void Wait()
+    {
+        pthread_mutex_lock(&m);
+        while (!set)
+            pthread_cond_wait(&c, &m);
+        pthread_mutex_unlock(&m);
+    }
+};
+
+#endif
+
+//------------------------------------------------------------------------------------------------------
+// Thread pool
+
+struct PoolTask
+{
+    vlong_task_f func;
+    void *ctx;
+};
+
+struct PoolQueue
+{
+    PoolMutex lock;
+    std::deque<PoolTask> tasks;
+};
+
+struct vlong_pool_state
+{
+    std::vector<PoolQueue *> queues;    // one per worker
+#ifdef WIN32
+    std::vector<HANDLE> threads;
+#else
+    std::vector<pthread_t> threads;
+#endif
+    PoolSemaphore queued;   // one count per queued task, taken before a task is removed
+    PoolMutex lock;         // next
+    size_t next;            // queue of the next task submitted from outside the pool
+    volatile bool stop;
+};
+
+struct PoolWorker
+{
+    vlong_pool_state *st;
+    size_t index;
+};
+
+// Pool and queue of the worker running on the calling thread
+static VLONG_THREAD vlong_pool_state *pool_current;
+static VLONG_THREAD size_t pool_index;
+
+// Removes a task after a count of "queued" was taken: the newest of the own
+// queue, otherwise the oldest of another one. False if all queues are empty
+static bool pool_take(vlong_pool_state *st, size_t own, PoolTask &t)
+{
+    size_t i, n = st->queues.size();
+    for (i=0; i<n; i++)
+    {
+        PoolQueue *q = st->queues[(own + i) % n];
+        q->lock.Lock();
+        bool found = !q->tasks.empty();
+        if (found)
+        {
+            if (i == 0)
+            {
+                t = q->tasks.back();
+                q->tasks.pop_back();
+            }
+            else
+            {
+                t = q->tasks.front();
+                q->tasks.pop_front();
+            }
+        }
+        q->lock.Unlock();
+        if (found)
+            return true;
+    }
+    return false;
+}
+
+// Workers run until a count of "queued" finds all queues empty after stop
+#ifdef WIN32
+static DWORD WINAPI pool_worker(LPVOID arg)
+#else
+static void *pool_worker(void *arg)
+#endif
+{
+    PoolWorker w = *(PoolWorker *) arg;
+    delete (PoolWorker *) arg;
+    pool_current = w.st;
+    pool_index = w.index;
+
+    for (;;)
+    {
+        PoolTask t;
+        w.st->queued.Wait();
+        if (pool_take(w.st, w.index, t))
+            t.func(t.ctx);
+        else if (w.st->stop)
+            break;
+    }
+    return 0;
+}
+
+int vlong_thread_pool::GetNumCPUs()
+{
+#ifdef WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int) si.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+#else
+    return 1;
+#endif
+}
+
+vlong_thread_pool::vlong_thread_pool(int threads /*=0*/)
+{
+    st = new vlong_pool_state;
+    st->next = 0;
+    st->stop = false;
+    if (threads <= 0) threads = GetNumCPUs();
+
+    // A pool whose threads cannot be started runs the tasks in Submit()
+    for (int i=0; i<threads; i++)
+    {
+        PoolWorker *w = new PoolWorker;
+        w->st = st;
+        w->index = st->queues.size();
+        st->queues.push_back(new PoolQueue);
+#ifdef WIN32
+        HANDLE h = CreateThread(NULL, 0, pool_worker, w, 0, NULL);
+        bool started = h != NULL;
+#else
+        pthread_t h;
+        bool started = pthread_create(&h, NULL, pool_worker, w) == 0;
+#endif
+        if (!started)
+        {
+            delete w;
+            delete st->queues.back();
+            st->queues.pop_back();
+            break;
+        }
+        st->threads.push_back(h);
+    }
+}
+
+vlong_thread_pool::~vlong_thread_pool()
+{
+    size_t i;
+    st->stop = true;
+    for (i=0; i<st->threads.size(); i++)
+        st->queued.Post();
+    for (i=0; i<st->threads.size(); i++)
+    {
+#ifdef WIN32
+        WaitForSingleObject(st->threads[i], INFINITE);
+        CloseHandle(st->threads[i]);
+#else
+        pthread_join(st->threads[i], NULL);
+#endif
+    }
+    for (i=0; i<st->queues.size(); i++)
+        delete st->queues[i];
+    delete st;
+}
+
+int vlong_thread_pool::Submit(vlong_task_f task, void *ctx)
+{
+    if (task == NULL) return VLONG_ERR_BAD_ARG_1;
+
+    size_t n = st->queues.size();
+    if (n == 0)
+    {
+        task(ctx);
+        return VLONG_SUCCESS;
+    }
+
+    PoolTask t;
+    t.func = task;
+    t.ctx = ctx;
+
+    // Tasks of a worker stay with it, the others are dealt round-robin
+    PoolQueue *q;
+    if (pool_current == st)
+        q = st->queues[pool_index];
+    else
+    {
+        st->lock.Lock();
+        q = st->queues[st->next++ % n];
+        st->lock.Unlock();
+    }
+
+    try
+    {
+        q->lock.Lock();
+        q->tasks.push_back(t);
+        q->lock.Unlock();
+    }
+    catch (...)
+    {
+        q->lock.Unlock();
+        return VLONG_ERR_MEMORY_ALLOC;
+    }
+    st->queued.Post();
+    return VLONG_SUCCESS;
+}
+
+bool vlong_thread_pool::RunPending()
+{
+    PoolTask t;
+    if (pool_current != st || !st->queued.TryWait())
+        return false;
+    if (!pool_take(st, pool_index, t))
+    {
+        // a count posted by the destructor, leave it to a worker
+        st->queued.Post();
+        return false;
+    }
+    t.func(t.ctx);
+    return true;
+}
+
+int vlong_thread_pool::GetNumThreads() const
+{
+    return (int) st->threads.size();
+}
+
+//------------------------------------------------------------------------------------------------------
+// Default executor
+
+static vlong_executor *pool_default = NULL;
+static vlong_thread_pool *pool_own = NULL;
+
+#ifdef WIN32
+static volatile LONG pool_default_lock = 0;
+static void pool_default_acquire() { while (InterlockedExchange(&pool_default_lock, 1) != 0) Sleep(0); }
+static void pool_default_release() { InterlockedExchange(&pool_default_lock, 0); }
+#else
+static pthread_mutex_t pool_default_lock = PTHREAD_MUTEX_INITIALIZER;
+static void pool_default_acquire() { pthread_mutex_lock(&pool_default_lock); }
+static void pool_default_release() { pthread_mutex_unlock(&pool_default_lock); }
+#endif
+
+vlong_executor *vlong_executor::GetDefault()
+{
+    pool_default_acquire();
+    if (pool_default == NULL)
+    {
+        // the pool lives until the process exits
+        if (pool_own == NULL)
+            pool_own = new vlong_thread_pool;
+        pool_default = pool_own;
+    }
+    vlong_executor *ex = pool_default;
+    pool_default_release();
+    return ex;
+}
+
+void vlong_executor::SetDefault(vlong_executor *ex)
+{
+    pool_default_acquire();
+    pool_default = ex;
+    pool_default_release();
+}
+
+//------------------------------------------------------------------------------------------------------
+// Futures
+
+struct vlong_future_state
+{
+    PoolEvent done;
+    int ret;
+    vlong_executor *ex;
+};
+
+vlong_future::vlong_future()
+{
+    st = new vlong_future_state;
+    st->ret = VLONG_SUCCESS;
+    st->ex = NULL;
+}
+
+vlong_future::~vlong_future()
+{
+    st->done.Wait();
+    delete st;
+}
+
+bool vlong_future::IsReady() const
+{
+    return st->done.IsSet();
+}
+
+int vlong_future::Wait()
+{
+    // help the executor while the operation is queued behind other tasks
+    while (!st->done.IsSet())
+    {
+        if (st->ex == NULL || !st->ex->RunPending())
+        {
+            st->done.Wait();
+            break;
+        }
+    }
+    return st->ret;
+}
+
+int vlong_future::Start(vlong_executor *ex)
+{
+    if (!st->done.IsSet()) return VLONG_ERR_BUSY;
+    st->ex = ex;
+    st->ret = VLONG_SUCCESS;
+    st->done.Reset();
+    return VLONG_SUCCESS;
+}
+
+void vlong_future::Complete(int ret)
+{
+    st->ret = ret;
+    st->done.Set();
+}
+
+//------------------------------------------------------------------------------------------------------
+// Asynchronous operations
+
+struct AsyncPowMod
+{
+    vlong a, e, n;          // n is p for CRT
+    vlong q, dp, dq, qp;    // CRT only
+    bool crt;
+    vlong *x;
+    vlong_future *f;
+};
+
+static void async_powmod(void *ctx)
+{
+    AsyncPowMod *t = (AsyncPowMod *) ctx;
+    int ret = t->crt ? t->x->PowModCRT(t->a, t->n, t->q, t->dp, t->dq, t->qp) : t->x->PowMod(t->a, t->e, t->n);
+    vlong_future *f = t->f;
+    delete t;
+    f->Complete(ret);
+}
+
+static int async_submit(AsyncPowMod *t, vlong_future &f, vlong_executor *ex)
+{
+    int ret;
+    if (ex == NULL) ex = vlong_executor::GetDefault();
+    if ((ret = f.Start(ex)) != VLONG_SUCCESS)
+    {
+        delete t;
+        return ret;
+    }
+    t->f = &f;
+    if ((ret = ex->Submit(async_powmod, t)) != VLONG_SUCCESS)
+    {
+        delete t;
+        f.Complete(ret);
+    }
+    return ret;
+}
+
+int vlong::PowModAsync(const vlong &a, const vlong &e, const vlong &n, vlong_future &f, vlong_executor *ex /*=NULL*/)
+{
+    AsyncPowMod *t;
+    int ret = VLONG_SUCCESS;
+    try
+    {
+        t = new AsyncPowMod;
+    }
+    catch (...)
+    {
+        return VLONG_ERR_MEMORY_ALLOC;
+    }
+    t->crt = false;
+    t->x = this;
+    if ((ret = t->a.Copy(a)) != VLONG_SUCCESS || (ret = t->e.Copy(e)) != VLONG_SUCCESS || (ret = t->n.Copy(n)) != VLONG_SUCCESS)
+    {
+        delete t;
+        return ret;
+    }
+    return async_submit(t, f, ex);
+}
+
+int vlong::PowModCRTAsync(const vlong &a, const vlong &p, const vlong &q, const vlong &dp, const vlong &dq, const vlong &qp,
+                          vlong_future &f, vlong_executor *ex /*=NULL*/)
+{
+    AsyncPowMod *t;
+    int ret = VLONG_SUCCESS;
+    try
+    {
+        t = new AsyncPowMod;
+    }
+    catch (...)
+    {
+        return VLONG_ERR_MEMORY_ALLOC;
+    }
+    t->crt = true;
+    t->x = this;
+    if ((ret = t->a.Copy(a)) != VLONG_SUCCESS || (ret = t->n.Copy(p)) != VLONG_SUCCESS || (ret = t->q.Copy(q)) != VLONG_SUCCESS ||
+        (ret = t->dp.Copy(dp)) != VLONG_SUCCESS || (ret = t->dq.Copy(dq)) != VLONG_SUCCESS || (ret = t->qp.Copy(qp)) != VLONG_SUCCESS)
+    {
+        delete t;
+        return ret;
+    }
+    return async_submit(t, f, ex);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Parallel exponentiation
+
+// Executor splitting the multiplications of the calling thread, NULL if they run
+// sequentially. Workers never have one, so their products stay on one thread
+static VLONG_THREAD vlong_executor *par_executor = NULL;
+
+vlong_executor *vlong::prvParallelExecutor()
+{
+    return par_executor;
+}
+
+struct ParTask
+{
+    vlong *x;
+    const vlong *a, *b, *n;     // x <- a*b or, with n, x <- a^b (mod n)
+    vlong_future f;
+};
+
+static void par_run(void *ctx)
+{
+    ParTask *t = (ParTask *) ctx;
+    t->f.Complete(t->n != NULL ? t->x->PowMod(*t->a, *t->b, *t->n) : t->x->Mul(*t->a, *t->b));
+}
+
+// Submits tasks count-1..1 to ex (runs them on the calling thread if it refuses
+// one), then runs task 0 on the calling thread. Returns the first error
+static int par_run_all(vlong_executor *ex, ParTask *t, size_t count)
+{
+    size_t i;
+    int ret, r;
+    for (i=count; i-- > 0; )
+    {
+        t[i].f.Start(ex);
+        if (i == 0 || ex->Submit(par_run, &t[i]) != VLONG_SUCCESS)
+            par_run(&t[i]);
+    }
+    ret = t[0].f.Wait();
+    for (i=1; i<count; i++)
+    {
+        r = t[i].f.Wait();
+        if (ret == VLONG_SUCCESS) ret = r;
+    }
+    return ret;
+}
+
+int vlong::prvMulParallel(vlong_executor *ex, vlong *r[3], const vlong *a[3], const vlong *b[3])
+{
+    ParTask t[3];
+    for (int i=0; i<3; i++)
+    {
+        t[i].x = r[i];
+        t[i].a = a[i];
+        t[i].b = b[i];
+        t[i].n = NULL;
+    }
+    return par_run_all(ex, t, 3);
+}
+
+int vlong::PowModParallel(const vlong &a, const vlong &e, const vlong &n, vlong_executor *ex /*=NULL*/)
+{
+    if (ex == NULL) ex = vlong_executor::GetDefault();
+
+    vlong_executor *prev = par_executor;
+    par_executor = ex;
+    int ret = PowMod(a, e, n);
+    par_executor = prev;
+    return ret;
+}
+
+int vlong::PowModBases(vlong *bases, size_t count, size_t m, const vlong &a, const vlong &n)
+{
+    if (bases == NULL || count == 0) return VLONG_ERR_BAD_ARG_1;
+    if (m == 0) return VLONG_ERR_BAD_ARG_3;
+
+    vlong p;
+    int ret;
+    if ((ret = p.SetValue(1)) != VLONG_SUCCESS || (ret = p.ShiftLeft(p, (int) m)) != VLONG_SUCCESS)
+        return ret;
+
+    // a mod n in [0, n), then m squarings from one base to the next
+    if ((ret = bases[0].PowMod(a, 1, n)) != VLONG_SUCCESS)
+        return ret;
+    for (size_t j=1; j<count; j++)
+        if ((ret = bases[j].PowMod(bases[j-1], p, n)) != VLONG_SUCCESS)
+            return ret;
+    return VLONG_SUCCESS;
+}
+
+int vlong::PowModParallel(const vlong *bases, size_t count, size_t m, const vlong &e, const vlong &n, vlong_executor *ex /*=NULL*/)
+{
+    if (bases == NULL || count == 0) return VLONG_ERR_BAD_ARG_1;
+    if (m == 0) return VLONG_ERR_BAD_ARG_3;
+    if (e.GetSign() < 0 && !e.isZero()) return VLONG_ERR_NEGATIVE_ARG;
+    if (e.GetNumBits() > count*m) return VLONG_ERR_OUT_OF_RANGE;
+    if (n.GetSign() < 0) return VLONG_ERR_NEGATIVE_ARG;
+    if (ex == NULL) ex = vlong_executor::GetDefault();
+
+    // segments of the exponent from the least significant, the top ones may be zero
+    size_t used = (e.GetNumBits() + m - 1) / m, j;
+    if (used == 0)
+        return SetValue(1);
+
+    ParTask *t;
+    vlong *seg, *part;
+    try
+    {
+        t = new ParTask[used];
+        seg = new vlong[2*used];
+    }
+    catch (...)
+    {
+        return VLONG_ERR_MEMORY_ALLOC;
+    }
+    part = seg + used;
+
+    vlong rest(e), q;
+    int ret = VLONG_SUCCESS;
+    for (j=0; j<used && ret == VLONG_SUCCESS; j++)
+    {
+        ret = q.prvDivPow2(rest, m, &seg[j]);
+        if (ret == VLONG_SUCCESS)
+            ret = rest.Copy(q);
+        t[j].x = &part[j];
+        t[j].a = &bases[j];
+        t[j].b = &seg[j];
+        t[j].n = &n;
+    }
+    if (ret == VLONG_SUCCESS)
+        ret = par_run_all(ex, t, used);
+
+    // the product of the parts, with the multiplications split while the workers are idle
+    vlong_executor *prev = par_executor;
+    par_executor = ex;
+    for (j=1; j<used && ret == VLONG_SUCCESS; j++)
+    {
+        ret = part[0].Mul(part[0], part[j]);
+        if (ret == VLONG_SUCCESS)
+            ret = part[0].Mod(part[0], n);
+    }
+    par_executor = prev;
+
+    if (ret == VLONG_SUCCESS)
+        ret = Copy(part[0]);
+    delete [] t;
+    delete [] seg;
+    return ret;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Parallel passes over huge numbers
+
+struct ParChunk
+{
+    void (*body)(void *, size_t, size_t, size_t);
+    void *ctx;
+    size_t i, lo, hi;
+    vlong_future f;
+};
+
+static void par_chunk(void *ctx)
+{
+    ParChunk *t = (ParChunk *) ctx;
+    t->body(t->ctx, t->i, t->lo, t->hi);
+    t->f.Complete(VLONG_SUCCESS);
+}
+
+size_t vlong::prvParallelChunks(size_t n)
+{
+    if (n < VLONG_PARALLEL_LINEAR_CUTOFF)
+        return 1;
+    int cpus = vlong_thread_pool::GetNumCPUs();
+
+    // chunks of at least half the cutoff
+    size_t chunks = n / (VLONG_PARALLEL_LINEAR_CUTOFF / 2);
+    if (chunks > (size_t) cpus) chunks = (size_t) cpus;
+    if (chunks > 64) chunks = 64;
+    return chunks > 0 ? chunks : 1;
+}
+
+void vlong::prvParallelFor(size_t n, size_t chunks, void (*body)(void *, size_t, size_t, size_t), void *ctx)
+{
+    vlong_executor *ex = par_executor != NULL ? par_executor : vlong_executor::GetDefault();
+    ParChunk t[64];
+    size_t i;
+    for (i=chunks; i-- > 0; )
+    {
+        t[i].body = body;
+        t[i].ctx = ctx;
+        t[i].i = i;
+        t[i].lo = n * i / chunks;
+        t[i].hi = n * (i + 1) / chunks;
+        t[i].f.Start(ex);
+        if (i == 0 || ex->Submit(par_chunk, &t[i]) != VLONG_SUCCESS)
+            par_chunk(&t[i]);
+    }
+    for (i=0; i<chunks; i++)
+        t[i].f.Wait();
+}
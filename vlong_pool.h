@@ -0,0 +1,116 @@
+/* 
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org/>
+ */
+
+#ifndef _VLONG_POOL_H_INCLUDED
+#define _VLONG_POOL_H_INCLUDED
+
+#include "vlong.h"
+
+// Task run by an executor
+typedef void (*vlong_task_f)(void *ctx);
+
+// Runs tasks on some thread. Applications that have their own threads derive
+// from it and pass it to the asynchronous operations or make it the default
+class vlong_executor
+{
+public:
+    virtual ~vlong_executor() {}
+
+    // Run task(ctx) once, now or later, on any thread
+    virtual int Submit(vlong_task_f task, void *ctx) = 0;
+
+    // Run one queued task on the calling thread if it belongs to the executor,
+    // so that a task waiting for another does not block a worker. Returns
+    // false if no task was run
+    virtual bool RunPending() { return false; }
+
+    // Executor of the asynchronous operations when none is given. The first call
+    // without SetDefault() creates a vlong_thread_pool with one thread per CPU.
+    // SetDefault(NULL) restores that pool; the executor is not deleted
+    static vlong_executor *GetDefault();
+    static void SetDefault(vlong_executor *ex);
+};
+
+struct vlong_pool_state;
+
+// Work-stealing thread pool. Every worker has its own queue: tasks submitted
+// by a worker go to the front of its queue, others are dealt round-robin, and
+// idle workers take the oldest task of another queue
+class vlong_thread_pool : public vlong_executor
+{
+public:
+    // 0 threads is one per CPU
+    vlong_thread_pool(int threads = 0);
+
+    // Runs all queued tasks, then stops the workers
+    virtual ~vlong_thread_pool();
+
+    virtual int Submit(vlong_task_f task, void *ctx);
+    virtual bool RunPending();
+
+    int GetNumThreads() const;
+
+    // Number of CPUs available to the process
+    static int GetNumCPUs();
+
+private:
+    vlong_pool_state *st;
+
+    vlong_thread_pool(const vlong_thread_pool &);
+    vlong_thread_pool &operator = (const vlong_thread_pool &);
+};
+
+struct vlong_future_state;
+
+// Completion of an asynchronous operation. The destructor waits, so the
+// result and the operation's copies are never written after it is gone
+class vlong_future
+{
+public:
+    vlong_future();
+    ~vlong_future();
+
+    // Returns true once the operation has completed
+    bool IsReady() const;
+
+    // Waits for the operation and returns its VLONG_* result code. Waiting on a
+    // worker of the executor runs other queued tasks meanwhile
+    int Wait();
+
+    // For operations built on vlong_executor::Submit(): Start() before
+    // submitting, Complete() with the result code when done
+    int Start(vlong_executor *ex);
+    void Complete(int ret);
+
+private:
+    vlong_future_state *st;
+
+    vlong_future(const vlong_future &);
+    vlong_future &operator = (const vlong_future &);
+};
+
+#endif //_VLONG_POOL_H_INCLUDED
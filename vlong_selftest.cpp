@@ -27,10 +27,50 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdexcept>
 #include "vlong.h"
+#include "BigDecimal.h"
+#include "DecimalColumn.h"
+#include "DecimalAccumulator.h"
+#include "BigDecimal10.h"
+#include "Decimal.h"
+#include "vlong_kerneltest.h"
+#include "vlong_pool.h"
 
 #define TEST(s,x) if( !(x) ) { bError=true;printf("%s:\tFAIL!\n", (s)); nFailed++;} else {nSucceed++; bError=false;}
 
+// Random generator returning only zero bytes
+static int zero_rng(void *ctx, char *buf, size_t len)
+{
+    memset(buf, 0, len);
+    return 0;
+}
+
+// Executor running every task at once on the calling thread
+class InlineExecutor : public vlong_executor
+{
+public:
+    virtual int Submit(vlong_task_f task, void *ctx) { task(ctx); return VLONG_SUCCESS; }
+};
+
+// Task waiting for two PowMods it submitted to its own executor
+struct NestedPowMod
+{
+    vlong x[2];
+    vlong_executor *ex;
+    vlong_future f;
+};
+
+static void nested_powmod(void *ctx)
+{
+    NestedPowMod *t = (NestedPowMod *) ctx;
+    vlong_future f0, f1;
+    t->x[0].PowModAsync(vlong(3), vlong(1001), vlong(1000003), f0, t->ex);
+    t->x[1].PowModAsync(vlong(5), vlong(1001), vlong(1000003), f1, t->ex);
+    int ret0 = f0.Wait(), ret1 = f1.Wait();
+    t->f.Complete(ret0 != VLONG_SUCCESS ? ret0 : ret1);
+}
+
 int vlong_selftest(int verbose/*=0*/)
 {
     bool bError=false;
@@ -157,6 +197,31 @@ int vlong_selftest(int verbose/*=0*/)
     TEST("Con10", strcmp(a.ToString(16), "10000000000")==0);
     //printf("a=%s\n", a.ToString(16));
 
+    // Long numbers are converted by splitting at powers of the radix
+    {
+        vlong v, w;
+        char num[1100];
+        size_t nlen = sizeof(num);
+        memset(num, '0', 601);
+        num[0] = '1';
+        num[601] = '\0';
+        v.FromString(num, 10); //10^600
+        TEST("Con10 split", strcmp(v.ToString(10), num)==0);
+        v.Sub(v, 1);
+        v.SetSign(-1);
+        memset(num+1, '9', 600);
+        num[0] = '-';
+        num[601] = '\0';
+        TEST("Con10 split neg", strcmp(v.ToString(10), num)==0);
+        v.SetValue(1);
+        v.ShiftLeft(v, 1000);
+        v.Sub(v, 1);
+        v.ToStringBuf(num, nlen, 2, "ab");
+        TEST("Con2 split", nlen==1001 && strspn(num, "b")==1000);
+        w.FromStringBuf(num, 0, 2, "ab");
+        TEST("Con2 split back", v==w);
+    }
+
     //a.FromString("11717829880366207009516117596335367088558084999998952205599979459063929499736583746670572176471460312928594829675428279466566527115212748467589894601965568", 10);
     //printf("a=%s\n", a.ToString(10));
 
@@ -233,6 +298,11 @@ int vlong_selftest(int verbose/*=0*/)
     b.FromString("234678087908071823794444444412222222222",10);
     c.Div(a,b,&x);
     TEST("Div/Long", strcmp(c.ToString(10),"52760460476269823791333933038493411")==0);
+
+    a.FromString("-123456789012345678901234567890",10);
+    TEST("Con10Long", strcmp(a.ToString(10),"-123456789012345678901234567890")==0);
+    a.MulAdd(a, 1000, 7);
+    TEST("MulAdd", strcmp(a.ToString(10),"-123456789012345678901234567889993")==0);
     //s=c;
     //s*=b;
     //printf("%s / %s = %s , %s (%s) \n", a.ToString(10), b.ToString(10), c.ToString(10), x.ToString(10), s.ToString(10));
@@ -255,6 +325,12 @@ int vlong_selftest(int verbose/*=0*/)
     a.FromString("16342093704794905017200815921831331498602310292448679875661939076",10);
     b.Root(a,2);
     TEST("Root", strcmp(b.ToString(10), "127836198726318927639187263981726")==0);
+    a.Add(a, 1);
+    b.Sqrt(a);
+    TEST("Sqrt", strcmp(b.ToString(10), "127836198726318927639187263981726")==0);
+    c.Div(a, b);
+    b.Div(c, c);
+    TEST("DivEqual", b.Compare(1)==0);
     //printf("b=%s\n", b.ToString(10));
 
     a.GenRandomBits(1023);
@@ -349,6 +425,367 @@ int vlong_selftest(int verbose/*=0*/)
     if (bError)
         printf("d=%s\n", d.ToString(10));
 
+    char sbBuf[2000];
+    memset(sbBuf, 0x5a, sizeof(sbBuf));
+    TEST("SetBytesLong", a.SetBytes(0, sizeof(sbBuf), sbBuf)==VLONG_SUCCESS && a.GetNumDigits()==(sizeof(sbBuf)+sizeof(udig_t)-1)/sizeof(udig_t));
+
+    TEST("BD_compareScale", BigDecimal("1.5").compare(BigDecimal("1.51")) < 0 &&
+        BigDecimal("2.5").compare(BigDecimal("1.51")) > 0 && BigDecimal("1.5").compare(BigDecimal("1.50")) == 0);
+
+    TEST("BD_zeroScale", BigDecimal("0.000").toString()=="0" && BigDecimal("-0.00").toString()=="0");
+
+    vlong dv;
+    sdig_t dvRem = 0;
+    dv.SetValue(-7);
+    dv.Div(dv, -2, &dvRem);
+    TEST("DivDigSign", dv.Compare(3)==0 && dvRem==-1);
+
+    dv.SetZero();
+    dv.Div(dv, 7, &dvRem);
+    TEST("DivDigZero", dv.isZero() && dvRem==0);
+
+    BigDecimal bd(0);
+    bd.fromString("-1234567890123456789.0012500");
+    TEST("BD_fromChars", bd.toString()=="-1234567890123456789.00125" && bd.getScale()==7);
+    if (bError)
+        printf("bd=%s\n", bd.toString().c_str());
+
+    const char *szColumn = "1.5\r\n-0.25\n3E2\n1.5e-3\n";
+    BigDecimal col[4] = {BigDecimal(0), BigDecimal(0), BigDecimal(0), BigDecimal(0)};
+    size_t nCol = BigDecimal::fromCharsBulk(szColumn, szColumn+strlen(szColumn), '\n', col, 4);
+    TEST("BD_fromCharsBulk", nCol==4 && col[0].toString()=="1.5" && col[1].toString()=="-0.25" &&
+        col[2].toString()=="300" && col[3].toString()=="0.0015");
+
+    DecimalColumn dc(2), dc2(2);
+    signed char cmp[3];
+    dc.push_back(BigDecimal("1.25"));
+    dc.push_back(BigDecimal("-3.5"));
+    dc.push_back(BigDecimal("92233720368547758.07"));
+    dc2 = dc;
+    dc.add(dc2);
+    TEST("DC_add", dc.get(0).toString()=="2.5" && dc.get(2).toString()=="184467440737095516.14" && dc.spilled()==(sizeof(swrd_t) > 8 ? 0 : 1));
+    dc.sub(dc2);
+    TEST("DC_sub", dc.get(1).toString()=="-3.5" && dc.spilled()==0);
+    DecimalColumn dcs(dc2);
+    dcs.add(dcs);
+    TEST("DC_addSelf", dcs.get(0).toString()=="2.5" && dcs.get(2).toString()=="184467440737095516.14" &&
+        dcs.spilled()==(sizeof(swrd_t) > 8 ? 0 : 1));
+    dcs.sub(dcs);
+    TEST("DC_subSelf", dcs.get(1).getUnscaled().isZero() && dcs.get(2).getUnscaled().isZero() && dcs.spilled()==0);
+    dc.mul(BigDecimal("1.5"));
+    TEST("DC_mul", dc.get(0).toString()=="1.88" && dc.get(1).toString()=="-5.25");
+    TEST("DC_sum", dc.sum().toString()=="138350580552821633.74");
+    if (bError)
+        printf("sum=%s\n", dc.sum().toString().c_str());
+    dc.compare(BigDecimal("1.875"), cmp);
+    TEST("DC_cmp", cmp[0]==1 && cmp[1]==-1 && cmp[2]==1);
+    dc.rescale(0);
+    dc.compare(dc2, cmp);
+    TEST("DC_rescale", dc.get(0).toString()=="2" && dc.get(1).toString()=="-5" && cmp[0]==1 && cmp[1]==-1);
+
+    DecimalAccumulator acc, acc2;
+    acc.add(BigDecimal("1.5"));
+    acc.add(BigDecimal("-0.25"));
+    acc.add(BigDecimal("100"));
+    acc.add(BigDecimal("-3.125"));
+    TEST("DA_sum", acc.result().toString()=="98.125");
+    acc2.add(BigDecimal("0.875"));
+    acc2.add(BigDecimal("-123456789012345678901234567890123456789012345678901234567890123456789012345.5"));
+    acc2.add(BigDecimal("123456789012345678901234567890123456789012345678901234567890123456789012345.5"));
+    acc.merge(acc2);
+    TEST("DA_merge", acc.result().toString()=="99" && acc.count()==7);
+    if (bError)
+        printf("sum=%s\n", acc.result().toString().c_str());
+
+    bd = BigDecimal("1").div(BigDecimal("3"), MathContext::DECIMAL128);
+    TEST("BD_divMC", bd.toString()=="0.3333333333333333333333333333333333" && bd.precision()==34);
+    if (bError)
+        printf("bd=%s\n", bd.toString().c_str());
+    TEST("BD_round", BigDecimal("2.5").round(MathContext(1, ROUND_HALF_EVEN)).toString()=="2" &&
+        BigDecimal("3.5").round(MathContext(1, ROUND_HALF_EVEN)).toString()=="4" &&
+        BigDecimal("-2.5").round(MathContext(1, ROUND_HALF_UP)).toString()=="-3" &&
+        BigDecimal("-2.1").round(MathContext(1, ROUND_FLOOR)).toString()=="-3" &&
+        BigDecimal("123456").round(MathContext(3)).toString()=="123000");
+    TEST("BD_mulMC", BigDecimal("1.23").mul(BigDecimal("-4.56"), MathContext(3)).toString()=="-5.61");
+    bd = BigDecimal("1").div(BigDecimal("-0.8"), MathContext::UNLIMITED);
+    bool bThrown = false;
+    try { BigDecimal("1").div(BigDecimal("3"), MathContext::UNLIMITED); }
+    catch (std::logic_error &) { bThrown = true; }
+    TEST("BD_divExact", bd.toString()=="-1.25" && bThrown);
+
+    TEST("BD_sqrt", BigDecimal("2").sqrt(MathContext::DECIMAL64).toString()=="1.414213562373095" &&
+        BigDecimal("2.25").sqrt(MathContext::UNLIMITED).toString()=="1.5");
+    TEST("BD_exp", BigDecimal("1").exp(MathContext(30)).toString()=="2.71828182845904523536028747135");
+    TEST("BD_ln", BigDecimal("10").ln(MathContext(20)).toString()=="2.302585092994045684");
+    TEST("BD_pow", BigDecimal("2").pow(BigDecimal("0.5"), MathContext::DECIMAL64).toString()=="1.414213562373095" &&
+        BigDecimal("1.1").pow(-2, MathContext(10)).toString()=="0.826446281" &&
+        BigDecimal("1").pow(-2147483647 - 1, MathContext(10)).toString()=="1");
+
+    TEST("BD_compare", BigDecimal("1.5")==BigDecimal("1.50") && BigDecimal("-2")<BigDecimal("1.999") &&
+        BigDecimal("0.75")<BigDecimal("0.75000000000000000000001") && BigDecimal("123.45")>BigDecimal("123.4499") &&
+        BigDecimal("-123.45")<BigDecimal("-123.4499") && BigDecimal("0.000")==BigDecimal("0"));
+    TEST("BD_hash", BigDecimal("1.5").hash()==BigDecimal("1.500").hash() &&
+        BigDecimal("100").hash()==BigDecimal("100.000").hash() && BigDecimal("-1.5").hash()!=BigDecimal("1.5").hash());
+
+    BigDecimal10 bd10("-1234567890123456789.0012500"), bd10b("2.5");
+    TEST("BD10_parse", bd10.toString()=="-1234567890123456789.00125" && bd10.getScale()==7 &&
+        BigDecimal10("1.5e-3").toString()=="0.0015" && BigDecimal10("0.000").toString()=="0");
+    bd10.setScale(2);
+    bd10b.setScale(0, ROUND_HALF_EVEN);
+    TEST("BD10_scale", bd10.toString()=="-1234567890123456789" && bd10b.toString()=="2");
+    bd10 = BigDecimal10("123456789012.345678") * BigDecimal10("-98765.4321");
+    TEST("BD10_mul", bd10.toString()=="-12193263112482853.122237" && bd10.toBigDecimal().toString()=="-12193263112482853.122237");
+    if (bError)
+        printf("bd10=%s\n", bd10.toString().c_str());
+
+    Decimal<2> dcents("12.345"), dbig = Decimal<2>::fromUnscaled(DecimalLimits<swrd_t>::max());
+    Decimal<4> dbp("1.0001");
+    TEST("Dec_scale", dcents.toString()=="12.35" && (dcents + dbp).toString()=="13.3501" &&
+        (dcents * dbp).toString()=="12.351235" && Decimal<3>("-0.0150").rescale<2>().toString()=="-0.02" &&
+        (dcents / Decimal<0>("3")).toString()=="4.12" && dcents == Decimal<3>("12.350") && dbp < dcents);
+    dbig += dcents;
+    TEST("Dec_spill", dbig.spilled() && (dbig - dcents).unscaled()==DecimalLimits<swrd_t>::max() && !(dbig - dcents).spilled());
+    Decimal<0, int> di7("7");
+    Decimal<2, int> dipi("3.14");
+    Decimal<11, int> dismall("0.02");
+    TEST("Dec_wide", Decimal<0>("1").rescale<40>().spilled() && Decimal<0>("1").rescale<40>().toString()=="1" &&
+        (Decimal<0>("1") + Decimal<20>("0.5")).toString()=="1.5" && Decimal<19>("0.9").rescale<0>().unscaled()==1 &&
+        Decimal<0>("-2") < Decimal<40>("-1.9") && di7.rescale<10>().spilled() && di7.rescale<10>().toString()=="7" &&
+        dipi.rescale<11>().spilled() && dipi.rescale<11>().toString()=="3.14" && dismall.rescale<1>().unscaled()==0);
+
+    char fixed[64];
+    vlong fw;
+    fw.SetValue(-2);
+    TEST("TwosComplementLE", fw.ToTwosComplementLE(fixed, 3)==VLONG_SUCCESS && fixed[0]==(char)0xFE && fixed[2]==(char)0xFF &&
+        fw.FromTwosComplementLE(fixed, 3)==VLONG_SUCCESS && fw.Compare(-2)==0 && fw.ToTwosComplementLE(fixed, 0)!=VLONG_SUCCESS);
+    BigDecimal fwIn[2] = {BigDecimal("-1234567890123456789012345.678901"), BigDecimal("0.5")}, fwOut[2] = {BigDecimal(0), BigDecimal(0)};
+    DecimalColumn fwCol(3);
+    BigDecimal::toFixedWidthBulk(fwIn, 2, 32, 76, 6, fixed);
+    BigDecimal::fromFixedWidthBulk(fixed, 2, 32, 6, fwOut);
+    fwCol.fromFixedWidth(fixed, 2, 32, 6);
+    fwCol.toFixedWidth(fixed, 16, 38);
+    BigDecimal::fromFixedWidthBulk(fixed, 1, 16, 3, fwOut + 1);
+    TEST("BD_fixedWidth", fwOut[0].compare(fwIn[0])==0 && fwOut[0].getScale()==6 && fwCol.get(0).toString()=="-1234567890123456789012345.679" &&
+        fwOut[1].compare(fwCol.get(0))==0 && fwCol.get(1).toString()=="0.5");
+
+    BigDecimal bdq("-100.05");
+    TEST("BD_divInt", (bdq / 12).toString()=="-8.34" && (bdq / -100).toString()=="1" && (bdq / 1000L).toString()=="-0.1" &&
+        (bdq / 3u).toString()=="-33.35" && (bdq / BigDecimal("0.05")).toString()=="-2001" && (bdq / 2.0).toString()=="-50.03" &&
+        (bdq / 4000000000ul).toString()=="0" && (bdq / 12LL).toString()=="-8.34" && (bdq / -100LL).toString()=="1" &&
+        (BigDecimal("100000000000000000000") / -10000000000LL).toString()=="-10000000000" && (bdq / 4000000000ull).toString()=="0");
+
+    // Product truncated to the low digits on the Karatsuba path
+    vlong mt, mfull, mlow;
+    int mbits = 50*8*(int)sizeof(udig_t);
+    mt.SetValue(1);
+    mt.ShiftLeft(mt, 2*mbits);
+    mt.Sub(mt, 12345);
+    mfull.Mul(mt, mt);
+    mlow.ShiftRight(mfull, mbits);
+    mlow.ShiftLeft(mlow, mbits);
+    mlow.Sub(mfull, mlow);
+    mfull.Mul(mt, mt, 50);
+    TEST("MulTrunc", mfull.Compare(mlow)==0);
+
+    mt.PowMod(vlong(3), 5, vlong(7));
+    TEST("PowModDigitExp", mt.Compare(5)==0);
+
+    mt.PowMod(vlong(3), vlong(41), vlong("10000000000000000000", 16));
+    TEST("PowModEvenMod", mt.Compare(vlong("1FA2A1CF67B5FB863", 16))==0);
+
+    mt.ModDRExt(vlong("FFFFFFFFFFFFFFC5", 16), vlong("FFFFFFFFFFFFFFC5", 16));
+    TEST("ModDREqual", mt.isZero());
+
+    // Operation counters around a PowMod (all zero unless built with VLONG_PROFILE)
+    vlong_profile prof0, prof1;
+    int profRet = vlong::ProfileSnapshot(&prof0);
+    mt.PowMod(vlong(7), 65537, vlong("10000000000000061", 16));
+    vlong::ProfileSnapshot(&prof1);
+    vlong_prof_t profPowMod = 0, profReduce = 0, profSqr = 0;
+    int iprof;
+    for (iprof=VLONG_PROF_POWMOD_BARRETT; iprof<=VLONG_PROF_POWMOD_MONTGOMERY; iprof++)
+        profPowMod += prof1.count[iprof] - prof0.count[iprof];
+    for (iprof=VLONG_PROF_REDUCE_BARRETT; iprof<=VLONG_PROF_REDUCE_MONTGOMERY; iprof++)
+        profReduce += prof1.count[iprof] - prof0.count[iprof];
+    profSqr = prof1.count[VLONG_PROF_SQR_BASELINE] - prof0.count[VLONG_PROF_SQR_BASELINE];
+    TEST("Profile", strcmp(vlong::ProfileName(VLONG_PROF_REDUCE_DR), "reduce_dr")==0 && vlong::ProfileName(VLONG_PROF_OPS)==NULL &&
+        (profRet==VLONG_ERR_NOT_IMPLEMENTED ? profPowMod==0 && profReduce==0 : profPowMod==1 && profReduce>=16 && profSqr>=16));
+
+    // Size buckets, and the modulus and exponent of the PowMod above in the histograms
+    bool sizesOk = vlong::ProfileSizeBucket(80)==21 && vlong::ProfileBucketSize(21)==80 && strcmp(vlong::ProfileSizesName(VLONG_SIZES_QUOTIENT), "quotient")==0;
+    for (iprof=0; iprof<VLONG_SIZE_BUCKETS-1; iprof++)
+        sizesOk = sizesOk && vlong::ProfileSizeBucket(vlong::ProfileBucketSize(iprof))==iprof &&
+            vlong::ProfileSizeBucket(vlong::ProfileBucketSize(iprof+1)-1)==iprof;
+#ifdef VLONG_PROFILE_SIZES
+    int bucketMod = vlong::ProfileSizeBucket(vlong("10000000000000061", 16).GetNumDigits()), bucketExp = vlong::ProfileSizeBucket(17);
+    sizesOk = sizesOk && prof1.sizes[VLONG_SIZES_POWMOD][bucketMod] - prof0.sizes[VLONG_SIZES_POWMOD][bucketMod]==1 &&
+        prof1.sizes[VLONG_SIZES_POWMOD_EXP][bucketExp] - prof0.sizes[VLONG_SIZES_POWMOD_EXP][bucketExp]==1;
+#endif
+    TEST("ProfileSizes", sizesOk);
+
+    // Remainder written over the dividend keeps the dividend's sign
+    vlong da("-1000000000000000000000000005", 16), dq2;
+    dq2.Div(da, vlong("10000000000", 16), &da);
+    TEST("DivRemAlias", dq2.Compare(vlong("-100000000000000000", 16))==0 && da.Compare(vlong(-5))==0);
+
+    // Reductions with the result over the modulus
+    vlong ra("123456789ABCDEF0123456789", 16), rn("FFFFFFFFFFFFFFC5", 16), rx, ry, rz;
+    rx = rn;
+    ry = rn;
+    rz = rn;
+    rx.ModBarrett(ra, rx);
+    rz.ModDRExt(ra, rz);
+    mt.Mod(ra, rn);
+    bool modOk = rx.Compare(mt)==0 && rz.Compare(mt)==0;
+    ry.ModMontgomery(ra, ry);
+    mt.ModMontgomery(ra, rn);
+    TEST("ModAliasModulus", modOk && ry.Compare(mt)==0);
+
+    // Reductions of a value equal to the modulus
+    rx.ModBarrett(rn, rn);
+    mt.ShiftLeft(rn, 64);
+    ry.ModMontgomery(mt, rn);
+    TEST("ModEqualModulus", rx.isZero() && ry.isZero());
+
+    // Shifted zero stays normalized
+    mt.SetValue(0);
+    mt.ShiftLeft(mt, 100);
+    TEST("ShiftZero", mt.GetNumDigits()==0);
+
+    // Comparison with a digit across zero and signs
+    TEST("CompareDigit", vlong(5)>0 && vlong(0)<3 && vlong(0)>-3 && vlong(-5)<-4 && vlong(-4)>-5);
+
+    // Kernels against the baseline multiplication and schoolbook division
+    TEST("Kernels", vlong_kerneltest(verbose > 1)==0);
+
+    // Inverse modulo an even number
+    mt.InvMod(vlong(3), vlong(8));
+    TEST("InvModEven", mt.Compare(3)==0 && mlow.InvMod(vlong(7), vlong(10))==VLONG_SUCCESS && mlow.Compare(3)==0);
+
+    // CRT exponentiation where the residue modulo q exceeds the one modulo p
+    bool crtOk = true;
+    for (int icrt=0; icrt<143; icrt++)
+    {
+        mfull.PowModCRT(vlong(icrt), vlong(11), vlong(13), vlong(7), vlong(7), vlong(6));
+        mlow.PowMod(vlong(icrt), 7, vlong(143));
+        crtOk = crtOk && mfull.Compare(mlow)==0;
+    }
+    TEST("PowModCRT", crtOk);
+
+    // Random zero bytes give a normalized zero
+    TEST("GenRandomZero", mt.GenRandomBytes(16, zero_rng)==VLONG_SUCCESS && mt.isZero());
+
+    // Negative exponent raises the inverse
+    mt.PowMod(vlong(3), vlong(-1), vlong(7));
+    TEST("PowModNegExp", mt.Compare(5)==0);
+
+    // Asynchronous PowMod on a pool, nested tasks on a single worker, a user supplied default executor
+    vlong asyncX[8], asyncN("F123456789ABCDEF0123456789ABCDEF1", 16);
+    vlong_future asyncF[8];
+    vlong_thread_pool asyncPool(3), asyncPool1(1);
+    bool asyncOk = asyncPool.GetNumThreads()==3;
+    int iasync;
+    for (iasync=0; iasync<8; iasync++)
+        asyncOk = asyncOk && asyncX[iasync].PowModAsync(vlong(iasync+2), vlong(65537), asyncN, asyncF[iasync], &asyncPool)==VLONG_SUCCESS;
+    for (iasync=0; iasync<8; iasync++)
+    {
+        mlow.PowMod(vlong(iasync+2), vlong(65537), asyncN);
+        asyncOk = asyncOk && asyncF[iasync].Wait()==VLONG_SUCCESS && asyncF[iasync].IsReady() && asyncX[iasync].Compare(mlow)==0;
+    }
+    NestedPowMod nested;
+    nested.ex = &asyncPool1;
+    nested.f.Start(&asyncPool1);
+    asyncPool1.Submit(nested_powmod, &nested);
+    mlow.PowMod(vlong(5), vlong(1001), vlong(1000003));
+    asyncOk = asyncOk && nested.f.Wait()==VLONG_SUCCESS && nested.x[1].Compare(mlow)==0;
+    InlineExecutor inlineEx;
+    vlong_executor::SetDefault(&inlineEx);
+    asyncOk = asyncOk && vlong_executor::GetDefault()==&inlineEx &&
+        asyncX[0].PowModCRTAsync(vlong(5), vlong(11), vlong(13), vlong(7), vlong(7), vlong(6), asyncF[0])==VLONG_SUCCESS &&
+        asyncF[0].IsReady() && asyncX[0].Compare(47)==0;
+    vlong_executor::SetDefault(NULL);
+    asyncOk = asyncOk && vlong_executor::GetDefault()!=&inlineEx && asyncF[0].Start(NULL)==VLONG_SUCCESS &&
+        asyncF[0].Start(NULL)==VLONG_ERR_BUSY && !asyncF[0].IsReady();
+    asyncF[0].Complete(VLONG_ERR_UNEXPECTED);
+    TEST("ThreadPool", asyncOk && asyncF[0].Wait()==VLONG_ERR_UNEXPECTED);
+
+    // Negative base on the DR and the Montgomery paths
+    vlong nbN("10000000000000061", 16), nbX;
+    mt.PowMod(vlong(-2), vlong(3), vlong(7));
+    mlow.PowMod(vlong(-2), vlong(3), vlong(10));
+    nbX.PowMod(vlong(-2), vlong(3), nbN);
+    nbN.Sub(nbN, 8);
+    TEST("PowModNegBase", mt.Compare(6)==0 && mlow.Compare(2)==0 && nbX.Compare(nbN)==0);
+
+    // Batched exponentiation against PowMod, mixed sizes with an even modulus and a negative base
+    vlong batchX[10], batchA[10], batchE[10], batchN[10];
+    bool batchOk = true;
+    int ibatch;
+    for (ibatch=0; ibatch<10; ibatch++)
+    {
+        batchN[ibatch].GenRandomBits(ibatch < 7 ? 1024 : 300);
+        batchN[ibatch].SetBit(ibatch < 7 ? 1023 : 299, 1);
+        batchN[ibatch].SetBit(0, ibatch != 8);
+        batchA[ibatch].GenRandomBits(1100);
+        batchE[ibatch].GenRandomBits(ibatch == 9 ? 0 : 1024);
+    }
+    batchA[3].Sub(vlong(0), batchA[3]);
+    batchOk = vlong::PowModBatchLanes() >= 1 && vlong::PowModBatch(batchX, batchA, batchE, batchN, 10)==VLONG_SUCCESS;
+    for (ibatch=0; ibatch<10; ibatch++)
+    {
+        mlow.PowMod(batchA[ibatch], batchE[ibatch], batchN[ibatch]);
+        batchOk = batchOk && batchX[ibatch].Compare(mlow)==0;
+    }
+    TEST("PowModBatch", batchOk);
+
+    // Numbers grown on pool threads and freed on this one, then the buffers reused
+    bool poolOk = true;
+    for (int ipool=0; ipool<4; ipool++)
+    {
+        vlong *poolX = new vlong[8];
+        for (iasync=0; iasync<8; iasync++)
+            poolOk = poolOk && poolX[iasync].PowModAsync(vlong(iasync+2), vlong(65537+ipool), asyncN, asyncF[iasync], &asyncPool)==VLONG_SUCCESS;
+        for (iasync=0; iasync<8; iasync++)
+        {
+            mlow.PowMod(vlong(iasync+2), vlong(65537+ipool), asyncN);
+            poolOk = poolOk && asyncF[iasync].Wait()==VLONG_SUCCESS && poolX[iasync].Compare(mlow)==0;
+        }
+        delete [] poolX;
+    }
+#ifdef VLONG_POOL
+    poolOk = poolOk && vlong::PoolTrim()==VLONG_SUCCESS;
+#else
+    poolOk = poolOk && vlong::PoolTrim()==VLONG_ERR_NOT_IMPLEMENTED;
+#endif
+    TEST("Pool", poolOk);
+#if defined(WIN32) || defined(_WIN32)
+    TEST("SetMapDir", vlong::SetMapDir(NULL)==VLONG_ERR_NOT_IMPLEMENTED);
+#else
+    TEST("SetMapDir", vlong::SetMapDir("/nonexistent/vlong")==VLONG_ERR_BAD_ARG_1 && vlong::SetMapDir(NULL)==VLONG_SUCCESS);
+#endif
+
+    // Parallel exponentiation with split multiplications (odd and even moduli) and from fixed bases
+    vlong parN, parA, parE, parBases[4];
+    bool parOk = true;
+    for (int ipar=0; ipar<2; ipar++)
+    {
+        parN.GenRandomBits(VLONG_PARALLEL_MUL_CUTOFF*sizeof(udig_t)*8 + 8);
+        parN.SetBit(0, ipar==0);
+        parA.GenRandomBits(VLONG_PARALLEL_MUL_CUTOFF*sizeof(udig_t)*8);
+        parE.GenRandomBits(100);
+        mlow.PowMod(parA, parE, parN);
+        parOk = parOk && mt.PowModParallel(parA, parE, parN, &asyncPool)==VLONG_SUCCESS && mt.Compare(mlow)==0;
+    }
+    parN.GenRandomBits(1024);
+    parN.SetBit(0, 1);
+    parE.GenRandomBits(250);
+    mlow.PowMod(parA, parE, parN);
+    parOk = parOk && vlong::PowModBases(parBases, 4, 64, parA, parN)==VLONG_SUCCESS &&
+        mt.PowModParallel(parBases, 4, 64, parE, parN, &asyncPool)==VLONG_SUCCESS && mt.Compare(mlow)==0 &&
+        mt.PowModParallel(parBases, 4, 64, vlong(0), parN, &asyncPool)==VLONG_SUCCESS && mt.Compare(1)==0;
+    parE.SetBit(256, 1);
+    TEST("PowModParallel", parOk && mt.PowModParallel(parBases, 4, 64, parE, parN, &asyncPool)==VLONG_ERR_OUT_OF_RANGE);
+
     if (verbose)
         printf("SUCCEEDED: %d\tFAILED: %d\n", nSucceed, nFailed);
 